@@ -66,6 +66,17 @@ static inline void compiler_barrier()
     __asm__ __volatile__ ("" : : : "memory");
 }
 
+/**
+ * Spin-wait hint.
+ * PAUSE delays the next instruction so that a spinning thread 
+ * issues fewer loads, leaving execution resources to its SMT sibling, 
+ * and avoids the memory-order mis-speculation penalty on loop exit.
+ */
+static inline void cpu_relax()
+{
+    __asm__ __volatile__ ("pause" : : : "memory");
+}
+
 /**
  * Implements a memory barrier using a locked add operation.
  * See blogs.sun.com/dave/entry/instruction_selection_for_volatile_fences
@@ -0,0 +1,374 @@
+/**
+ * @file
+ * Microbenchmark harness
+ */
+#define _GNU_SOURCE
+
+#include "bench.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tsc_x86_64.h"
+#include "util.h"
+
+typedef struct {
+    char name[64];
+    bench_fn_t fn;
+    void *arg;
+} bench_entry_t;
+
+static bench_entry_t _benches[BENCH_MAX];
+static int _num_benches = 0;
+
+/**
+ * Two-sided 95% Student's t critical values for 1..30 degrees of
+ * freedom; the normal value is used beyond that
+ */
+static const double _t95[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+static double _t_crit(int df)
+{
+    if ( df < 1 )
+        return 0.0;
+    return df <= 30 ? _t95[df-1] : 1.96;
+}
+
+static int _cmp_double(const void *a, const void *b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @return q-quantile of a sorted array (linear interpolation)
+ */
+static double _quantile(double *v, int n, double q)
+{
+    double pos = q * (n - 1);
+    int lo = (int)pos;
+
+    if ( lo >= n - 1 )
+        return v[n-1];
+    return v[lo] + (pos - lo) * (v[lo+1] - v[lo]);
+}
+
+/**
+ * Sorts samples, rejects outliers outside Tukey's fences
+ * (1.5 IQR beyond the quartiles) and fills in the statistics
+ * @param v samples (reordered in place)
+ * @param n number of samples
+ * @param res where statistics are stored
+ */
+static void _compute_stats(double *v, int n, bench_result_t *res)
+{
+    double q1, q3, iqr, lo, hi, sum, sq;
+    int i, first, last, k;
+
+    qsort(v, n, sizeof(double), _cmp_double);
+
+    q1 = _quantile(v, n, 0.25);
+    q3 = _quantile(v, n, 0.75);
+    iqr = q3 - q1;
+    lo = q1 - 1.5 * iqr;
+    hi = q3 + 1.5 * iqr;
+
+    for ( first = 0; first < n && v[first] < lo; first++ ) ;
+    for ( last = n - 1; last > first && v[last] > hi; last-- ) ;
+    k = last - first + 1;
+
+    sum = 0.0;
+    for ( i = first; i <= last; i++ )
+        sum += v[i];
+    res->mean = sum / k;
+
+    sq = 0.0;
+    for ( i = first; i <= last; i++ )
+        sq += (v[i] - res->mean) * (v[i] - res->mean);
+    res->stddev = k > 1 ? sqrt(sq / (k - 1)) : 0.0;
+
+    res->samples = k;
+    res->outliers = n - k;
+    res->median = _quantile(v + first, k, 0.5);
+    res->min = v[first];
+    res->max = v[last];
+    res->ci95 = k > 1 ? _t_crit(k - 1) * res->stddev / sqrt(k) : 0.0;
+}
+
+/**
+ * Fills in default run options
+ * @param opts options to initialize
+ */
+void bench_opts_default(bench_opts_t *opts)
+{
+    opts->cpu = -1;
+    opts->warmup_cycles = 100000000UL;
+    opts->min_sample_cycles = 1000000UL;
+    opts->min_samples = 10;
+    opts->max_samples = 200;
+    opts->target_rel_ci = 0.01;
+    opts->cold_cache = 0;
+}
+
+/**
+ * Registers a benchmark
+ * @param name benchmark name (no commas, it is used as a CSV key)
+ * @param fn benchmark body
+ * @param arg argument passed to fn
+ * @return benchmark index, -1 if the registry is full
+ */
+int bench_register(const char *name, bench_fn_t fn, void *arg)
+{
+    bench_entry_t *e;
+
+    if ( _num_benches == BENCH_MAX )
+        return -1;
+
+    e = &_benches[_num_benches];
+    snprintf(e->name, sizeof(e->name), "%s", name);
+    e->fn = fn;
+    e->arg = arg;
+
+    return _num_benches++;
+}
+
+/**
+ * @return number of bytes to flush so that all caches are evicted
+ */
+static unsigned long _flush_bytes(procmap_t *pi)
+{
+    unsigned long max = 0;
+    int i;
+
+    if ( pi && pi->num_cpus > 0 ) {
+        for ( i = 0; i < pi->flat_threads[0].num_caches; i++ )
+            if ( pi->flat_threads[0].cache[i].size > max )
+                max = pi->flat_threads[0].cache[i].size;
+    }
+
+    return max ? 2 * max : 64UL << 20;
+}
+
+/**
+ * Runs a registered benchmark.
+ * After warmup, samples of 'iters' iterations each are collected
+ * until the confidence interval is tight enough or max_samples is
+ * reached.
+ * @param pi processor map used for pinning and cache sizes (may be
+ *        NULL if opts->cpu is -1 and caches are not flushed)
+ * @param idx benchmark index, as returned by bench_register()
+ * @param opts run options
+ * @param res where results are stored
+ */
+void bench_run(procmap_t *pi, int idx, bench_opts_t *opts,
+               bench_result_t *res)
+{
+    bench_entry_t *e = &_benches[idx];
+    cpu_set_t old_set, set;
+    tsctimer_t tim;
+    double *v;
+    unsigned long iters = 1, flush_bytes = 0;
+    uint64_t end;
+    int n = 0, max_samples;
+
+    memset(res, 0, sizeof(*res));
+    snprintf(res->name, sizeof(res->name), "%s", e->name);
+    res->cpu_id = -1;
+    res->cold_cache = opts->cold_cache;
+
+    if ( opts->cpu >= 0 && pi && opts->cpu < pi->num_cpus ) {
+        res->cpu_id = pi->flat_threads[opts->cpu].cpu_id;
+        pthread_getaffinity_np(pthread_self(), sizeof(old_set), &old_set);
+        CPU_ZERO(&set);
+        CPU_SET(res->cpu_id, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+    if ( opts->cold_cache )
+        flush_bytes = _flush_bytes(pi);
+
+    // Warmup: also scales iters so that one sample lasts long enough
+    // for the TSC read overhead to be negligible
+    end = timer_read() + opts->warmup_cycles;
+    do {
+        timer_clear(&tim);
+        timer_start(&tim);
+        e->fn(e->arg, iters);
+        timer_stop(&tim);
+        if ( !opts->cold_cache && tim.total < opts->min_sample_cycles )
+            iters *= 2;
+    } while ( timer_read() < end );
+    res->iters = iters;
+
+    max_samples = opts->max_samples;
+    if ( max_samples > BENCH_MAX_SAMPLES )
+        max_samples = BENCH_MAX_SAMPLES;
+    if ( max_samples < 1 )
+        max_samples = 1;
+    v = (double*)malloc_safe(max_samples * sizeof(double));
+
+    while ( n < max_samples ) {
+        if ( opts->cold_cache )
+            flush_caches(pi ? pi->num_cpus : 1, flush_bytes);
+
+        timer_clear(&tim);
+        timer_start(&tim);
+        e->fn(e->arg, iters);
+        timer_stop(&tim);
+        v[n++] = timer_total(&tim) / iters;
+
+        if ( n >= opts->min_samples && n >= 2 ) {
+            double *tmp = (double*)malloc_safe(n * sizeof(double));
+            memcpy(tmp, v, n * sizeof(double));
+            _compute_stats(tmp, n, res);
+            free(tmp);
+            if ( res->ci95 <= opts->target_rel_ci * res->mean )
+                break;
+        }
+    }
+    _compute_stats(v, n, res);
+    free(v);
+
+    if ( res->cpu_id >= 0 )
+        pthread_setaffinity_np(pthread_self(), sizeof(old_set), &old_set);
+}
+
+/**
+ * Runs all registered benchmarks whose name contains a pattern
+ * @param pi processor map
+ * @param opts run options
+ * @param filter substring to match, NULL for all
+ * @param res array of at least BENCH_MAX results
+ * @return number of benchmarks run
+ */
+int bench_run_all(procmap_t *pi, bench_opts_t *opts, const char *filter,
+                  bench_result_t *res)
+{
+    int i, n = 0;
+
+    for ( i = 0; i < _num_benches; i++ ) {
+        if ( filter && !strstr(_benches[i].name, filter) )
+            continue;
+        bench_run(pi, i, opts, &res[n++]);
+    }
+
+    return n;
+}
+
+/**
+ * Prints results in human-readable form
+ * @param res results
+ * @param n number of results
+ */
+void bench_report(bench_result_t *res, int n)
+{
+    int i;
+
+    fprintf(stdout, "%-32s %12s %12s %10s %8s %s\n",
+            "Benchmark", "mean(cyc)", "median(cyc)", "+-ci95", "samples",
+            "outliers");
+    for ( i = 0; i < n; i++ )
+        fprintf(stdout, "%-32s %12.2f %12.2f %10.2f %8d %d\n",
+                res[i].name, res[i].mean, res[i].median, res[i].ci95,
+                res[i].samples, res[i].outliers);
+}
+
+#define BENCH_CSV_HEADER "name,cpu,cold,samples,outliers,iters," \
+                         "mean,median,stddev,min,max,ci95"
+
+/**
+ * Writes results as CSV (one row per benchmark)
+ * @return 0 on success, -1 on error
+ */
+int bench_write_csv(const char *path, bench_result_t *res, int n)
+{
+    FILE *fp;
+    int i;
+
+    if ( !(fp = fopen(path, "w")) ) {
+        perror(path);
+        return -1;
+    }
+
+    fprintf(fp, "%s\n", BENCH_CSV_HEADER);
+    for ( i = 0; i < n; i++ )
+        fprintf(fp, "%s,%d,%d,%d,%d,%lu,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n",
+                res[i].name, res[i].cpu_id, res[i].cold_cache,
+                res[i].samples, res[i].outliers, res[i].iters,
+                res[i].mean, res[i].median, res[i].stddev,
+                res[i].min, res[i].max, res[i].ci95);
+
+    fclose(fp);
+    return 0;
+}
+
+/**
+ * Writes results as a JSON array of objects
+ * @return 0 on success, -1 on error
+ */
+int bench_write_json(const char *path, bench_result_t *res, int n)
+{
+    FILE *fp;
+    int i;
+
+    if ( !(fp = fopen(path, "w")) ) {
+        perror(path);
+        return -1;
+    }
+
+    fprintf(fp, "[\n");
+    for ( i = 0; i < n; i++ )
+        fprintf(fp, "  {\"name\": \"%s\", \"cpu\": %d, \"cold\": %d, "
+                    "\"samples\": %d, \"outliers\": %d, \"iters\": %lu, "
+                    "\"mean\": %.4f, \"median\": %.4f, \"stddev\": %.4f, "
+                    "\"min\": %.4f, \"max\": %.4f, \"ci95\": %.4f}%s\n",
+                res[i].name, res[i].cpu_id, res[i].cold_cache,
+                res[i].samples, res[i].outliers, res[i].iters,
+                res[i].mean, res[i].median, res[i].stddev,
+                res[i].min, res[i].max, res[i].ci95,
+                i < n - 1 ? "," : "");
+    fprintf(fp, "]\n");
+
+    fclose(fp);
+    return 0;
+}
+
+/**
+ * Loads results saved with bench_write_csv()
+ * @param path CSV file
+ * @param res where results are stored
+ * @param max capacity of res
+ * @return number of results read, -1 on error
+ */
+int bench_read_csv(const char *path, bench_result_t *res, int max)
+{
+    FILE *fp;
+    char line[512];
+    int n = 0;
+
+    if ( !(fp = fopen(path, "r")) ) {
+        perror(path);
+        return -1;
+    }
+
+    while ( n < max && fgets(line, sizeof(line), fp) ) {
+        bench_result_t *r = &res[n];
+        if ( !strncmp(line, "name,", 5) )
+            continue;
+        if ( sscanf(line, "%63[^,],%d,%d,%d,%d,%lu,%lf,%lf,%lf,%lf,%lf,%lf",
+                    r->name, &r->cpu_id, &r->cold_cache, &r->samples,
+                    &r->outliers, &r->iters, &r->mean, &r->median,
+                    &r->stddev, &r->min, &r->max, &r->ci95) == 12 )
+            n++;
+    }
+
+    fclose(fp);
+    return n;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file
+ * Microbenchmark harness: registration, pinned execution with warmup
+ * and adaptive repetitions, statistics and CSV/JSON reports
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include "processor_map.h"
+
+//! Maximum number of benchmarks that can be registered
+#define BENCH_MAX 256
+
+//! Maximum number of timed samples per benchmark
+#define BENCH_MAX_SAMPLES 1000
+
+/**
+ * Benchmark body. Must perform 'iters' repetitions of the
+ * operation being measured.
+ */
+typedef void (*bench_fn_t)(void *arg, unsigned long iters);
+
+/**
+ * Run options
+ */
+typedef struct {
+    //! Index into procmap_t::flat_threads of the cpu to pin to,
+    //! -1 to leave affinity alone
+    int cpu;
+
+    //! Warmup time, in cycles, before any sample is kept
+    unsigned long warmup_cycles;
+
+    //! Minimum duration of one sample in cycles; the number of
+    //! iterations per sample is scaled up until it is reached
+    unsigned long min_sample_cycles;
+
+    int min_samples;
+    int max_samples;
+
+    //! Sampling stops once the 95% confidence half-width drops
+    //! below this fraction of the mean
+    double target_rel_ci;
+
+    //! If set, caches and TLBs are flushed before every sample,
+    //! and every sample runs a single iteration
+    int cold_cache;
+} bench_opts_t;
+
+/**
+ * Per-benchmark statistics, in cycles per iteration
+ */
+typedef struct {
+    char name[64];
+    int cpu_id;           //!< cpu the benchmark ran on, -1 if unpinned
+    int cold_cache;
+    int samples;          //!< samples kept after outlier rejection
+    int outliers;         //!< samples rejected
+    unsigned long iters;  //!< iterations per sample
+    double mean;
+    double median;
+    double stddev;
+    double min;
+    double max;
+    double ci95;          //!< half-width of 95% confidence interval
+} bench_result_t;
+
+void bench_opts_default(bench_opts_t *opts);
+int bench_register(const char *name, bench_fn_t fn, void *arg);
+void bench_run(procmap_t *pi, int idx, bench_opts_t *opts,
+               bench_result_t *res);
+int bench_run_all(procmap_t *pi, bench_opts_t *opts, const char *filter,
+                  bench_result_t *res);
+void bench_report(bench_result_t *res, int n);
+int bench_write_csv(const char *path, bench_result_t *res, int n);
+int bench_write_json(const char *path, bench_result_t *res, int n);
+int bench_read_csv(const char *path, bench_result_t *res, int max);
+
+#endif
@@ -0,0 +1,227 @@
+/**
+ * @file
+ * Effect of pause-based waits and backoff policies on a contended
+ * compare_and_swap loop, and on the throughput of an SMT sibling
+ */
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "atomic_x86_64.h"
+#include "delay.h"
+#include "processor_map.h"
+#include "tsc_x86_64.h"
+
+enum { POLICY_NONE, POLICY_PAUSE, POLICY_EXP, POLICY_RAND_EXP, NUM_POLICIES };
+static const char *policy_names[] = { "none", "pause", "exp backoff",
+                                      "randomized exp backoff" };
+
+static volatile unsigned long counter __attribute__((aligned(64)));
+static volatile unsigned long failures __attribute__((aligned(64)));
+static volatile int stop_sibling __attribute__((aligned(64)));
+static pthread_barrier_t bar;
+static unsigned long ops_per_thread;
+static int policy;
+
+static void* cas_fun(void *args)
+{
+    long me = (long)args;
+    unsigned long i, old, fails = 0;
+    backoff_t b;
+
+    backoff_init(&b, 20, 2000, policy == POLICY_RAND_EXP, me + 1);
+    pthread_barrier_wait(&bar);
+
+    for ( i = 0; i < ops_per_thread; i++ ) {
+        for ( ;; ) {
+            old = counter;
+            if ( compare_and_swap(&counter, old, old + 1) )
+                break;
+            fails++;
+            if ( policy == POLICY_PAUSE )
+                cpu_relax();
+            else if ( policy != POLICY_NONE )
+                backoff_pause(&b);
+        }
+        backoff_reset(&b);
+    }
+
+    atomic_add(&failures, fails);
+    pthread_barrier_wait(&bar);
+    return NULL;
+}
+
+static pthread_t spawn_pinned(int cpu, void *(*fn)(void*), void *arg)
+{
+    pthread_attr_t attr;
+    pthread_t tid;
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_attr_init(&attr);
+    pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+    if ( pthread_create(&tid, &attr, fn, arg) ) {
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+    pthread_attr_destroy(&attr);
+
+    return tid;
+}
+
+static void bench_cas(procmap_t *pi, int nthreads, double hz)
+{
+    pthread_t *tids;
+    uint64_t t0, t1;
+    long i;
+
+    tids = (pthread_t*)malloc(nthreads * sizeof(pthread_t));
+
+    printf("Contended CAS increment: %d threads, %lu ops each\n",
+           nthreads, ops_per_thread);
+    printf("%-24s %12s %14s %14s\n", "policy", "Mops/s", "cycles/op",
+           "failed CAS/op");
+
+    for ( policy = 0; policy < NUM_POLICIES; policy++ ) {
+        counter = 0;
+        failures = 0;
+        pthread_barrier_init(&bar, NULL, nthreads + 1);
+        for ( i = 0; i < nthreads; i++ )
+            tids[i] = spawn_pinned(
+                pi->flat_threads[i % pi->num_cpus].cpu_id, cas_fun, (void*)i);
+
+        pthread_barrier_wait(&bar);
+        t0 = timer_read();
+        pthread_barrier_wait(&bar);
+        t1 = timer_read();
+
+        for ( i = 0; i < nthreads; i++ )
+            pthread_join(tids[i], NULL);
+        pthread_barrier_destroy(&bar);
+
+        printf("%-24s %12.2f %14.1f %14.3f\n", policy_names[policy],
+               counter / ((t1 - t0) / hz) / 1e6,
+               (double)(t1 - t0) / counter,
+               (double)failures / counter);
+    }
+    printf("\n");
+
+    free(tids);
+}
+
+static void* spin_raw_fun(void *args)
+{
+    while ( !stop_sibling )
+        timer_read();
+    return NULL;
+}
+
+static void* spin_pause_fun(void *args)
+{
+    while ( !stop_sibling )
+        delay_ns(100);
+    return NULL;
+}
+
+/**
+ * Dependent floating point chain, as a stand-in for useful work
+ * @return cycles taken
+ */
+static uint64_t worker(unsigned long n)
+{
+    volatile double x = 1.0;
+    double y = x;
+    uint64_t t0 = timer_read();
+    unsigned long i;
+
+    for ( i = 0; i < n; i++ )
+        y = y * 1.0000001 + 1e-9;
+    x = y;
+    (void)x;
+
+    return timer_read() - t0;
+}
+
+static void bench_smt(procmap_t *pi)
+{
+    cpu_set_t set, old_set;
+    pthread_t tid;
+    uint64_t alone, raw, pause;
+    unsigned long n = 50000000UL;
+    const int *cores;
+    int i, cpu = -1, sib = -1;
+
+    for ( i = 0; i < pi->num_cpus && sib < 0; i++ ) {
+        cpu = pi->flat_threads[i].cpu_id;
+        if ( procmap_siblings(pi, cpu, PROCMAP_LEVEL_CORE, &cores) > 1 )
+            sib = cores[0] != cpu ? cores[0] : cores[1];
+    }
+    if ( sib < 0 ) {
+        printf("SMT sibling throughput: no SMT siblings found, skipped\n");
+        return;
+    }
+
+    pthread_getaffinity_np(pthread_self(), sizeof(old_set), &old_set);
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+    worker(n / 10);
+    alone = worker(n);
+
+    stop_sibling = 0;
+    tid = spawn_pinned(sib, spin_raw_fun, NULL);
+    raw = worker(n);
+    stop_sibling = 1;
+    pthread_join(tid, NULL);
+
+    stop_sibling = 0;
+    tid = spawn_pinned(sib, spin_pause_fun, NULL);
+    pause = worker(n);
+    stop_sibling = 1;
+    pthread_join(tid, NULL);
+
+    pthread_setaffinity_np(pthread_self(), sizeof(old_set), &old_set);
+
+    printf("SMT sibling throughput (worker on cpu %d, spinner on cpu %d)\n",
+           cpu, sib);
+    printf("%-24s %14s %10s\n", "sibling", "cycles", "relative");
+    printf("%-24s %14lu %10.3f\n", "idle", (unsigned long)alone, 1.0);
+    printf("%-24s %14lu %10.3f\n", "rdtsc spin", (unsigned long)raw,
+           (double)alone / raw);
+    printf("%-24s %14lu %10.3f\n", "pause spin (delay_ns)",
+           (unsigned long)pause, (double)alone / pause);
+}
+
+int main(int argc, char **argv)
+{
+    procmap_t *pi = procmap_init();
+    int nthreads = argc > 1 ? atoi(argv[1]) : pi->num_cpus;
+    tsctimer_t tim;
+    double hz;
+    int i;
+
+    ops_per_thread = argc > 2 ? atol(argv[2]) : 1000000UL;
+
+    delay_init();
+    hz = delay_cycles_per_ns * 1e9;
+
+    timer_clear(&tim);
+    for ( i = 0; i < 100; i++ ) {
+        timer_start(&tim);
+        delay_ns(1000);
+        timer_stop(&tim);
+    }
+    printf("delay_ns(1000): %.1f ns on average\n\n",
+           timer_average(&tim) / delay_cycles_per_ns);
+
+    bench_cas(pi, nthreads, hz);
+    bench_smt(pi);
+
+    procmap_destroy(pi);
+    return 0;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file
+ * Compares benchmark results against a saved baseline and flags
+ * regressions
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+static bench_result_t base[BENCH_MAX], curr[BENCH_MAX];
+
+int main(int argc, char **argv)
+{
+    int i, j, nbase, ncurr, regressions = 0;
+    double threshold = 5.0;
+
+    if ( argc < 3 ) {
+        fprintf(stderr, "Usage: %s <baseline.csv> <current.csv> "
+                        "[threshold %%]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if ( argc > 3 )
+        threshold = atof(argv[3]);
+
+    if ( (nbase = bench_read_csv(argv[1], base, BENCH_MAX)) < 0 ||
+         (ncurr = bench_read_csv(argv[2], curr, BENCH_MAX)) < 0 )
+        exit(EXIT_FAILURE);
+
+    printf("%-32s %12s %12s %9s  %s\n",
+           "Benchmark", "baseline", "current", "delta", "status");
+
+    for ( i = 0; i < ncurr; i++ ) {
+        bench_result_t *c = &curr[i], *b = NULL;
+        const char *status;
+        double delta;
+
+        for ( j = 0; j < nbase; j++ ) {
+            if ( !strcmp(base[j].name, c->name) &&
+                 base[j].cold_cache == c->cold_cache ) {
+                b = &base[j];
+                break;
+            }
+        }
+        if ( !b ) {
+            printf("%-32s %12s %12.2f %9s  new\n", c->name, "-", c->mean, "-");
+            continue;
+        }
+
+        delta = 100.0 * (c->mean - b->mean) / b->mean;
+
+        // A change only counts if it exceeds the threshold and the
+        // confidence intervals of the two runs do not overlap
+        if ( delta > threshold && c->mean - c->ci95 > b->mean + b->ci95 ) {
+            status = "REGRESSION";
+            regressions++;
+        } else if ( delta < -threshold &&
+                    c->mean + c->ci95 < b->mean - b->ci95 ) {
+            status = "improved";
+        } else {
+            status = "ok";
+        }
+
+        printf("%-32s %12.2f %12.2f %+8.2f%%  %s\n",
+               c->name, b->mean, c->mean, delta, status);
+    }
+
+    printf("\n%d regression(s) above %.1f%%\n", regressions, threshold);
+
+    return regressions ? 1 : 0;
+}
@@ -0,0 +1,93 @@
+/**
+ * @file
+ * GFLOPS of the blocked matrix multiply vs. the naive triple loop.
+ * Usage: bench_gemm [max n (default 2048, e.g. 8192)] [max n for naive]
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "matrix2d.h"
+#include "matrix2d_gemm.h"
+#include "processor_map.h"
+#include "tsc_x86_64.h"
+
+/**
+ * Runs C = A*B until at least 'min_cycles' have elapsed
+ * @return best cycles of a single run
+ */
+template <typename F>
+static uint64_t time_best(F f, uint64_t min_cycles)
+{
+    uint64_t best = UINT64_MAX, start = timer_read();
+    tsctimer_t tim;
+
+    do {
+        timer_clear(&tim);
+        timer_start(&tim);
+        f();
+        timer_stop(&tim);
+        if ( tim.total < best )
+            best = tim.total;
+    } while ( timer_read() - start < min_cycles );
+
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    size_t max = argc > 1 ? atol(argv[1]) : 2048;
+    size_t naive_max = argc > 2 ? atol(argv[2]) : 1024;
+    procmap_t *pi = procmap_init();
+    double hz = timer_calibrate_hz(20000);
+
+    matrix2d_gemm_init(pi);
+    gemm_blocking_t bl = matrix2d_gemm_blocking();
+    printf("Kernel: %s, blocking mc=%zu kc=%zu nc=%zu\n",
+           matrix2d_gemm_kernel_name(), bl.mc, bl.kc, bl.nc);
+    printf("%6s %12s %12s %12s\n", "n", "naive GF/s", "blocked GF/s",
+           "max error");
+
+    for ( size_t n = 64; n <= max; n *= 2 ) {
+        matrix2d_t<double> A = matrix2d_alloc_contig<double>(n, n),
+                           B = matrix2d_alloc_contig<double>(n, n),
+                           C = matrix2d_alloc_contig<double>(n, n),
+                           R = matrix2d_alloc_contig<double>(n, n);
+        double flops = 2.0 * n * n * n, err = 0.0, naive_gf = 0.0;
+        uint64_t t;
+
+        matrix2d_init_random_double(A.rows, n, n);
+        matrix2d_init_random_double(B.rows, n, n);
+
+        t = time_best([&]() {
+            matrix2d_gemm(n, n, n, 1.0, A.rows, B.rows, 0.0, C.rows);
+        }, (uint64_t)(0.2 * hz));
+        double gf = flops / (t / hz) / 1e9;
+
+        if ( n <= naive_max ) {
+            t = time_best([&]() {
+                matrix2d_init(R.rows, n, n, 0.0);
+                matrix2d_gemm_naive(n, n, n, 1.0, A.rows, B.rows, 0.0,
+                                    R.rows);
+            }, (uint64_t)(0.2 * hz));
+            naive_gf = flops / (t / hz) / 1e9;
+
+            for ( size_t i = 0; i < n; i++ )
+                for ( size_t j = 0; j < n; j++ )
+                    err = std::fmax(err, std::fabs(C.rows[i][j] -
+                                                   R.rows[i][j]));
+            printf("%6zu %12.2f %12.2f %12.2e\n", n, naive_gf, gf, err);
+        } else {
+            printf("%6zu %12s %12.2f %12s\n", n, "-", gf, "-");
+        }
+
+        matrix2d_destroy_contig(A);
+        matrix2d_destroy_contig(B);
+        matrix2d_destroy_contig(C);
+        matrix2d_destroy_contig(R);
+    }
+
+    procmap_destroy(pi);
+    return 0;
+}
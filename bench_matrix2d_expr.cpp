@@ -0,0 +1,141 @@
+/**
+ * @file
+ * C = a*A + B - D, fused through matrix2d_expr.h vs. one operation
+ * (and one temporary matrix) per step.
+ * Usage: bench_matrix2d_expr [n (default 4096)]
+ *
+ * Memory traffic is modeled as the matrices read and written by each
+ * pass: stepwise reads A, T1, B, T2, D and writes T1, T2, C (8 n^2
+ * elements); fused reads A, B, D and writes C (4 n^2 elements).
+ *
+ * Also checks division by a scalar against a plain loop, on an int
+ * and a double matrix (the results must be identical).
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "matrix2d.h"
+#include "matrix2d_expr.h"
+#include "tsc_x86_64.h"
+
+template <typename F>
+static uint64_t time_best(F f, int reps)
+{
+    uint64_t best = UINT64_MAX;
+    tsctimer_t tim;
+
+    for ( int r = 0; r < reps; r++ ) {
+        timer_clear(&tim);
+        timer_start(&tim);
+        f();
+        timer_stop(&tim);
+        if ( tim.total < best )
+            best = tim.total;
+    }
+    return best;
+}
+
+static void scale(double a, double **x, double **y, size_t n)
+{
+    for ( size_t i = 0; i < n; i++ )
+        for ( size_t j = 0; j < n; j++ )
+            y[i][j] = a * x[i][j];
+}
+
+static void add(double **x, double **y, double **z, size_t n)
+{
+    for ( size_t i = 0; i < n; i++ )
+        for ( size_t j = 0; j < n; j++ )
+            z[i][j] = x[i][j] + y[i][j];
+}
+
+/**
+ * Compares m / s built by the expression with a loop
+ * @return number of differing elements
+ */
+template <typename T>
+static size_t check_divide(T **m, size_t n, T s)
+{
+    T **x = matrix2d_alloc<T>(n, n);
+    matrix2d_ref<T> rm(m, n, n), rx(x, n, n);
+    size_t bad = 0;
+
+    rx = rm / s;
+    for ( size_t i = 0; i < n; i++ )
+        for ( size_t j = 0; j < n; j++ )
+            bad += x[i][j] != m[i][j] / s;
+
+    matrix2d_destroy(x, n);
+    return bad;
+}
+
+static void sub(double **x, double **y, double **z, size_t n)
+{
+    for ( size_t i = 0; i < n; i++ )
+        for ( size_t j = 0; j < n; j++ )
+            z[i][j] = x[i][j] - y[i][j];
+}
+
+int main(int argc, char **argv)
+{
+    size_t n = argc > 1 ? atol(argv[1]) : 4096;
+    double hz = timer_calibrate_hz(20000), a = 1.5;
+    double **A = matrix2d_alloc<double>(n, n),
+           **B = matrix2d_alloc<double>(n, n),
+           **C = matrix2d_alloc<double>(n, n),
+           **D = matrix2d_alloc<double>(n, n),
+           **R = matrix2d_alloc<double>(n, n);
+    double elem = (double)n * n * sizeof(double), bad = 0;
+    uint64_t t_step, t_fused;
+
+    matrix2d_init_random_double(A, n, n);
+    matrix2d_init_random_double(B, n, n);
+    matrix2d_init_random_double(D, n, n);
+    matrix2d_init(C, n, n, 0.0);
+    matrix2d_init(R, n, n, 0.0);
+
+    t_step = time_best([&]() {
+        double **T1 = matrix2d_alloc<double>(n, n),
+               **T2 = matrix2d_alloc<double>(n, n);
+        scale(a, A, T1, n);
+        add(T1, B, T2, n);
+        sub(T2, D, R, n);
+        matrix2d_destroy(T1, n);
+        matrix2d_destroy(T2, n);
+    }, 5);
+
+    matrix2d_ref<double> rA(A, n, n), rB(B, n, n), rC(C, n, n), rD(D, n, n);
+    t_fused = time_best([&]() { rC = a * rA + rB - rD; }, 5);
+
+    for ( size_t i = 0; i < n; i++ )
+        for ( size_t j = 0; j < n; j++ )
+            bad += C[i][j] != R[i][j];
+
+    printf("C = a*A + B - D, %zux%zu doubles\n", n, n);
+    printf("%-10s %10s %12s %12s\n", "", "ms", "traffic MB", "GB/s");
+    printf("%-10s %10.2f %12.1f %12.2f\n", "stepwise", t_step / hz * 1e3,
+           8 * elem / 1e6, 8 * elem / (t_step / hz) / 1e9);
+    printf("%-10s %10.2f %12.1f %12.2f\n", "fused", t_fused / hz * 1e3,
+           4 * elem / 1e6, 4 * elem / (t_fused / hz) / 1e9);
+    printf("speedup %.2fx, %s\n", (double)t_step / t_fused,
+           bad ? "RESULTS DIFFER" : "results match");
+
+    int **I = matrix2d_alloc<int>(n, n);
+    size_t bad_div;
+
+    for ( size_t i = 0; i < n; i++ )
+        for ( size_t j = 0; j < n; j++ )
+            I[i][j] = (int)(i * n + j) - (int)(n * n / 2);
+    bad_div = check_divide(I, n, 7) + check_divide(A, n, 3.0);
+    printf("A / s on int and double: %s\n",
+           bad_div ? "RESULTS DIFFER" : "results match");
+
+    matrix2d_destroy(I, n);
+    matrix2d_destroy(A, n);
+    matrix2d_destroy(B, n);
+    matrix2d_destroy(C, n);
+    matrix2d_destroy(D, n);
+    matrix2d_destroy(R, n);
+    return bad || bad_div ? 1 : 0;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file
+ * GFLOPS of textbook vs. blocked, multi-threaded LU and Cholesky, each
+ * checked by solving a system and computing the scaled residual
+ * ||A x - b|| / (||A|| ||x|| n eps), which should be O(1).
+ * Usage: bench_matrix2d_factor [n (default 2048)] [threads (default all)]
+ */
+
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "matrix2d.h"
+#include "matrix2d_factor.h"
+#include "matrix2d_gemm.h"
+#include "matrix2d_random.h"
+#include "processor_map.h"
+#include "tsc_x86_64.h"
+
+//! Scaled residuals above this fail the check
+#define RESIDUAL_MAX 30.0
+
+static double scaled_residual(size_t n, double **A, const double *x,
+                              const double *b)
+{
+    double rmax = 0.0, amax = 0.0, xmax = 0.0;
+
+    for ( size_t i = 0; i < n; i++ ) {
+        double r = -b[i], a = 0.0;
+        for ( size_t j = 0; j < n; j++ ) {
+            r += A[i][j] * x[j];
+            a += std::fabs(A[i][j]);
+        }
+        rmax = std::fmax(rmax, std::fabs(r));
+        amax = std::fmax(amax, a);
+        xmax = std::fmax(xmax, std::fabs(x[i]));
+    }
+    return rmax / (amax * xmax * n * DBL_EPSILON);
+}
+
+/**
+ * Factors a copy of A0 with f, then solves for b and checks
+ * @return 1 if the factorisation failed or the residual is too large
+ */
+template <typename F, typename S>
+static int run(const char *name, size_t n, double **A0, double flops,
+               const double *b, F factor, S solve, double hz)
+{
+    double **A = matrix2d_alloc<double>(n, n), *x = new double [n], res;
+    tsctimer_t tim;
+    int info;
+
+    matrix2d_copy(A0, A, n, n);
+    timer_clear(&tim);
+    timer_start(&tim);
+    info = factor(A);
+    timer_stop(&tim);
+
+    for ( size_t i = 0; i < n; i++ )
+        x[i] = b[i];
+    solve(A, x);
+    res = scaled_residual(n, A0, x, b);
+
+    printf("%-20s %10.3f s %10.2f GFLOPS %12.2e%s\n", name,
+           tim.total / hz, flops / (tim.total / hz) / 1e9, res,
+           info ? " (factorisation failed)" : "");
+
+    matrix2d_destroy(A, n);
+    delete [] x;
+    return info || !(res < RESIDUAL_MAX);
+}
+
+int main(int argc, char **argv)
+{
+    size_t n = argc > 1 ? atol(argv[1]) : 2048;
+    procmap_t *pi = procmap_init();
+    int nthreads = argc > 2 ? atoi(argv[2]) : pi->num_cpus;
+    double hz = timer_calibrate_hz(20000);
+    double **A = matrix2d_alloc<double>(n, n), **S = matrix2d_alloc<double>(n, n);
+    double *b = new double [n];
+    size_t *piv = new size_t [n];
+    double nd = (double)n;
+    int bad = 0;
+
+    matrix2d_gemm_init(pi);
+
+    // General matrix for LU; symmetric, diagonally dominant one for
+    // Cholesky
+    matrix2d_init_random_uniform(A, n, n, -1.0, 1.0, 1);
+    for ( size_t i = 0; i < n; i++ )
+        for ( size_t j = 0; j <= i; j++ )
+            S[i][j] = S[j][i] = i == j ? nd + std::fabs(A[i][i])
+                                       : 0.5 * (A[i][j] + A[j][i]);
+    for ( size_t i = 0; i < n; i++ )
+        b[i] = (double)(i % 7) - 3.0;
+
+    printf("n = %zu, %d threads, panel width %d, gemm kernel %s\n", n,
+           nthreads, MATRIX2D_FACTOR_NB, matrix2d_gemm_kernel_name());
+    printf("%-20s %12s %17s %12s\n", "", "time", "", "residual");
+
+    bad += run("LU textbook", n, A, 2.0 / 3.0 * nd * nd * nd, b,
+               [&](double **M) { return matrix2d_lu_naive(n, M, piv); },
+               [&](double **M, double *x) { matrix2d_lu_solve(n, M, piv, x); },
+               hz);
+    bad += run("LU blocked", n, A, 2.0 / 3.0 * nd * nd * nd, b,
+               [&](double **M) { return matrix2d_lu(n, M, piv, pi, nthreads); },
+               [&](double **M, double *x) { matrix2d_lu_solve(n, M, piv, x); },
+               hz);
+    bad += run("Cholesky textbook", n, S, 1.0 / 3.0 * nd * nd * nd, b,
+               [&](double **M) { return matrix2d_cholesky_naive(n, M); },
+               [&](double **M, double *x) { matrix2d_cholesky_solve(n, M, x); },
+               hz);
+    bad += run("Cholesky blocked", n, S, 1.0 / 3.0 * nd * nd * nd, b,
+               [&](double **M) { return matrix2d_cholesky(n, M, pi, nthreads); },
+               [&](double **M, double *x) { matrix2d_cholesky_solve(n, M, x); },
+               hz);
+
+    printf("residual checks: %s\n", bad ? "FAILED" : "passed");
+
+    delete [] piv;
+    delete [] b;
+    matrix2d_destroy(A, n);
+    matrix2d_destroy(S, n);
+    procmap_destroy(pi);
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,213 @@
+/**
+ * @file
+ * Load time of a matrix: parsing text into matrix2d_alloc rows vs.
+ * reading the binary format vs. mapping it.
+ * Usage: bench_matrix2d_file [n (default 2048)] [directory (default /tmp)]
+ *
+ * Files are read right after being written, so they come from the
+ * page cache; "load" is the time until the matrix is usable, "load+sum"
+ * adds one pass over all elements (which is when a lazy mapping
+ * faults its pages in).
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "matrix2d.h"
+#include "matrix2d_file.h"
+#include "tsc_x86_64.h"
+
+static double sum(double **m, size_t nrows, size_t ncols)
+{
+    double s = 0.0;
+    for ( size_t i = 0; i < nrows; i++ )
+        for ( size_t j = 0; j < ncols; j++ )
+            s += m[i][j];
+    return s;
+}
+
+static void write_text(const char *path, double **m, size_t n)
+{
+    FILE *fp = fopen(path, "w");
+
+    if ( !fp ) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    fprintf(fp, "%zu %zu\n", n, n);
+    for ( size_t i = 0; i < n; i++ ) {
+        for ( size_t j = 0; j < n; j++ )
+            fprintf(fp, "%.17g ", m[i][j]);
+        fputc('\n', fp);
+    }
+    fclose(fp);
+}
+
+/**
+ * Text loader: a line at a time, strtod per element, copied into the
+ * rows of a matrix2d_alloc matrix
+ */
+static double** load_text(const char *path, size_t *n)
+{
+    FILE *fp = fopen(path, "r");
+    size_t nr, nc, cap = 1 << 16;
+    char *line = static_cast<char*>(malloc(cap));
+    double **m, *tmp;
+
+    if ( !fp || fscanf(fp, "%zu %zu\n", &nr, &nc) != 2 ) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    m = matrix2d_alloc<double>(nr, nc);
+    tmp = new double [nc];
+
+    for ( size_t i = 0; i < nr; i++ ) {
+        ssize_t len = getline(&line, &cap, fp);
+        char *p = line, *end;
+        if ( len < 0 )
+            break;
+        for ( size_t j = 0; j < nc; j++, p = end )
+            tmp[j] = strtod(p, &end);
+        memcpy(m[i], tmp, nc * sizeof(double));
+    }
+
+    delete [] tmp;
+    free(line);
+    fclose(fp);
+    *n = nr;
+    return m;
+}
+
+/**
+ * Binary loader without mmap: pread of the data section into a
+ * contiguous matrix with the same stride
+ */
+static matrix2d_t<double> load_read(const char *path)
+{
+    matrix2d_file_header_t hdr;
+    matrix2d_t<double> m;
+    int fd;
+
+    if ( matrix2d_file_read_header(path, &hdr) )
+        exit(EXIT_FAILURE);
+    m = matrix2d_alloc_contig<double>(hdr.nrows, hdr.ncols, hdr.ld);
+    fd = open(path, O_RDONLY);
+    if ( fd < 0 || pread(fd, m.data, hdr.nrows * hdr.ld * sizeof(double),
+                         hdr.data_offset) < 0 ) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+    return m;
+}
+
+static void report(const char *name, uint64_t t_load, uint64_t t_sum,
+                   double hz, double ref, double s)
+{
+    printf("%-22s %10.2f %10.2f%s\n", name, t_load / hz * 1e3,
+           (t_load + t_sum) / hz * 1e3, s == ref ? "" : "  WRONG RESULT");
+}
+
+int main(int argc, char **argv)
+{
+    size_t n = argc > 1 ? atol(argv[1]) : 2048, nt;
+    std::string dir = argc > 2 ? argv[2] : "/tmp";
+    std::string txt = dir + "/bench_matrix2d_file.txt",
+                bin = dir + "/bench_matrix2d_file.bin";
+    double hz = timer_calibrate_hz(20000), ref, s;
+    double **m = matrix2d_alloc<double>(n, n);
+    uint64_t t0, t1, t2;
+
+    matrix2d_init_random_double(m, n, n);
+    ref = sum(m, n, n);
+    write_text(txt.c_str(), m, n);
+    if ( matrix2d_file_write(bin.c_str(), m, n, n) )
+        return 1;
+    matrix2d_destroy(m, n);
+
+    printf("%zux%zu doubles, %.1f MB binary\n", n, n,
+           n * matrix2d_default_ld<double>(n) * 8.0 / (1 << 20));
+    printf("%-22s %10s %10s\n", "", "load ms", "+sum ms");
+
+    t0 = timer_read();
+    m = load_text(txt.c_str(), &nt);
+    t1 = timer_read();
+    s = sum(m, nt, nt);
+    t2 = timer_read();
+    report("text + matrix2d_alloc", t1 - t0, t2 - t1, hz, ref, s);
+    matrix2d_destroy(m, nt);
+
+    t0 = timer_read();
+    matrix2d_t<double> r = load_read(bin.c_str());
+    t1 = timer_read();
+    s = sum(r.rows, r.nrows, r.ncols);
+    t2 = timer_read();
+    report("binary, pread", t1 - t0, t2 - t1, hz, ref, s);
+    matrix2d_destroy_contig(r);
+
+    const struct { const char *name; int flags; } modes[] = {
+        { "mmap read-only", MATRIX2D_MAP_RDONLY },
+        { "mmap + sequential", MATRIX2D_MAP_SEQUENTIAL },
+        { "mmap + populate", MATRIX2D_MAP_POPULATE },
+        { "mmap cow", MATRIX2D_MAP_COW },
+        { "mmap cow + populate", MATRIX2D_MAP_COW | MATRIX2D_MAP_POPULATE },
+    };
+    for ( size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++ ) {
+        t0 = timer_read();
+        matrix2d_mmap_t<double> v =
+            matrix2d_file_open<double>(bin.c_str(), modes[i].flags);
+        t1 = timer_read();
+        if ( !v.data )
+            return 1;
+        s = sum(v.rows, v.nrows, v.ncols);
+        t2 = timer_read();
+        report(modes[i].name, t1 - t0, t2 - t1, hz, ref, s);
+        if ( modes[i].flags & MATRIX2D_MAP_COW )
+            v.rows[0][0] += 1.0;  // private copy, file unchanged
+        matrix2d_file_close(v);
+    }
+
+    // Crafted headers must be rejected: nrows * ld * elem_size wrapping
+    // to 0, empty rows with a huge nrows, and a bad alignment
+    int bad_hdr = 0;
+    const struct {
+        const char *name;
+        uint64_t nrows, ncols, ld;
+        uint32_t align;
+    } crafted[] = {
+        { "nrows * ld * elem_size wraps", 1ULL << 61, 1, 8, MATRIX2D_FILE_ALIGN },
+        { "data_offset + data wraps", 1, 1, (1ULL << 61) - 1, MATRIX2D_FILE_ALIGN },
+        { "ld = 0, huge nrows", 1ULL << 60, 0, 0, MATRIX2D_FILE_ALIGN },
+        { "bad align", n, 1, matrix2d_default_ld<double>(n), 3 },
+    };
+    for ( size_t i = 0; i < sizeof(crafted) / sizeof(crafted[0]); i++ ) {
+        matrix2d_file_header_t hdr;
+        int fd = open(bin.c_str(), O_RDWR);
+
+        if ( fd < 0 || pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) )
+            return 1;
+        hdr.nrows = crafted[i].nrows;
+        hdr.ncols = crafted[i].ncols;
+        hdr.ld = crafted[i].ld;
+        hdr.align = crafted[i].align;
+        if ( pwrite(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) )
+            return 1;
+        close(fd);
+
+        matrix2d_mmap_t<double> v = matrix2d_file_open<double>(bin.c_str());
+        printf("crafted header, %-30s %s\n", crafted[i].name,
+               v.data ? "ACCEPTED" : "rejected");
+        if ( v.data ) {
+            matrix2d_file_close(v);
+            bad_hdr++;
+        }
+    }
+
+    unlink(txt.c_str());
+    unlink(bin.c_str());
+    return bad_hdr ? 1 : 0;
+}
@@ -0,0 +1,161 @@
+/**
+ * @file
+ * Batched small-matrix multiply and transpose: matrix2d_fixed vs.
+ * matrices from matrix2d_alloc with run-time sizes, plus the cost of
+ * matrix2d_fixed_inverse.
+ * Usage: bench_matrix2d_fixed [batch size (default 100000)]
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "matrix2d.h"
+#include "matrix2d_fixed.h"
+#include "tsc_x86_64.h"
+
+// Checked at compile time
+constexpr matrix2d_fixed<double, 3, 3> _I3 =
+    matrix2d_fixed<double, 3, 3>::identity();
+static_assert(matrix2d_fixed_mul(_I3, _I3)(2, 2) == 1.0,
+              "constexpr evaluation");
+
+template <typename F>
+static uint64_t time_best(F f, int reps)
+{
+    uint64_t best = UINT64_MAX;
+    tsctimer_t tim;
+
+    for ( int r = 0; r < reps; r++ ) {
+        timer_clear(&tim);
+        timer_start(&tim);
+        f();
+        timer_stop(&tim);
+        if ( tim.total < best )
+            best = tim.total;
+    }
+    return best;
+}
+
+static void mul_dynamic(double **a, double **b, double **c, size_t n)
+{
+    for ( size_t i = 0; i < n; i++ ) {
+        for ( size_t j = 0; j < n; j++ )
+            c[i][j] = 0.0;
+        for ( size_t k = 0; k < n; k++ )
+            for ( size_t j = 0; j < n; j++ )
+                c[i][j] += a[i][k] * b[k][j];
+    }
+}
+
+static void transpose_dynamic(double **a, double **t, size_t n)
+{
+    for ( size_t i = 0; i < n; i++ )
+        for ( size_t j = 0; j < n; j++ )
+            t[j][i] = a[i][j];
+}
+
+template <size_t N>
+static void run(size_t batch, double hz)
+{
+    typedef matrix2d_fixed<double, N, N> mat;
+    mat *fa = new mat [batch], *fb = new mat [batch], *fc = new mat [batch];
+    double ***da = new double** [batch], ***db = new double** [batch],
+           ***dc = new double** [batch];
+    double err = 0.0, ns[5];
+    uint64_t t;
+
+    for ( size_t m = 0; m < batch; m++ ) {
+        da[m] = matrix2d_alloc<double>(N, N);
+        db[m] = matrix2d_alloc<double>(N, N);
+        dc[m] = matrix2d_alloc<double>(N, N);
+        matrix2d_init_random_double(da[m], N, N);
+        matrix2d_init_random_double(db[m], N, N);
+        for ( size_t i = 0; i < N; i++ ) {
+            // Diagonally dominant, so that every matrix is invertible
+            da[m][i][i] += 10.0 * N;
+            for ( size_t j = 0; j < N; j++ ) {
+                fa[m](i, j) = da[m][i][j];
+                fb[m](i, j) = db[m][i][j];
+            }
+        }
+    }
+
+    t = time_best([&]() {
+        for ( size_t m = 0; m < batch; m++ )
+            mul_dynamic(da[m], db[m], dc[m], N);
+    }, 5);
+    ns[0] = t / hz * 1e9 / batch;
+
+    t = time_best([&]() {
+        for ( size_t m = 0; m < batch; m++ )
+            fc[m] = matrix2d_fixed_mul(fa[m], fb[m]);
+    }, 5);
+    ns[1] = t / hz * 1e9 / batch;
+
+    for ( size_t m = 0; m < batch; m++ )
+        for ( size_t i = 0; i < N; i++ )
+            for ( size_t j = 0; j < N; j++ )
+                err = std::fmax(err, std::fabs(fc[m](i, j) - dc[m][i][j]));
+
+    t = time_best([&]() {
+        for ( size_t m = 0; m < batch; m++ )
+            transpose_dynamic(da[m], dc[m], N);
+    }, 5);
+    ns[2] = t / hz * 1e9 / batch;
+
+    t = time_best([&]() {
+        for ( size_t m = 0; m < batch; m++ )
+            fb[m] = matrix2d_fixed_transpose(fa[m]);
+    }, 5);
+    ns[3] = t / hz * 1e9 / batch;
+
+    t = time_best([&]() {
+        for ( size_t m = 0; m < batch; m++ )
+            matrix2d_fixed_inverse(fa[m], fc[m]);
+    }, 5);
+    ns[4] = t / hz * 1e9 / batch;
+
+    // Residual of A * inv(A) against the identity
+    for ( size_t m = 0; m < batch; m++ ) {
+        mat p = matrix2d_fixed_mul(fa[m], fc[m]);
+        for ( size_t i = 0; i < N; i++ )
+            for ( size_t j = 0; j < N; j++ )
+                err = std::fmax(err, std::fabs(p(i, j) - (i == j)));
+    }
+
+    printf("%4zu %10.1f %10.1f %7.1fx %10.1f %10.1f %7.1fx %10.1f %10.1e\n",
+           N, ns[0], ns[1], ns[0] / ns[1], ns[2], ns[3], ns[2] / ns[3],
+           ns[4], err);
+
+    for ( size_t m = 0; m < batch; m++ ) {
+        matrix2d_destroy(da[m], N);
+        matrix2d_destroy(db[m], N);
+        matrix2d_destroy(dc[m], N);
+    }
+    delete [] da;
+    delete [] db;
+    delete [] dc;
+    delete [] fa;
+    delete [] fb;
+    delete [] fc;
+}
+
+int main(int argc, char **argv)
+{
+    size_t batch = argc > 1 ? atol(argv[1]) : 100000;
+    double hz = timer_calibrate_hz(20000);
+
+    printf("batch of %zu, ns per matrix\n", batch);
+    printf("%4s %10s %10s %8s %10s %10s %8s %10s %10s\n", "n",
+           "mul dyn", "mul fix", "speedup", "tr dyn", "tr fix", "speedup",
+           "inv fix", "max err");
+    run<3>(batch, hz);
+    run<4>(batch, hz);
+    run<6>(batch, hz);
+    run<8>(batch, hz);
+    run<12>(batch, hz);
+    run<16>(batch, hz);
+
+    return 0;
+}
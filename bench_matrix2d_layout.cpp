@@ -0,0 +1,92 @@
+/**
+ * @file
+ * Row and column traversal of per-row allocated matrices vs.
+ * contiguous matrices with and without leading-dimension padding
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "matrix2d.h"
+#include "tsc_x86_64.h"
+
+static double sum_rows(double **m, size_t nrows, size_t ncols)
+{
+    double s = 0.0;
+
+    for ( size_t i = 0; i < nrows; i++ )
+        for ( size_t j = 0; j < ncols; j++ )
+            s += m[i][j];
+    return s;
+}
+
+static double sum_cols(double **m, size_t nrows, size_t ncols)
+{
+    double s = 0.0;
+
+    for ( size_t j = 0; j < ncols; j++ )
+        for ( size_t i = 0; i < nrows; i++ )
+            s += m[i][j];
+    return s;
+}
+
+/**
+ * Times both traversals, best of 'reps'
+ */
+static void run(const char *label, double **m, size_t n, int reps)
+{
+    tsctimer_t tim;
+    uint64_t best_r = UINT64_MAX, best_c = UINT64_MAX;
+    double s = 0.0;
+
+    matrix2d_init(m, n, n, 1.0);
+
+    for ( int r = 0; r < reps; r++ ) {
+        timer_clear(&tim);
+        timer_start(&tim);
+        s += sum_rows(m, n, n);
+        timer_stop(&tim);
+        if ( tim.total < best_r )
+            best_r = tim.total;
+
+        timer_clear(&tim);
+        timer_start(&tim);
+        s += sum_cols(m, n, n);
+        timer_stop(&tim);
+        if ( tim.total < best_c )
+            best_c = tim.total;
+    }
+
+    printf("%6zu %-22s %10.2f %10.2f %s\n", n, label,
+           (double)best_r / (n * n), (double)best_c / (n * n),
+           s == 2.0 * reps * n * n ? "" : "(wrong sum)");
+}
+
+int main(int argc, char **argv)
+{
+    size_t sizes[] = { 512, 1024, 2048, 4096 };
+    int reps = argc > 1 ? atoi(argv[1]) : 3;
+
+    printf("Cycles per element (best of %d)\n", reps);
+    printf("%6s %-22s %10s %10s\n", "n", "layout", "row-wise", "col-wise");
+
+    for ( size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++ ) {
+        size_t n = sizes[k];
+
+        double **a = matrix2d_alloc<double>(n, n);
+        run("per-row new", a, n, reps);
+        matrix2d_destroy(a, n);
+
+        matrix2d_t<double> c = matrix2d_alloc_contig<double>(n, n, n);
+        run("contiguous, ld=n", c.rows, n, reps);
+        matrix2d_destroy_contig(c);
+
+        matrix2d_t<double> p = matrix2d_alloc_contig<double>(n, n);
+        char label[32];
+        snprintf(label, sizeof(label), "contiguous, ld=%zu", p.ld);
+        run(label, p.rows, n, reps);
+        matrix2d_destroy_contig(p);
+    }
+
+    return 0;
+}
@@ -0,0 +1,104 @@
+/**
+ * @file
+ * Scaling of parallel, first-touch matrix init/copy/multiply from one
+ * thread to all cpus.
+ * Usage: bench_matrix2d_parallel [n for init/copy] [n for gemm]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "matrix2d.h"
+#include "matrix2d_gemm.h"
+#include "matrix2d_parallel.h"
+#include "processor_map.h"
+#include "tsc_x86_64.h"
+
+template <typename F>
+static double seconds_best(F f, int reps, double hz)
+{
+    uint64_t best = UINT64_MAX;
+    tsctimer_t tim;
+
+    for ( int r = 0; r < reps; r++ ) {
+        timer_clear(&tim);
+        timer_start(&tim);
+        f();
+        timer_stop(&tim);
+        if ( tim.total < best )
+            best = tim.total;
+    }
+    return best / hz;
+}
+
+int main(int argc, char **argv)
+{
+    size_t n = argc > 1 ? atol(argv[1]) : 8192;
+    size_t ng = argc > 2 ? atol(argv[2]) : 2048;
+    procmap_t *pi = procmap_init();
+    double hz = timer_calibrate_hz(20000);
+    double base_init = 0, base_copy = 0, base_gemm = 0;
+    int threads[64], nt = 0;
+
+    matrix2d_gemm_init(pi);
+
+    for ( int t = 1; t < pi->num_cpus && nt < 63; t *= 2 )
+        threads[nt++] = t;
+    threads[nt++] = pi->num_cpus;
+
+    printf("init/copy: %zux%zu doubles, gemm: %zux%zu\n", n, n, ng, ng);
+    printf("%8s %12s %8s %12s %8s %12s %8s\n", "threads", "init GB/s",
+           "speedup", "copy GB/s", "speedup", "gemm GF/s", "speedup");
+
+    for ( int i = 0; i < nt; i++ ) {
+        int p = threads[i];
+        double bytes = (double)n * n * sizeof(double), s;
+        double init_bw, copy_bw, gf;
+
+        matrix2d_t<double> a = matrix2d_alloc_contig_par<double>(n, n, pi, p),
+                           b = matrix2d_alloc_contig_par<double>(n, n, pi, p);
+
+        s = seconds_best([&]() {
+            matrix2d_init_par(a.rows, n, n, 1.0, pi, p);
+        }, 3, hz);
+        init_bw = bytes / s / 1e9;
+
+        s = seconds_best([&]() {
+            matrix2d_copy_par(a.rows, b.rows, n, n, pi, p);
+        }, 3, hz);
+        copy_bw = 2 * bytes / s / 1e9;
+
+        matrix2d_destroy_contig(a);
+        matrix2d_destroy_contig(b);
+
+        matrix2d_t<double> A = matrix2d_alloc_contig_par<double>(ng, ng, pi, p),
+                           B = matrix2d_alloc_contig_par<double>(ng, ng, pi, p),
+                           C = matrix2d_alloc_contig_par<double>(ng, ng, pi, p);
+        matrix2d_init_par(A.rows, ng, ng, 0.5, pi, p);
+        matrix2d_init_par(B.rows, ng, ng, 2.0, pi, p);
+
+        s = seconds_best([&]() {
+            matrix2d_gemm_par(ng, ng, ng, 1.0, A.rows, B.rows, 0.0, C.rows,
+                              pi, p);
+        }, 2, hz);
+        gf = 2.0 * ng * ng * ng / s / 1e9;
+        if ( C.rows[ng-1][ng-1] != (double)ng )
+            printf("wrong gemm result\n");
+
+        matrix2d_destroy_contig(A);
+        matrix2d_destroy_contig(B);
+        matrix2d_destroy_contig(C);
+
+        if ( i == 0 ) {
+            base_init = init_bw;
+            base_copy = copy_bw;
+            base_gemm = gf;
+        }
+        printf("%8d %12.2f %8.2f %12.2f %8.2f %12.2f %8.2f\n", p,
+               init_bw, init_bw / base_init, copy_bw, copy_bw / base_copy,
+               gf, gf / base_gemm);
+    }
+
+    procmap_destroy(pi);
+    return 0;
+}
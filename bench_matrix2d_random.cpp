@@ -0,0 +1,137 @@
+/**
+ * @file
+ * Elements/sec of random matrix initialization: rand()-based
+ * matrix2d_init_random_double() vs. the counter-based generators,
+ * from one thread to all cpus; checks that the parallel result does
+ * not depend on the number of threads, and the vectorized Box-Muller
+ * step against std::log/std::sin/std::cos.
+ * Usage: bench_matrix2d_random [n (default 4096)]
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "matrix2d.h"
+#include "matrix2d_parallel.h"
+#include "matrix2d_random.h"
+#include "processor_map.h"
+#include "tsc_x86_64.h"
+
+template <typename F>
+static uint64_t time_best(F f, int reps)
+{
+    uint64_t best = UINT64_MAX;
+    tsctimer_t tim;
+
+    for ( int r = 0; r < reps; r++ ) {
+        timer_clear(&tim);
+        timer_start(&tim);
+        f();
+        timer_stop(&tim);
+        if ( tim.total < best )
+            best = tim.total;
+    }
+    return best;
+}
+
+/**
+ * @return largest difference between matrix2d_rng_normal() and
+ *         Box-Muller with the std:: functions over n values
+ */
+static double normal_error(size_t n)
+{
+    double *u = new double [n], *z = new double [n], err = 0.0;
+
+    matrix2d_rng_uniform(7, 0, n, 0.0, 1.0, u);
+    matrix2d_rng_normal(7, 0, n, 0.0, 1.0, z);
+    for ( size_t p = 0; p + 1 < n; p += 2 ) {
+        double r = std::sqrt(-2.0 * std::log(1.0 - u[p]));
+        double t = 2.0 * M_PI * u[p + 1];
+        err = std::fmax(err, std::fabs(z[p] - r * std::cos(t)));
+        err = std::fmax(err, std::fabs(z[p + 1] - r * std::sin(t)));
+    }
+
+    delete [] u;
+    delete [] z;
+    return err;
+}
+
+static bool same(const matrix2d_t<double>& a, const matrix2d_t<double>& b)
+{
+    for ( size_t i = 0; i < a.nrows; i++ )
+        if ( memcmp(a.rows[i], b.rows[i], a.ncols * sizeof(double)) )
+            return false;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    size_t n = argc > 1 ? atol(argv[1]) : 4096;
+    procmap_t *pi = procmap_init();
+    double hz = timer_calibrate_hz(20000), elems = (double)n * n;
+    matrix2d_t<double> a = matrix2d_alloc_contig<double>(n, n),
+                       b = matrix2d_alloc_contig<double>(n, n);
+    double s = 0.0, ss = 0.0, err;
+    uint64_t t;
+
+    matrix2d_init(a.rows, n, n, 0.0);
+    matrix2d_init(b.rows, n, n, 0.0);
+
+    printf("%zux%zu doubles, uniform kernel: %s\n", n, n,
+           matrix2d_rng_kernel_name());
+    printf("%-36s %10s\n", "", "Melem/s");
+
+    t = time_best([&]() { matrix2d_init_random_double(a.rows, n, n); }, 2);
+    printf("%-36s %10.1f\n", "matrix2d_init_random_double (rand)",
+           elems / (t / hz) / 1e6);
+
+    t = time_best([&]() {
+        matrix2d_init_random_uniform(a.rows, n, n, 0.0, 10.0, 42);
+    }, 3);
+    printf("%-36s %10.1f\n", "uniform, serial", elems / (t / hz) / 1e6);
+
+    t = time_best([&]() {
+        matrix2d_init_random_normal(a.rows, n, n, 0.0, 1.0, 42);
+    }, 3);
+    printf("%-36s %10.1f\n", "normal, serial", elems / (t / hz) / 1e6);
+
+    for ( int p = 1; ; p = p * 2 < pi->num_cpus ? p * 2 : pi->num_cpus ) {
+        char name[64];
+
+        t = time_best([&]() {
+            matrix2d_init_random_uniform_par(b.rows, n, n, 0.0, 10.0, 42,
+                                             pi, p);
+        }, 3);
+        snprintf(name, sizeof(name), "uniform, %d threads", p);
+        printf("%-36s %10.1f\n", name, elems / (t / hz) / 1e6);
+
+        t = time_best([&]() {
+            matrix2d_init_random_normal_par(b.rows, n, n, 0.0, 1.0, 42,
+                                            pi, p);
+        }, 3);
+        snprintf(name, sizeof(name), "normal, %d threads", p);
+        printf("%-36s %10.1f%s\n", name, elems / (t / hz) / 1e6,
+               same(a, b) ? "" : "  DIFFERS FROM SERIAL");
+
+        if ( p == pi->num_cpus )
+            break;
+    }
+
+    for ( size_t i = 0; i < n; i++ )
+        for ( size_t j = 0; j < n; j++ ) {
+            s += b.rows[i][j];
+            ss += b.rows[i][j] * b.rows[i][j];
+        }
+    printf("normal(0, 1): sample mean %.4f, stddev %.4f\n", s / elems,
+           std::sqrt(ss / elems - (s / elems) * (s / elems)));
+
+    err = normal_error(1 << 20);
+    printf("normal vs. std::log/sin/cos: max error %.2e\n", err);
+
+    matrix2d_destroy_contig(a);
+    matrix2d_destroy_contig(b);
+    procmap_destroy(pi);
+    return err < 1e-12 ? 0 : 1;
+}
@@ -0,0 +1,218 @@
+/**
+ * @file
+ * Reductions of matrix2d_reduce.h against the scalar loops they
+ * replace (column sums and the 1-norm walking down columns), and their
+ * multi-threaded versions on all cpus. Results are checked against the
+ * scalar loops.
+ * Usage: bench_matrix2d_reduce [nrows (default 4096)] [ncols (default 4096)]
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "matrix2d.h"
+#include "matrix2d_parallel.h"
+#include "matrix2d_random.h"
+#include "matrix2d_reduce.h"
+#include "processor_map.h"
+#include "tsc_x86_64.h"
+
+template <typename F>
+static double seconds_best(F f, int reps, double hz)
+{
+    uint64_t best = UINT64_MAX;
+    tsctimer_t tim;
+
+    for ( int r = 0; r < reps; r++ ) {
+        timer_clear(&tim);
+        timer_start(&tim);
+        f();
+        timer_stop(&tim);
+        if ( tim.total < best )
+            best = tim.total;
+    }
+    return best / hz;
+}
+
+static int close(double a, double b)
+{
+    return std::fabs(a - b) <= 1e-9 * std::fmax(1.0, std::fabs(b));
+}
+
+static int close_vec(const double *a, const double *b, size_t n)
+{
+    for ( size_t i = 0; i < n; i++ )
+        if ( !close(a[i], b[i]) )
+            return 0;
+    return 1;
+}
+
+static void report(const char *name, double bytes, double ts, double tv,
+                   double tp, int ok)
+{
+    printf("%-12s %10.2f %10.2f %8.2f %10.2f   %s\n", name, bytes / ts / 1e9,
+           bytes / tv / 1e9, ts / tv, bytes / tp / 1e9, ok ? "ok" : "MISMATCH");
+}
+
+int main(int argc, char **argv)
+{
+    size_t nr = argc > 1 ? atol(argv[1]) : 4096;
+    size_t nc = argc > 2 ? atol(argv[2]) : 4096;
+    procmap_t *pi = procmap_init();
+    int p = pi->num_cpus, bad = 0;
+    double hz = timer_calibrate_hz(20000);
+    double **A = matrix2d_alloc_par<double>(nr, nc, pi, p),
+           **B = matrix2d_alloc_par<double>(nr, nc, pi, p);
+    double *ref = new double [nr > nc ? nr : nc],
+           *out = new double [nr > nc ? nr : nc];
+    double bytes = (double)nr * nc * sizeof(double);
+    double ts, tv, tp, rs = 0, rv = 0, rp = 0;
+    size_t ri = 0, rj = 0, vi = 0, vj = 0, pi_ = 0, pj = 0;
+
+    matrix2d_init_random_uniform_par(A, nr, nc, -1.0, 1.0, 7, pi, p);
+    matrix2d_init_random_uniform_par(B, nr, nc, -1.0, 1.0, 8, pi, p);
+    A[nr / 3][nc / 5] = 2.0;   // unique max
+    A[nr / 2][nc - 1] = -2.0;  // unique min, in a row tail
+
+    printf("%zux%zu doubles, %d threads, kernels %s\n", nr, nc, p,
+           matrix2d_reduce_kernel_name());
+    printf("%-12s %10s %10s %8s %10s\n", "GB/s", "scalar", "simd", "speedup",
+           "threads");
+
+    // sum
+    ts = seconds_best([&]() {
+        rs = 0.0;
+        for ( size_t i = 0; i < nr; i++ )
+            for ( size_t j = 0; j < nc; j++ )
+                rs += A[i][j];
+    }, 3, hz);
+    tv = seconds_best([&]() { rv = matrix2d_sum(A, nr, nc); }, 3, hz);
+    tp = seconds_best([&]() { rp = matrix2d_sum_par(A, nr, nc, pi, p); }, 3, hz);
+    report("sum", bytes, ts, tv, tp, close(rv, rs) && close(rp, rs));
+    bad += !(close(rv, rs) && close(rp, rs));
+
+    // Frobenius norm
+    ts = seconds_best([&]() {
+        rs = 0.0;
+        for ( size_t i = 0; i < nr; i++ )
+            for ( size_t j = 0; j < nc; j++ )
+                rs += A[i][j] * A[i][j];
+        rs = std::sqrt(rs);
+    }, 3, hz);
+    tv = seconds_best([&]() { rv = matrix2d_norm_fro(A, nr, nc); }, 3, hz);
+    tp = seconds_best([&]() { rp = matrix2d_norm_fro_par(A, nr, nc, pi, p); }, 3, hz);
+    report("norm fro", bytes, ts, tv, tp, close(rv, rs) && close(rp, rs));
+    bad += !(close(rv, rs) && close(rp, rs));
+
+    // 1-norm, by columns
+    ts = seconds_best([&]() {
+        rs = 0.0;
+        for ( size_t j = 0; j < nc; j++ ) {
+            double s = 0.0;
+            for ( size_t i = 0; i < nr; i++ )
+                s += std::fabs(A[i][j]);
+            rs = std::fmax(rs, s);
+        }
+    }, 3, hz);
+    tv = seconds_best([&]() { rv = matrix2d_norm_1(A, nr, nc); }, 3, hz);
+    tp = seconds_best([&]() { rp = matrix2d_norm_1_par(A, nr, nc, pi, p); }, 3, hz);
+    report("norm 1", bytes, ts, tv, tp, close(rv, rs) && close(rp, rs));
+    bad += !(close(rv, rs) && close(rp, rs));
+
+    // Infinity norm
+    ts = seconds_best([&]() {
+        rs = 0.0;
+        for ( size_t i = 0; i < nr; i++ ) {
+            double s = 0.0;
+            for ( size_t j = 0; j < nc; j++ )
+                s += std::fabs(A[i][j]);
+            rs = std::fmax(rs, s);
+        }
+    }, 3, hz);
+    tv = seconds_best([&]() { rv = matrix2d_norm_inf(A, nr, nc); }, 3, hz);
+    tp = seconds_best([&]() { rp = matrix2d_norm_inf_par(A, nr, nc, pi, p); }, 3, hz);
+    report("norm inf", bytes, ts, tv, tp, close(rv, rs) && close(rp, rs));
+    bad += !(close(rv, rs) && close(rp, rs));
+
+    // min and max with position
+    for ( int mx = 0; mx < 2; mx++ ) {
+        int ok;
+
+        ts = seconds_best([&]() {
+            rs = A[0][0];
+            ri = rj = 0;
+            for ( size_t i = 0; i < nr; i++ )
+                for ( size_t j = 0; j < nc; j++ )
+                    if ( mx ? A[i][j] > rs : A[i][j] < rs ) {
+                        rs = A[i][j];
+                        ri = i;
+                        rj = j;
+                    }
+        }, 3, hz);
+        tv = seconds_best([&]() {
+            rv = mx ? matrix2d_max(A, nr, nc, &vi, &vj)
+                    : matrix2d_min(A, nr, nc, &vi, &vj);
+        }, 3, hz);
+        tp = seconds_best([&]() {
+            rp = mx ? matrix2d_max_par(A, nr, nc, &pi_, &pj, pi, p)
+                    : matrix2d_min_par(A, nr, nc, &pi_, &pj, pi, p);
+        }, 3, hz);
+        ok = rv == rs && rp == rs && vi == ri && vj == rj && pi_ == ri &&
+             pj == rj;
+        report(mx ? "max + index" : "min + index", bytes, ts, tv, tp, ok);
+        bad += !ok;
+    }
+
+    // row sums
+    ts = seconds_best([&]() {
+        for ( size_t i = 0; i < nr; i++ ) {
+            double s = 0.0;
+            for ( size_t j = 0; j < nc; j++ )
+                s += A[i][j];
+            ref[i] = s;
+        }
+    }, 3, hz);
+    tv = seconds_best([&]() { matrix2d_row_sums(A, nr, nc, out); }, 3, hz);
+    bad += !close_vec(out, ref, nr);
+    tp = seconds_best([&]() { matrix2d_row_sums_par(A, nr, nc, out, pi, p); }, 3, hz);
+    report("row sums", bytes, ts, tv, tp, close_vec(out, ref, nr));
+    bad += !close_vec(out, ref, nr);
+
+    // column sums, by columns
+    ts = seconds_best([&]() {
+        for ( size_t j = 0; j < nc; j++ ) {
+            double s = 0.0;
+            for ( size_t i = 0; i < nr; i++ )
+                s += A[i][j];
+            ref[j] = s;
+        }
+    }, 3, hz);
+    tv = seconds_best([&]() { matrix2d_col_sums(A, nr, nc, out); }, 3, hz);
+    bad += !close_vec(out, ref, nc);
+    tp = seconds_best([&]() { matrix2d_col_sums_par(A, nr, nc, out, pi, p); }, 3, hz);
+    report("col sums", bytes, ts, tv, tp, close_vec(out, ref, nc));
+    bad += !close_vec(out, ref, nc);
+
+    // row-by-row dot products (two matrices read)
+    ts = seconds_best([&]() {
+        for ( size_t i = 0; i < nr; i++ ) {
+            double s = 0.0;
+            for ( size_t j = 0; j < nc; j++ )
+                s += A[i][j] * B[i][j];
+            ref[i] = s;
+        }
+    }, 3, hz);
+    tv = seconds_best([&]() { matrix2d_row_dots(A, B, nr, nc, out); }, 3, hz);
+    bad += !close_vec(out, ref, nr);
+    tp = seconds_best([&]() { matrix2d_row_dots_par(A, B, nr, nc, out, pi, p); }, 3, hz);
+    report("row dots", 2 * bytes, ts, tv, tp, close_vec(out, ref, nr));
+    bad += !close_vec(out, ref, nr);
+
+    delete [] ref;
+    delete [] out;
+    matrix2d_destroy(A, nr);
+    matrix2d_destroy(B, nr);
+    procmap_destroy(pi);
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,108 @@
+/**
+ * @file
+ * Grid updates per second of 5-point and 9-point stencils: naive
+ * sweeps against temporally blocked sweeps on all cpus, for several
+ * numbers of time steps per tile. Every result is checked against the
+ * naive one.
+ * Usage: bench_matrix2d_stencil [n (default 4096)] [steps (default 16)]
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "matrix2d.h"
+#include "matrix2d_parallel.h"
+#include "matrix2d_stencil.h"
+#include "processor_map.h"
+#include "tsc_x86_64.h"
+
+static void init_grid(double **m, size_t n)
+{
+    for ( size_t i = 0; i < n; i++ )
+        for ( size_t j = 0; j < n; j++ )
+            m[i][j] = (i == 0 || j == 0) ? 1.0 : (double)((i * 31 + j * 17) % 97) / 97;
+}
+
+/**
+ * Best of reps runs of f on a freshly initialised grid
+ */
+template <typename F>
+static double seconds_best(double **a, size_t n, F f, int reps, double hz)
+{
+    uint64_t best = UINT64_MAX;
+    tsctimer_t tim;
+
+    for ( int r = 0; r < reps; r++ ) {
+        init_grid(a, n);
+        timer_clear(&tim);
+        timer_start(&tim);
+        f();
+        timer_stop(&tim);
+        if ( tim.total < best )
+            best = tim.total;
+    }
+    return best / hz;
+}
+
+template <typename K>
+static int run(const char *name, K k, size_t n, int steps, procmap_t *pi,
+               double hz)
+{
+    int nthreads = pi->num_cpus;
+    double **a = matrix2d_alloc_par<double>(n, n, pi, nthreads),
+           **b = matrix2d_alloc_par<double>(n, n, pi, nthreads),
+           **ref = matrix2d_alloc_par<double>(n, n, pi, nthreads),
+           **r;
+    double updates = (double)(n - 2) * (n - 2) * steps, base;
+    int tsteps[] = { 1, 2, 4, 8 }, bad = 0;
+
+    base = seconds_best(a, n, [&]() {
+        r = matrix2d_stencil_naive(a, b, n, n, steps, k);
+    }, 3, hz);
+    matrix2d_copy(r, ref, n, n);
+
+    printf("%s, %zux%zu, %d steps, %d threads\n", name, n, n, steps, nthreads);
+    printf("%-22s %12s %8s %12s\n", "", "Mupdates/s", "speedup", "max error");
+    printf("%-22s %12.1f %8.2f %12s\n", "naive", updates / base / 1e6, 1.0, "-");
+
+    for ( size_t t = 0; t < sizeof(tsteps) / sizeof(tsteps[0]); t++ ) {
+        char label[32];
+        double err = 0.0, s;
+
+        s = seconds_best(a, n, [&]() {
+            r = matrix2d_stencil(a, b, n, n, steps, k, pi, nthreads, tsteps[t]);
+        }, 3, hz);
+
+        for ( size_t i = 0; i < n; i++ )
+            for ( size_t j = 0; j < n; j++ )
+                err = std::fmax(err, std::fabs(r[i][j] - ref[i][j]));
+        bad += err > 0.0;
+
+        snprintf(label, sizeof(label), "blocked, %d steps/tile", tsteps[t]);
+        printf("%-22s %12.1f %8.2f %12.2e\n", label, updates / s / 1e6,
+               base / s, err);
+    }
+
+    matrix2d_destroy(a, n);
+    matrix2d_destroy(b, n);
+    matrix2d_destroy(ref, n);
+    return bad;
+}
+
+int main(int argc, char **argv)
+{
+    size_t n = argc > 1 ? atol(argv[1]) : 4096;
+    int steps = argc > 2 ? atoi(argv[2]) : 16;
+    procmap_t *pi = procmap_init();
+    double hz = timer_calibrate_hz(20000);
+    int bad = 0;
+
+    bad += run("5-point", matrix2d_stencil5<double>{ 0.5, 0.125 }, n, steps,
+               pi, hz);
+    bad += run("9-point", matrix2d_stencil9<double>{ 0.4, 0.1, 0.05 }, n,
+               steps, pi, hz);
+
+    procmap_destroy(pi);
+    return bad ? 1 : 0;
+}
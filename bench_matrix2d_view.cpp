@@ -0,0 +1,179 @@
+/**
+ * @file
+ * Checks matrix views (submatrix, row, column, diagonal, nested and
+ * strided) and times a blocked algorithm that copies every block out
+ * and back against the same algorithm working on views.
+ * Usage: bench_matrix2d_view [n (default 4096)] [block (default 256)]
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "matrix2d.h"
+#include "matrix2d_gemm.h"
+#include "matrix2d_view.h"
+#include "tsc_x86_64.h"
+
+template <typename F>
+static uint64_t time_best(F f, int reps)
+{
+    uint64_t best = UINT64_MAX;
+    tsctimer_t tim;
+
+    for ( int r = 0; r < reps; r++ ) {
+        timer_clear(&tim);
+        timer_start(&tim);
+        f();
+        timer_stop(&tim);
+        if ( tim.total < best )
+            best = tim.total;
+    }
+    return best;
+}
+
+/**
+ * Block kernel: x = x*a + b over an nrows x ncols block (anything
+ * indexable as m[i][j])
+ */
+template <typename M>
+static void axpb(M m, size_t nrows, size_t ncols, double a, double b)
+{
+    for ( size_t i = 0; i < nrows; i++ )
+        for ( size_t j = 0; j < ncols; j++ )
+            m[i][j] = m[i][j] * a + b;
+}
+
+static int check(void)
+{
+    const size_t n = 8;
+    double **m = matrix2d_alloc<double>(n, n);
+    matrix2d_view<double> v = matrix2d_view_of(m, n, n);
+    int bad = 0;
+
+    for ( size_t i = 0; i < n; i++ )
+        for ( size_t j = 0; j < n; j++ )
+            m[i][j] = 10 * i + j;
+
+    // Nested submatrix: rows 2..5, columns 3..6, then its [1..2]x[1..2]
+    matrix2d_view<double> s = matrix2d_sub(v, 2, 3, 4, 4);
+    matrix2d_view<double> ss = matrix2d_sub(s, 1, 1, 2, 2);
+    bad += s(0, 0) != 23 || s(3, 3) != 56 || ss(0, 0) != 34 || ss(1, 1) != 45;
+
+    // Every other row and column
+    matrix2d_view<double> st = matrix2d_sub(v, 1, 0, 4, 4, 2, 2);
+    bad += st(0, 0) != 10 || st(1, 1) != 32 || st(3, 3) != 76;
+
+    // Row, column, diagonals, a diagonal of a submatrix
+    bad += matrix2d_row(v, 4)(0, 5) != 45;
+    bad += matrix2d_col(v, 6)(7, 0) != 76;
+    bad += matrix2d_diag(v)(5, 0) != 55 || matrix2d_diag(v).nrows != n;
+    bad += matrix2d_diag(v, 2)(1, 0) != 13 || matrix2d_diag(v, 2).nrows != 6;
+    bad += matrix2d_diag(v, -3)(0, 0) != 30;
+    bad += matrix2d_diag(s)(2, 0) != 45;
+    bad += matrix2d_diag(st)(3, 0) != 76;
+
+    // Existing templates on views
+    matrix2d_view<double> d = matrix2d_diag(v);
+    matrix2d_init(d, d.nrows, d.ncols, -1.0);
+    bad += m[3][3] != -1.0 || m[3][4] != 34;
+    matrix2d_copy(matrix2d_col(v, 0), matrix2d_col(v, 7), n, 1);
+    bad += m[0][7] != -1.0 || m[5][7] != 50;
+
+    printf("view checks: %s\n", bad ? "FAILED" : "passed");
+    matrix2d_print(ss, ss.nrows, ss.ncols);
+
+    matrix2d_destroy(m, n);
+    return bad;
+}
+
+int main(int argc, char **argv)
+{
+    size_t n = argc > 1 ? atol(argv[1]) : 4096;
+    size_t b = argc > 2 ? atol(argv[2]) : 256;
+    double hz = timer_calibrate_hz(20000);
+    matrix2d_t<double> A = matrix2d_alloc_contig<double>(n, n);
+    double **tmp = matrix2d_alloc<double>(b, b);
+    matrix2d_view<double> v = matrix2d_view_of(A);
+    uint64_t t_copy, t_view;
+    int bad = check();
+
+    matrix2d_init(A.rows, n, n, 1.0);
+
+    // Blocked pass over A, copying every block out and back
+    t_copy = time_best([&]() {
+        for ( size_t i = 0; i < n; i += b )
+            for ( size_t j = 0; j < n; j += b ) {
+                size_t bi = n - i < b ? n - i : b, bj = n - j < b ? n - j : b;
+                matrix2d_view<double> blk = matrix2d_sub(v, i, j, bi, bj);
+                matrix2d_copy(blk, tmp, bi, bj);
+                axpb(tmp, bi, bj, 0.5, 0.5);
+                matrix2d_copy(tmp, blk, bi, bj);
+            }
+    }, 3);
+
+    // Same pass, in place through views
+    t_view = time_best([&]() {
+        for ( size_t i = 0; i < n; i += b )
+            for ( size_t j = 0; j < n; j += b ) {
+                size_t bi = n - i < b ? n - i : b, bj = n - j < b ? n - j : b;
+                axpb(matrix2d_sub(v, i, j, bi, bj), bi, bj, 0.5, 0.5);
+            }
+    }, 3);
+
+    for ( size_t i = 0; i < n; i++ )
+        for ( size_t j = 0; j < n; j++ )
+            bad += A.rows[i][j] != 1.0;
+
+    printf("%zux%zu doubles, %zux%zu blocks\n", n, n, b, b);
+    printf("%-20s %10.2f ms\n", "copy out/in", t_copy / hz * 1e3);
+    printf("%-20s %10.2f ms  (%.2fx)\n", "views", t_view / hz * 1e3,
+           (double)t_copy / t_view);
+
+    // 2x2 blocked multiply of the top-left 2h x 2h, with matrix2d_gemm
+    // running on row pointers into views of A, B and C
+    {
+        size_t h = n / 2 < 256 ? n / 2 : 256;
+        matrix2d_t<double> B = matrix2d_alloc_contig<double>(2 * h, 2 * h),
+                           C = matrix2d_alloc_contig<double>(2 * h, 2 * h),
+                           R = matrix2d_alloc_contig<double>(2 * h, 2 * h);
+        matrix2d_view<double> vb = matrix2d_view_of(B), vc = matrix2d_view_of(C);
+        double **pa = new double* [h], **pb = new double* [h],
+               **pc = new double* [h], err = 0.0;
+
+        for ( size_t i = 0; i < 2 * h; i++ )
+            for ( size_t j = 0; j < 2 * h; j++ ) {
+                A.rows[i][j] = (double)((i * 7 + j) % 13) - 6;
+                B.rows[i][j] = (double)((i + 3 * j) % 11) - 5;
+            }
+        matrix2d_gemm(2 * h, 2 * h, 2 * h, 1.0, A.rows, B.rows, 0.0, R.rows);
+        matrix2d_init(C.rows, 2 * h, 2 * h, 0.0);
+
+        for ( size_t bi = 0; bi < 2; bi++ )
+            for ( size_t bj = 0; bj < 2; bj++ )
+                for ( size_t bk = 0; bk < 2; bk++ )
+                    matrix2d_gemm(h, h, h, 1.0,
+                        matrix2d_view_rowptrs(matrix2d_sub(v, bi * h, bk * h, h, h), pa),
+                        matrix2d_view_rowptrs(matrix2d_sub(vb, bk * h, bj * h, h, h), pb),
+                        1.0,
+                        matrix2d_view_rowptrs(matrix2d_sub(vc, bi * h, bj * h, h, h), pc));
+
+        for ( size_t i = 0; i < 2 * h; i++ )
+            for ( size_t j = 0; j < 2 * h; j++ )
+                err = std::fmax(err, std::fabs(C.rows[i][j] - R.rows[i][j]));
+        printf("blocked gemm on views (%zux%zu blocks): max error %.2e\n",
+               h, h, err);
+        bad += err > 1e-9;
+
+        delete [] pa;
+        delete [] pb;
+        delete [] pc;
+        matrix2d_destroy_contig(B);
+        matrix2d_destroy_contig(C);
+        matrix2d_destroy_contig(R);
+    }
+
+    matrix2d_destroy(tmp, b);
+    matrix2d_destroy_contig(A);
+    return bad ? 1 : 0;
+}
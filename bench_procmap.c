@@ -0,0 +1,141 @@
+/**
+ * @file
+ * Cost of building the processor map: time of procmap_init() plus
+ * procmap_destroy(), and the number of file descriptors left open
+ * afterwards (should be 0). Then the cost of topology queries
+ * (cpu -> package) through the index vs. a scan of flat_threads, and
+ * a consistency check of the domains of every level.
+ * Usage: bench_procmap [iterations (default 50)]
+ */
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "processor_map.h"
+#include "tsc_x86_64.h"
+
+static int open_fds(void)
+{
+    DIR *d = opendir("/proc/self/fd");
+    int n = 0;
+
+    if ( !d )
+        return -1;
+    while ( readdir(d) )
+        n++;
+    closedir(d);
+    return n;
+}
+
+static const char *level_names[PROCMAP_NUM_LEVELS] = {
+    "thread", "core", "L1", "L2", "L3", "node", "package", "system"
+};
+
+//! How a caller finds the package of a cpu without the index
+static int package_of_scan(procmap_t *pi, int cpu)
+{
+    int i;
+
+    for ( i = 0; i < pi->num_cpus; i++ )
+        if ( pi->flat_threads[i].cpu_id == cpu )
+            return pi->flat_threads[i].pack_id;
+    return -1;
+}
+
+/**
+ * Checks that each cpu is in its own domain at every level, and that
+ * the levels that partition the cpus do
+ * @return number of errors
+ */
+static int check_domains(procmap_t *pi)
+{
+    int lvl, i, k, n, bad = 0;
+    const int *cpus;
+
+    for ( lvl = 0; lvl < PROCMAP_NUM_LEVELS; lvl++ ) {
+        int total = 0, d = pi->domain[lvl].num;
+
+        for ( k = 0; k < d; k++ )
+            total += procmap_domain_cpus(pi, (procmap_level_t)lvl, k, &cpus);
+
+        for ( i = 0; i < pi->num_cpus; i++ ) {
+            int cpu = pi->flat_threads[i].cpu_id, found = 0;
+
+            n = procmap_siblings(pi, cpu, (procmap_level_t)lvl, &cpus);
+            for ( k = 0; k < n; k++ )
+                found += cpus[k] == cpu;
+            if ( d > 0 && procmap_domain_of(pi, cpu, (procmap_level_t)lvl) >= 0 &&
+                 found != 1 )
+                bad++;
+        }
+
+        printf("%-8s %5d domains, %5d cpus\n", level_names[lvl], d, total);
+        if ( lvl != PROCMAP_LEVEL_NODE && d > 0 && total != pi->num_cpus )
+            bad++;
+    }
+
+    for ( i = 0; i < pi->num_cpus; i++ ) {
+        threadinfo_t *t = &pi->flat_threads[i];
+        if ( procmap_thread(pi, t->cpu_id) != t ||
+             procmap_package_of(pi, t->cpu_id) != t->pack_id )
+            bad++;
+    }
+
+    return bad;
+}
+
+int main(int argc, char **argv)
+{
+    int iters = argc > 1 ? atoi(argv[1]) : 50;
+    double hz = timer_calibrate_hz(20000);
+    uint64_t best = UINT64_MAX, total = 0;
+    int i, fds0, fds1, bad, sum;
+    unsigned long q, nq = 10000000UL;
+    procmap_t *pi;
+    tsctimer_t tim;
+
+    fds0 = open_fds();
+    for ( i = 0; i < iters; i++ ) {
+        timer_clear(&tim);
+        timer_start(&tim);
+        pi = procmap_init();
+        procmap_destroy(pi);
+        timer_stop(&tim);
+
+        total += tim.total;
+        if ( tim.total < best )
+            best = tim.total;
+    }
+    fds1 = open_fds();
+
+    printf("procmap_init + procmap_destroy, %d iterations\n", iters);
+    printf("best %10.3f ms\n", best / hz * 1e3);
+    printf("mean %10.3f ms\n", total / hz * 1e3 / iters);
+    printf("file descriptors leaked: %d\n", fds1 - fds0);
+
+    pi = procmap_init();
+    printf("\n");
+    bad = check_domains(pi);
+
+    sum = 0;
+    timer_clear(&tim);
+    timer_start(&tim);
+    for ( q = 0; q < nq; q++ )
+        sum += procmap_package_of(pi, pi->flat_threads[q % pi->num_cpus].cpu_id);
+    timer_stop(&tim);
+    printf("\ncpu -> package, index %10.2f ns\n", tim.total / hz * 1e9 / nq);
+
+    timer_clear(&tim);
+    timer_start(&tim);
+    for ( q = 0; q < nq; q++ )
+        sum -= package_of_scan(pi, pi->flat_threads[q % pi->num_cpus].cpu_id);
+    timer_stop(&tim);
+    printf("cpu -> package, scan  %10.2f ns\n", tim.total / hz * 1e9 / nq);
+
+    printf("domain checks: %s\n", bad || sum ? "FAILED" : "passed");
+    procmap_destroy(pi);
+
+    return fds1 != fds0 || bad || sum;
+}
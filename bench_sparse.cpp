@@ -0,0 +1,210 @@
+/**
+ * @file
+ * Checks CSR/CSC construction and kernels against dense results, then
+ * reports GFLOPS and effective bandwidth of parallel SpMV/SpMM on a
+ * random matrix with skewed row lengths.
+ * Usage: bench_sparse [rows (default 1M)] [SpMM columns (default 16)]
+ *
+ * Effective bandwidth counts the minimum traffic: values, indices and
+ * row offsets of A once, x once and y once (SpMV).
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "matrix2d.h"
+#include "matrix2d_sparse.h"
+#include "processor_map.h"
+#include "tsc_x86_64.h"
+
+template <typename F>
+static uint64_t time_best(F f, int reps)
+{
+    uint64_t best = UINT64_MAX;
+    tsctimer_t tim;
+
+    for ( int r = 0; r < reps; r++ ) {
+        timer_clear(&tim);
+        timer_start(&tim);
+        f();
+        timer_stop(&tim);
+        if ( tim.total < best )
+            best = tim.total;
+    }
+    return best;
+}
+
+static uint64_t xorshift(uint64_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+static double max_diff(const double *a, const double *b, size_t n)
+{
+    double d = 0.0;
+    for ( size_t i = 0; i < n; i++ )
+        d = std::fmax(d, std::fabs(a[i] - b[i]));
+    return d;
+}
+
+static void check(void)
+{
+    const size_t nr = 200, nc = 300;
+    double **m = matrix2d_alloc<double>(nr, nc);
+    size_t *ri = new size_t [nr * nc], *ci = new size_t [nr * nc];
+    double *v = new double [nr * nc], *x = new double [nc],
+           *y = new double [nr], *yd = new double [nr], err = 0.0;
+    size_t nnz = 0;
+    uint64_t s = 88172645463325252ULL;
+
+    matrix2d_init(m, nr, nc, 0.0);
+    for ( size_t i = 0; i < nr; i++ )
+        for ( size_t j = 0; j < nc; j++ )
+            if ( xorshift(&s) % 20 == 0 )
+                m[i][j] = (double)(xorshift(&s) % 1000) / 100.0 + 0.5;
+    for ( size_t j = 0; j < nc; j++ )
+        x[j] = (double)(j % 7) - 3.0;
+    for ( size_t i = 0; i < nr; i++ ) {
+        yd[i] = 0.0;
+        for ( size_t j = 0; j < nc; j++ )
+            yd[i] += m[i][j] * x[j];
+    }
+
+    // Triples in reverse order, every nonzero split into two halves
+    for ( size_t i = nr; i-- > 0; )
+        for ( size_t j = nc; j-- > 0; )
+            if ( m[i][j] != 0.0 ) {
+                ri[nnz] = i; ci[nnz] = j; v[nnz++] = m[i][j] / 2;
+                ri[nnz] = i; ci[nnz] = j; v[nnz++] = m[i][j] / 2;
+            }
+
+    matrix2d_csr_t<double> a = matrix2d_csr_from_dense(m, nr, nc),
+                           b = matrix2d_csr_from_coo(nr, nc, nnz, ri, ci, v);
+    matrix2d_csc_t<double> c = matrix2d_csc_from_dense(m, nr, nc),
+                           d = matrix2d_csc_from_coo(nr, nc, nnz, ri, ci, v),
+                           e = matrix2d_csr_to_csc(a);
+
+    matrix2d_csr_spmv(a, x, y);
+    err = std::fmax(err, max_diff(y, yd, nr));
+    matrix2d_csr_spmv(b, x, y);
+    err = std::fmax(err, max_diff(y, yd, nr));
+    matrix2d_csc_spmv(c, x, y);
+    err = std::fmax(err, max_diff(y, yd, nr));
+    matrix2d_csc_spmv(d, x, y);
+    err = std::fmax(err, max_diff(y, yd, nr));
+    matrix2d_csc_spmv(e, x, y);
+    err = std::fmax(err, max_diff(y, yd, nr));
+
+    printf("check: %zux%zu, nnz %zu (coo %zu after merging duplicates), "
+           "max error %.2e%s\n", nr, nc, a.nnz, b.nnz, err,
+           err > 1e-9 || a.nnz != b.nnz ? "  WRONG RESULT" : "");
+
+    matrix2d_sparse_destroy(a);
+    matrix2d_sparse_destroy(b);
+    matrix2d_sparse_destroy(c);
+    matrix2d_sparse_destroy(d);
+    matrix2d_sparse_destroy(e);
+    matrix2d_destroy(m, nr);
+    delete [] ri;
+    delete [] ci;
+    delete [] v;
+    delete [] x;
+    delete [] y;
+    delete [] yd;
+}
+
+/**
+ * @return max/avg nonzeros per thread for the given row boundaries
+ */
+static double imbalance(const matrix2d_csr_t<double>& a, const size_t *b,
+                        int nthreads)
+{
+    size_t max = 0;
+    for ( int t = 0; t < nthreads; t++ ) {
+        size_t n = a.ptr[b[t + 1]] - a.ptr[b[t]];
+        if ( n > max )
+            max = n;
+    }
+    return (double)max * nthreads / a.nnz;
+}
+
+int main(int argc, char **argv)
+{
+    size_t n = argc > 1 ? atol(argv[1]) : (1 << 20);
+    size_t k = argc > 2 ? atol(argv[2]) : 16;
+    procmap_t *pi = procmap_init();
+    double hz = timer_calibrate_hz(20000);
+    uint64_t s = 88172645463325252ULL;
+    size_t cap = n * 20, nnz = 0;
+    size_t *ri = new size_t [cap], *ci = new size_t [cap];
+    double *v = new double [cap];
+
+    check();
+
+    // 1 row in 64 is 32x longer; the first 1/8th of rows are denser still
+    for ( size_t i = 0; i < n; i++ ) {
+        size_t len = xorshift(&s) % 64 == 0 ? 256 : 8;
+        if ( i < n / 8 )
+            len *= 2;
+        for ( size_t e = 0; e < len && nnz < cap; e++ ) {
+            ri[nnz] = i;
+            ci[nnz] = xorshift(&s) % n;
+            v[nnz++] = 1.0 / (1 + e);
+        }
+    }
+    matrix2d_csr_t<double> a = matrix2d_csr_from_coo(n, n, nnz, ri, ci, v);
+    delete [] ri;
+    delete [] ci;
+    delete [] v;
+
+    double *x = new double [n], *y = new double [n];
+    double **B = matrix2d_alloc<double>(n, k), **C = matrix2d_alloc<double>(n, k);
+    for ( size_t i = 0; i < n; i++ )
+        x[i] = 1.0;
+    matrix2d_init(B, n, k, 1.0);
+    matrix2d_init(C, n, k, 0.0);
+
+    printf("A: %zux%zu, nnz %zu (%.4f%% dense)\n", n, n, a.nnz,
+           100.0 * a.nnz / ((double)n * n));
+
+    {
+        const int p = 16;
+        size_t eq[p + 1], bal[p + 1];
+        for ( int t = 0; t < p; t++ )
+            matrix2d_par_range(n, t, p, &eq[t], &eq[t + 1]);
+        matrix2d_csr_partition(a, p, bal);
+        printf("nnz imbalance (max/avg) over %d threads: equal rows %.2f, "
+               "balanced %.2f\n", p, imbalance(a, eq, p), imbalance(a, bal, p));
+    }
+
+    printf("%8s %12s %12s %14s\n", "threads", "SpMV GF/s", "SpMV GB/s",
+           "SpMM GF/s");
+    for ( int p = 1; ; p = p * 2 < pi->num_cpus ? p * 2 : pi->num_cpus ) {
+        double bytes = a.nnz * (sizeof(double) + sizeof(size_t)) +
+                       (n + 1) * sizeof(size_t) + 2 * n * sizeof(double);
+        uint64_t t1 = time_best([&]() {
+            matrix2d_csr_spmv_par(a, x, y, pi, p);
+        }, 5);
+        uint64_t t2 = time_best([&]() {
+            matrix2d_csr_spmm_par(a, B, C, k, pi, p);
+        }, 3);
+
+        printf("%8d %12.2f %12.2f %14.2f\n", p,
+               2.0 * a.nnz / (t1 / hz) / 1e9, bytes / (t1 / hz) / 1e9,
+               2.0 * a.nnz * k / (t2 / hz) / 1e9);
+        if ( p == pi->num_cpus )
+            break;
+    }
+
+    matrix2d_sparse_destroy(a);
+    matrix2d_destroy(B, n);
+    matrix2d_destroy(C, n);
+    delete [] x;
+    delete [] y;
+    procmap_destroy(pi);
+    return 0;
+}
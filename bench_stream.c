@@ -0,0 +1,138 @@
+/**
+ * @file
+ * Bandwidth of regular vs. streaming stores for fill and copy, and
+ * how much of a warm working set survives each of them.
+ * Usage: bench_stream [max MB (default 1024)]
+ *
+ * "warm set" is the time to re-read a 1MB buffer, read just before
+ * the fill: cheap if the fill left it in cache.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <emmintrin.h>
+
+#include "processor_map.h"
+#include "stream.h"
+#include "tsc_x86_64.h"
+#include "util.h"
+
+#define WARM_BYTES (1 << 20)
+
+static void fill_regular(void *dst, const void *pattern, size_t bytes)
+{
+    __m128i v = _mm_loadu_si128((const __m128i*)pattern);
+    char *d = (char*)dst;
+    size_t i;
+
+    for ( i = 0; i + 16 <= bytes; i += 16 )
+        _mm_store_si128((__m128i*)(d + i), v);
+}
+
+static void copy_regular(void *dst, const void *src, size_t bytes)
+{
+    char *d = (char*)dst;
+    const char *s = (const char*)src;
+    size_t i;
+
+    for ( i = 0; i + 16 <= bytes; i += 16 )
+        _mm_store_si128((__m128i*)(d + i),
+                        _mm_load_si128((const __m128i*)(s + i)));
+}
+
+static void fill_memset(void *dst, const void *pattern, size_t bytes)
+{
+    memset(dst, *(const char*)pattern, bytes);
+}
+
+static void copy_memcpy(void *dst, const void *src, size_t bytes)
+{
+    memcpy(dst, src, bytes);
+}
+
+static void fill_nt(void *dst, const void *pattern, size_t bytes)
+{
+    stream_fill_nt(dst, pattern, bytes);
+    stream_fence();
+}
+
+static void copy_nt(void *dst, const void *src, size_t bytes)
+{
+    stream_copy_nt(dst, src, bytes);
+    stream_fence();
+}
+
+static uint64_t read_warm(const volatile char *w)
+{
+    uint64_t t = timer_read();
+    size_t i;
+    char sum = 0;
+
+    for ( i = 0; i < WARM_BYTES; i += 64 )
+        sum += w[i];
+    (void)sum;
+    return timer_read() - t;
+}
+
+int main(int argc, char **argv)
+{
+    size_t max = (argc > 1 ? atol(argv[1]) : 1024) << 20, bytes;
+    procmap_t *pi = procmap_init();
+    double hz = timer_calibrate_hz(20000);
+    char *a = malloc_aligned(max, 64), *b = malloc_aligned(max, 64);
+    char *warm = malloc_aligned(WARM_BYTES, 64);
+    char pat[16] = { 0 };
+
+    stream_init(pi);
+    printf("streaming threshold: %zu KB\n", stream_threshold() >> 10);
+    memset(a, 1, max);
+    memset(b, 2, max);
+    memset(warm, 3, WARM_BYTES);
+
+    printf("%10s | %9s %9s %9s | %9s %9s %9s | %12s %12s\n", "size KB",
+           "fill", "memset", "fill nt", "copy", "memcpy", "copy nt",
+           "warm/regular", "warm/nt");
+
+    for ( bytes = 256 << 10; bytes <= max; bytes *= 4 ) {
+        void (*fills[3])(void*, const void*, size_t) =
+            { fill_regular, fill_memset, fill_nt };
+        void (*copies[3])(void*, const void*, size_t) =
+            { copy_regular, copy_memcpy, copy_nt };
+        double gbs[6];
+        uint64_t warm_t[3] = { 0 };
+        int k, r;
+
+        for ( k = 0; k < 3; k++ ) {
+            uint64_t best = UINT64_MAX, t;
+            for ( r = 0; r < 3; r++ ) {
+                read_warm(warm);
+                t = timer_read();
+                fills[k](a, pat, bytes);
+                t = timer_read() - t;
+                if ( t < best )
+                    best = t;
+                warm_t[k] = read_warm(warm);
+            }
+            gbs[k] = bytes / (best / hz) / 1e9;
+
+            best = UINT64_MAX;
+            for ( r = 0; r < 3; r++ ) {
+                t = timer_read();
+                copies[k](b, a, bytes);
+                t = timer_read() - t;
+                if ( t < best )
+                    best = t;
+            }
+            gbs[3 + k] = 2.0 * bytes / (best / hz) / 1e9;
+        }
+
+        printf("%10zu | %9.2f %9.2f %9.2f | %9.2f %9.2f %9.2f | %9.1f us %9.1f us\n",
+               bytes >> 10, gbs[0], gbs[1], gbs[2], gbs[3], gbs[4], gbs[5],
+               warm_t[0] / hz * 1e6, warm_t[2] / hz * 1e6);
+    }
+
+    procmap_destroy(pi);
+    return 0;
+}
@@ -0,0 +1,99 @@
+/**
+ * @file
+ * Bandwidth of transpose variants vs. the naive double loop.
+ * Usage: bench_transpose [max n (default 8192)]
+ * Bandwidth counts one read and one write of every element.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "matrix2d.h"
+#include "matrix2d_transpose.h"
+#include "tsc_x86_64.h"
+
+template <typename F>
+static uint64_t time_best(F f, int reps)
+{
+    uint64_t best = UINT64_MAX;
+    tsctimer_t tim;
+
+    for ( int r = 0; r < reps; r++ ) {
+        timer_clear(&tim);
+        timer_start(&tim);
+        f();
+        timer_stop(&tim);
+        if ( tim.total < best )
+            best = tim.total;
+    }
+    return best;
+}
+
+static bool check(double **s, double **t, size_t n)
+{
+    for ( size_t i = 0; i < n; i++ )
+        for ( size_t j = 0; j < n; j++ )
+            if ( t[j][i] != s[i][j] )
+                return false;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    size_t max = argc > 1 ? atol(argv[1]) : 8192;
+    double hz = timer_calibrate_hz(20000);
+
+    printf("Kernel: %s, tile %d\n", matrix2d_transpose_kernel_name(),
+           MATRIX2D_TRANSPOSE_TILE);
+    printf("%6s %10s | %8s %8s %8s %8s | %8s %8s %8s %8s  (GB/s)\n",
+           "n", "MB", "naive", "rec", "tiled", "simd",
+           "ip-naive", "ip-rec", "ip-tiled", "ip-simd");
+
+    for ( size_t n = 1000; n <= max; n = n < 1024 ? 1024 : n * 2 ) {
+        matrix2d_t<double> S = matrix2d_alloc_contig<double>(n, n),
+                           T = matrix2d_alloc_contig<double>(n, n);
+        double bytes = 2.0 * n * n * sizeof(double);
+        int reps = n <= 2048 ? 5 : 2;
+        bool ok = true;
+        uint64_t t[8];
+
+        matrix2d_init_random_double(S.rows, n, n);
+        matrix2d_init(T.rows, n, n, 0.0);
+
+        t[0] = time_best([&]() {
+            matrix2d_transpose_naive(S.rows, T.rows, n, n); }, reps);
+        ok &= check(S.rows, T.rows, n);
+        t[1] = time_best([&]() {
+            matrix2d_transpose_rec(S.rows, T.rows, n, n); }, reps);
+        ok &= check(S.rows, T.rows, n);
+        t[2] = time_best([&]() {
+            matrix2d_transpose_tiled(S.rows, T.rows, n, n); }, reps);
+        ok &= check(S.rows, T.rows, n);
+        t[3] = time_best([&]() {
+            matrix2d_transpose_simd(S.rows, T.rows, n, n); }, reps);
+        ok &= check(S.rows, T.rows, n);
+
+        // Each in-place run is repeated an even number of times, so T
+        // ends up as it started
+        matrix2d_copy(S.rows, T.rows, n, n);
+        t[4] = time_best([&]() {
+            matrix2d_transpose_inplace_naive(T.rows, n); }, 2 * reps);
+        t[5] = time_best([&]() {
+            matrix2d_transpose_inplace_rec(T.rows, n); }, 2 * reps);
+        t[6] = time_best([&]() {
+            matrix2d_transpose_inplace_tiled(T.rows, n); }, 2 * reps);
+        t[7] = time_best([&]() {
+            matrix2d_transpose_inplace_simd(T.rows, n); }, 2 * reps - 1);
+        ok &= check(S.rows, T.rows, n);
+
+        printf("%6zu %10.1f |", n, bytes / 2 / (1 << 20));
+        for ( int v = 0; v < 8; v++ )
+            printf(" %8.2f%s", bytes / (t[v] / hz) / 1e9, v == 3 ? " |" : "");
+        printf("%s\n", ok ? "" : "  WRONG RESULT");
+
+        matrix2d_destroy_contig(S);
+        matrix2d_destroy_contig(T);
+    }
+
+    return 0;
+}
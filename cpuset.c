@@ -0,0 +1,429 @@
+/**
+ * @file
+ * Dynamically sized cpu sets
+ */
+
+#include "cpuset.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define W CPUSET_WORD_BITS
+
+static int _nwords(int ncpus)
+{
+    return ncpus > 0 ? (ncpus + W - 1) / W : 1;
+}
+
+/**
+ * Makes room for at least nwords words (new words are zero)
+ */
+static void _grow(cpuset_t *s, int nwords)
+{
+    if ( nwords <= s->nwords )
+        return;
+
+    s->bits = (unsigned long*)realloc(s->bits, nwords * sizeof(unsigned long));
+    if ( !s->bits ) {
+        fprintf(stderr, "%s: Allocation error\n", __FUNCTION__);
+        exit(EXIT_FAILURE);
+    }
+    memset(s->bits + s->nwords, 0,
+           (nwords - s->nwords) * sizeof(unsigned long));
+    s->nwords = nwords;
+}
+
+/**
+ * Sets cpus [first, last] one word at a time
+ */
+static void _set_range(cpuset_t *s, int first, int last)
+{
+    int w0 = first / W, w1 = last / W, w;
+    unsigned long m0 = ~0UL << (first % W),
+                  m1 = ~0UL >> (W - 1 - last % W);
+
+    _grow(s, w1 + 1);
+    if ( w0 == w1 ) {
+        s->bits[w0] |= m0 & m1;
+        return;
+    }
+    s->bits[w0] |= m0;
+    for ( w = w0 + 1; w < w1; w++ )
+        s->bits[w] = ~0UL;
+    s->bits[w1] |= m1;
+}
+
+static unsigned long _word(const cpuset_t *s, int w)
+{
+    return w < s->nwords ? s->bits[w] : 0UL;
+}
+
+static int _max(int a, int b)
+{
+    return a > b ? a : b;
+}
+
+/**
+ * Allocates an empty set
+ * @param ncpus initial capacity in cpus (the set grows as needed)
+ * @return the set
+ */
+cpuset_t* cpuset_alloc(int ncpus)
+{
+    cpuset_t *s = (cpuset_t*)malloc(sizeof(cpuset_t));
+
+    if ( s )
+        s->bits = (unsigned long*)calloc(_nwords(ncpus),
+                                         sizeof(unsigned long));
+    if ( !s || !s->bits ) {
+        fprintf(stderr, "%s: Allocation error\n", __FUNCTION__);
+        exit(EXIT_FAILURE);
+    }
+    s->nwords = _nwords(ncpus);
+
+    return s;
+}
+
+/**
+ * @return a copy of s
+ */
+cpuset_t* cpuset_dup(const cpuset_t *s)
+{
+    cpuset_t *d = cpuset_alloc(s->nwords * W);
+
+    memcpy(d->bits, s->bits, s->nwords * sizeof(unsigned long));
+    return d;
+}
+
+void cpuset_free(cpuset_t *s)
+{
+    if ( !s )
+        return;
+    free(s->bits);
+    free(s);
+}
+
+/**
+ * Parses a hex mask as found in sysfs (e.g. "00000000,000000ff"):
+ * the rightmost digit holds cpus 0-3. Commas and whitespace are
+ * ignored, so any grouping and width is accepted.
+ * @param str mask
+ * @return new set, NULL if str contains anything else
+ */
+cpuset_t* cpuset_parse_mask(const char *str)
+{
+    size_t len = strlen(str);
+    cpuset_t *s = cpuset_alloc(4 * len);
+    const char *p;
+    int bit = 0;
+
+    for ( p = str + len; p-- > str; ) {
+        unsigned long v;
+
+        if ( *p == ',' || isspace((unsigned char)*p) )
+            continue;
+
+        if ( *p >= '0' && *p <= '9' )
+            v = *p - '0';
+        else if ( *p >= 'a' && *p <= 'f' )
+            v = *p - 'a' + 10;
+        else if ( *p >= 'A' && *p <= 'F' )
+            v = *p - 'A' + 10;
+        else {
+            cpuset_free(s);
+            return NULL;
+        }
+
+        // W is a multiple of 4, so a digit never straddles two words
+        s->bits[bit / W] |= v << (bit % W);
+        bit += 4;
+    }
+
+    return s;
+}
+
+/**
+ * Parses a cpu list as found in sysfs *_list files and cpulist
+ * (e.g. "0-3,8,10-11"); an empty list is an empty set.
+ * @param str list
+ * @return new set, NULL if str is malformed or has a cpu id of
+ *         CPUSET_MAX_CPUS or more
+ */
+cpuset_t* cpuset_parse_list(const char *str)
+{
+    cpuset_t *s = cpuset_alloc(0);
+    const char *p = str;
+
+    while ( isspace((unsigned char)*p) )
+        p++;
+
+    while ( *p ) {
+        long first, last;
+        char *end;
+
+        if ( !isdigit((unsigned char)*p) )
+            goto bad;
+        first = last = strtol(p, &end, 10);
+        p = end;
+
+        if ( *p == '-' ) {
+            if ( !isdigit((unsigned char)p[1]) )
+                goto bad;
+            last = strtol(p + 1, &end, 10);
+            p = end;
+        }
+        // bounds checked as long, before they are narrowed to int
+        if ( first < 0 || last < first || last >= CPUSET_MAX_CPUS )
+            goto bad;
+        _set_range(s, (int)first, (int)last);
+
+        while ( isspace((unsigned char)*p) )
+            p++;
+        if ( *p == ',' ) {
+            p++;
+            while ( isspace((unsigned char)*p) )
+                p++;
+        } else if ( *p ) {
+            goto bad;
+        }
+    }
+    return s;
+
+bad:
+    cpuset_free(s);
+    return NULL;
+}
+
+/**
+ * Formats a set as a cpu list, e.g. "0-3,8" (like snprintf, the
+ * output is truncated to len - 1 chars)
+ * @param s set
+ * @param buf output buffer
+ * @param len size of buf
+ * @return length of the full list
+ */
+int cpuset_format_list(const cpuset_t *s, char *buf, size_t len)
+{
+    int first, last, n = 0;
+
+    if ( len > 0 )
+        buf[0] = '\0';
+
+    for ( first = cpuset_first(s); first >= 0;
+          first = cpuset_next(s, last) ) {
+        last = first;
+        while ( cpuset_isset(s, last + 1) )
+            last++;
+
+        n += snprintf(buf + (n < (int)len ? n : 0),
+                      n < (int)len ? len - n : 0,
+                      last > first ? "%s%d-%d" : "%s%d",
+                      n ? "," : "", first, last);
+    }
+
+    return n;
+}
+
+/**
+ * Builds a set from a cpu_set_t
+ * @param set cpu_set_t, or a set from CPU_ALLOC
+ * @param setsize size of set in bytes
+ * @return new set
+ */
+cpuset_t* cpuset_from_cpu_set(const void *set, size_t setsize)
+{
+    cpuset_t *s = cpuset_alloc(8 * setsize);
+
+    memcpy(s->bits, set, setsize);
+    return s;
+}
+
+/**
+ * Stores a set into a cpu_set_t (cpus that do not fit are dropped)
+ * @param s set
+ * @param set cpu_set_t, or a set from CPU_ALLOC
+ * @param setsize size of set in bytes
+ */
+void cpuset_to_cpu_set(const cpuset_t *s, void *set, size_t setsize)
+{
+    size_t bytes = s->nwords * sizeof(unsigned long);
+
+    memset(set, 0, setsize);
+    memcpy(set, s->bits, bytes < setsize ? bytes : setsize);
+}
+
+void cpuset_zero(cpuset_t *s)
+{
+    memset(s->bits, 0, s->nwords * sizeof(unsigned long));
+}
+
+void cpuset_set(cpuset_t *s, int cpu)
+{
+    _grow(s, cpu / W + 1);
+    s->bits[cpu / W] |= 1UL << (cpu % W);
+}
+
+void cpuset_clear(cpuset_t *s, int cpu)
+{
+    if ( cpu / W < s->nwords )
+        s->bits[cpu / W] &= ~(1UL << (cpu % W));
+}
+
+int cpuset_isset(const cpuset_t *s, int cpu)
+{
+    return cpu >= 0 && (_word(s, cpu / W) >> (cpu % W)) & 1;
+}
+
+/**
+ * @return number of cpus in s
+ */
+int cpuset_count(const cpuset_t *s)
+{
+    int w, n = 0;
+
+    for ( w = 0; w < s->nwords; w++ )
+        n += __builtin_popcountl(s->bits[w]);
+    return n;
+}
+
+/**
+ * @return number of cpus of s lower than cpu (the position of cpu
+ *         within s, if it is a member)
+ */
+int cpuset_rank(const cpuset_t *s, int cpu)
+{
+    int w, n = 0, wc = cpu / W;
+
+    for ( w = 0; w < wc && w < s->nwords; w++ )
+        n += __builtin_popcountl(s->bits[w]);
+    if ( cpu % W )
+        n += __builtin_popcountl(_word(s, wc) & (~0UL >> (W - cpu % W)));
+    return n;
+}
+
+/**
+ * @return lowest cpu of s, -1 if s is empty
+ */
+int cpuset_first(const cpuset_t *s)
+{
+    return cpuset_next(s, -1);
+}
+
+/**
+ * @return lowest cpu of s greater than cpu, -1 if there is none
+ */
+int cpuset_next(const cpuset_t *s, int cpu)
+{
+    int w = (cpu + 1) / W;
+    unsigned long word;
+
+    if ( w >= s->nwords )
+        return -1;
+
+    word = s->bits[w] & (~0UL << ((cpu + 1) % W));
+    while ( !word ) {
+        if ( ++w >= s->nwords )
+            return -1;
+        word = s->bits[w];
+    }
+    return w * W + __builtin_ctzl(word);
+}
+
+/**
+ * @return highest cpu of s, -1 if s is empty
+ */
+int cpuset_last(const cpuset_t *s)
+{
+    int w;
+
+    for ( w = s->nwords - 1; w >= 0; w-- )
+        if ( s->bits[w] )
+            return w * W + W - 1 - __builtin_clzl(s->bits[w]);
+    return -1;
+}
+
+//! dst = src
+void cpuset_copy(cpuset_t *dst, const cpuset_t *src)
+{
+    _grow(dst, src->nwords);
+    cpuset_zero(dst);
+    memcpy(dst->bits, src->bits, src->nwords * sizeof(unsigned long));
+}
+
+//! dst &= src
+void cpuset_and(cpuset_t *dst, const cpuset_t *src)
+{
+    int w;
+
+    for ( w = 0; w < dst->nwords; w++ )
+        dst->bits[w] &= _word(src, w);
+}
+
+//! dst |= src
+void cpuset_or(cpuset_t *dst, const cpuset_t *src)
+{
+    int w;
+
+    _grow(dst, src->nwords);
+    for ( w = 0; w < src->nwords; w++ )
+        dst->bits[w] |= src->bits[w];
+}
+
+//! dst ^= src
+void cpuset_xor(cpuset_t *dst, const cpuset_t *src)
+{
+    int w;
+
+    _grow(dst, src->nwords);
+    for ( w = 0; w < src->nwords; w++ )
+        dst->bits[w] ^= src->bits[w];
+}
+
+//! dst &= ~src
+void cpuset_andnot(cpuset_t *dst, const cpuset_t *src)
+{
+    int w;
+
+    for ( w = 0; w < dst->nwords && w < src->nwords; w++ )
+        dst->bits[w] &= ~src->bits[w];
+}
+
+int cpuset_empty(const cpuset_t *s)
+{
+    return cpuset_last(s) < 0;
+}
+
+int cpuset_equal(const cpuset_t *a, const cpuset_t *b)
+{
+    int w, n = _max(a->nwords, b->nwords);
+
+    for ( w = 0; w < n; w++ )
+        if ( _word(a, w) != _word(b, w) )
+            return 0;
+    return 1;
+}
+
+/**
+ * @return 1 if every cpu of a is in b
+ */
+int cpuset_subset(const cpuset_t *a, const cpuset_t *b)
+{
+    int w;
+
+    for ( w = 0; w < a->nwords; w++ )
+        if ( a->bits[w] & ~_word(b, w) )
+            return 0;
+    return 1;
+}
+
+int cpuset_intersects(const cpuset_t *a, const cpuset_t *b)
+{
+    int w, n = a->nwords < b->nwords ? a->nwords : b->nwords;
+
+    for ( w = 0; w < n; w++ )
+        if ( a->bits[w] & b->bits[w] )
+            return 1;
+    return 0;
+}
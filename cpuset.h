@@ -0,0 +1,73 @@
+/**
+ * @file
+ * Dynamically sized cpu sets.
+ *
+ * A cpuset_t is a bitmap of cpu ids of any width, stored in unsigned
+ * longs (bit i of the set is bit i % CPUSET_WORD_BITS of word
+ * i / CPUSET_WORD_BITS, the layout of cpu_set_t). Sets grow as cpus
+ * are added; bits beyond the allocated words read as 0, so sets of
+ * different sizes can be combined.
+ *
+ * Iterate over the cpus of a set with
+ *     for ( cpu = cpuset_first(s); cpu >= 0; cpu = cpuset_next(s, cpu) )
+ * which skips empty words at once.
+ */
+
+#ifndef CPUSET_H_
+#define CPUSET_H_
+
+#include <stddef.h>
+
+//! Bits per word of a cpuset_t
+#define CPUSET_WORD_BITS ((int)(8 * sizeof(unsigned long)))
+
+//! Cpu ids accepted by cpuset_parse_list() are below this limit
+#define CPUSET_MAX_CPUS (1 << 16)
+
+typedef struct {
+    int nwords;           //!< number of allocated words
+    unsigned long *bits;  //!< nwords words, cpu i is bit i
+} cpuset_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+cpuset_t* cpuset_alloc(int ncpus);
+cpuset_t* cpuset_dup(const cpuset_t *s);
+void cpuset_free(cpuset_t *s);
+
+cpuset_t* cpuset_parse_mask(const char *str);
+cpuset_t* cpuset_parse_list(const char *str);
+int cpuset_format_list(const cpuset_t *s, char *buf, size_t len);
+
+cpuset_t* cpuset_from_cpu_set(const void *set, size_t setsize);
+void cpuset_to_cpu_set(const cpuset_t *s, void *set, size_t setsize);
+
+void cpuset_zero(cpuset_t *s);
+void cpuset_set(cpuset_t *s, int cpu);
+void cpuset_clear(cpuset_t *s, int cpu);
+int cpuset_isset(const cpuset_t *s, int cpu);
+
+int cpuset_count(const cpuset_t *s);
+int cpuset_rank(const cpuset_t *s, int cpu);
+int cpuset_first(const cpuset_t *s);
+int cpuset_next(const cpuset_t *s, int cpu);
+int cpuset_last(const cpuset_t *s);
+
+void cpuset_copy(cpuset_t *dst, const cpuset_t *src);
+void cpuset_and(cpuset_t *dst, const cpuset_t *src);
+void cpuset_or(cpuset_t *dst, const cpuset_t *src);
+void cpuset_xor(cpuset_t *dst, const cpuset_t *src);
+void cpuset_andnot(cpuset_t *dst, const cpuset_t *src);
+
+int cpuset_empty(const cpuset_t *s);
+int cpuset_equal(const cpuset_t *a, const cpuset_t *b);
+int cpuset_subset(const cpuset_t *a, const cpuset_t *b);
+int cpuset_intersects(const cpuset_t *a, const cpuset_t *b);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,48 @@
+/**
+ * @file
+ * Delay calibration and backoff policy setup
+ */
+
+#include "delay.h"
+
+double delay_cycles_per_ns = 0.0;
+
+/**
+ * Calibrates the TSC rate used to convert nanoseconds to cycles.
+ * Called implicitly on first use; call it explicitly at startup to
+ * keep the ~10ms calibration out of timed regions.
+ */
+void delay_init(void)
+{
+    delay_cycles_per_ns = timer_calibrate_hz(10000) / 1e9;
+}
+
+/**
+ * Initializes an exponential backoff policy
+ * @param b policy to initialize
+ * @param min_ns initial (and minimum) backoff window
+ * @param max_ns maximum backoff window
+ * @param randomized nonzero to randomize waits within the window,
+ *        which keeps contending threads from retrying in lockstep
+ * @param seed seed for the private generator (e.g. the thread index)
+ */
+void backoff_init(backoff_t *b, unsigned long min_ns, unsigned long max_ns,
+                  int randomized, unsigned int seed)
+{
+    b->min_cycles = delay_ns_to_cycles(min_ns);
+    b->max_cycles = delay_ns_to_cycles(max_ns);
+    if ( b->min_cycles == 0 )
+        b->min_cycles = 1;
+    if ( b->max_cycles < b->min_cycles )
+        b->max_cycles = b->min_cycles;
+    b->cur_cycles = b->min_cycles;
+    b->randomized = randomized;
+
+    // Same initial state as marsaglia_prng(), perturbed by the seed
+    b->x = 123456789 ^ (seed * 2654435761u);
+    b->y = 362436069;
+    b->z = 521288629;
+    b->w = 88675123 ^ seed;
+    if ( !(b->x | b->y | b->z | b->w) )
+        b->w = 1;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file
+ * Calibrated nanosecond delays and backoff policies for spin/CAS
+ * retry loops
+ */
+
+#ifndef DELAY_H_
+#define DELAY_H_
+
+#include <stdint.h>
+
+#include "atomic_x86_64.h"
+#include "tsc_x86_64.h"
+
+//! TSC ticks per nanosecond, set by delay_init()
+extern double delay_cycles_per_ns;
+
+void delay_init(void);
+
+/**
+ * Converts nanoseconds to TSC ticks
+ */
+static inline uint64_t delay_ns_to_cycles(unsigned long ns)
+{
+    if ( __builtin_expect(delay_cycles_per_ns == 0.0, 0) )
+        delay_init();
+    return (uint64_t)(ns * delay_cycles_per_ns);
+}
+
+/**
+ * Spins for (at least) a given time, issuing PAUSE between TSC polls
+ * @param ns delay in nanoseconds
+ */
+static inline void delay_ns(unsigned long ns)
+{
+    uint64_t end = timer_read() + delay_ns_to_cycles(ns);
+
+    while ( timer_read() < end )
+        cpu_relax();
+}
+
+/**
+ * Backoff policy state.
+ * Each retrying thread owns one; the random generator is a private
+ * Marsaglia xorshift, so randomized backoff needs no shared state.
+ */
+typedef struct {
+    uint64_t min_cycles;
+    uint64_t max_cycles;
+    uint64_t cur_cycles;  //!< current backoff window
+    int randomized;       //!< wait min + uniform[0, window] instead
+    unsigned int x, y, z, w;
+} backoff_t;
+
+void backoff_init(backoff_t *b, unsigned long min_ns, unsigned long max_ns,
+                  int randomized, unsigned int seed);
+
+/**
+ * Marsaglia xorshift step on the policy's private state
+ */
+static inline unsigned int backoff_rand(backoff_t *b)
+{
+    unsigned int t = b->x ^ (b->x << 11);
+    b->x = b->y;
+    b->y = b->z;
+    b->z = b->w;
+    return b->w = b->w ^ (b->w >> 19) ^ (t ^ (t >> 8));
+}
+
+/**
+ * Waits according to the policy and doubles the window (up to the
+ * maximum). Call after every failed attempt.
+ */
+static inline void backoff_pause(backoff_t *b)
+{
+    uint64_t wait = b->cur_cycles, end;
+
+    if ( b->randomized )
+        wait = b->min_cycles + backoff_rand(b) % (wait + 1);
+
+    end = timer_read() + wait;
+    while ( timer_read() < end )
+        cpu_relax();
+
+    if ( b->cur_cycles < b->max_cycles ) {
+        b->cur_cycles <<= 1;
+        if ( b->cur_cycles > b->max_cycles )
+            b->cur_cycles = b->max_cycles;
+    }
+}
+
+/**
+ * Shrinks the window back to the minimum. Call after a success.
+ */
+static inline void backoff_reset(backoff_t *b)
+{
+    b->cur_cycles = b->min_cycles;
+}
+
+#endif
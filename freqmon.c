@@ -0,0 +1,266 @@
+/**
+ * @file
+ * CPU frequency drift monitoring
+ */
+#define _GNU_SOURCE
+
+#include "freqmon.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "util.h"
+
+//! Dependent adds per iteration of the estimation chain
+#define FREQMON_CHAIN 8
+
+/**
+ * Runs n iterations of a chain of FREQMON_CHAIN dependent 1-cycle
+ * register-register adds (immediate adds may be folded by the renamer
+ * on recent cores); the loop counter is independent and overlaps
+ * with the chain
+ * @return TSC ticks taken
+ */
+static uint64_t _chain(unsigned long n)
+{
+    uint64_t x = 1, t0, t1;
+
+    t0 = timer_read();
+    __asm__ __volatile__ ( "1:\n\t"
+                           "add %0, %0\n\t"
+                           "add %0, %0\n\t"
+                           "add %0, %0\n\t"
+                           "add %0, %0\n\t"
+                           "add %0, %0\n\t"
+                           "add %0, %0\n\t"
+                           "add %0, %0\n\t"
+                           "add %0, %0\n\t"
+                           "dec %1\n\t"
+                           "jnz 1b\n\t"
+                           : "+r"(x), "+r"(n)
+                           :
+                           : "cc" );
+    t1 = timer_read();
+
+    return t1 - t0;
+}
+
+/**
+ * Estimates the current effective frequency of the calling cpu
+ * @param tsc_hz TSC rate, as returned by timer_calibrate_hz()
+ * @return core cycles per second
+ */
+double freqmon_estimate_hz(double tsc_hz)
+{
+    unsigned long n = 25000;
+    uint64_t t, best = UINT64_MAX;
+    int i;
+
+    // Interrupts can only lengthen a run: keep the fastest one
+    _chain(n);
+    for ( i = 0; i < 5; i++ )
+        if ( (t = _chain(n)) < best )
+            best = t;
+
+    return (double)n * FREQMON_CHAIN / best * tsc_hz;
+}
+
+static int _read_khz(int fd, double *khz)
+{
+    char buf[32];
+    ssize_t br;
+
+    if ( fd < 0 || (br = pread(fd, buf, sizeof(buf) - 1, 0)) <= 0 )
+        return -1;
+    buf[br] = '\0';
+    *khz = strtod(buf, NULL);
+    return 0;
+}
+
+static void* _sampler_fun(void *args)
+{
+    freqmon_t *fm = (freqmon_t*)args;
+    double khz;
+    int i;
+
+    while ( fm->running ) {
+        for ( i = 0; i < fm->num_cpus; i++ ) {
+            if ( _read_khz(fm->fd[i], &khz) < 0 )
+                continue;
+            if ( khz < fm->min_khz[i] )
+                fm->min_khz[i] = khz;
+            if ( khz > fm->max_khz[i] )
+                fm->max_khz[i] = khz;
+            fm->sum_khz[i] += khz;
+        }
+        fm->nsamples++;
+        usleep(fm->period_us);
+    }
+
+    return NULL;
+}
+
+/**
+ * Initializes a monitor for all cpus of the system
+ * @param fm monitor to initialize
+ * @param pi processor map
+ * @param period_us sysfs sampling period
+ */
+void freqmon_init(freqmon_t *fm, procmap_t *pi, unsigned long period_us)
+{
+    char path[128];
+    int i;
+
+    memset(fm, 0, sizeof(*fm));
+    fm->num_cpus = pi->num_cpus;
+    fm->period_us = period_us ? period_us : 10000;
+    fm->cpu = (int*)malloc_safe(fm->num_cpus * sizeof(int));
+    fm->fd = (int*)malloc_safe(fm->num_cpus * sizeof(int));
+    fm->min_khz = (double*)malloc_safe(fm->num_cpus * sizeof(double));
+    fm->max_khz = (double*)malloc_safe(fm->num_cpus * sizeof(double));
+    fm->sum_khz = (double*)malloc_safe(fm->num_cpus * sizeof(double));
+
+    for ( i = 0; i < fm->num_cpus; i++ ) {
+        fm->cpu[i] = pi->flat_threads[i].cpu_id;
+        sprintf(path, "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq",
+                fm->cpu[i]);
+        fm->fd[i] = open(path, O_RDONLY);
+        if ( fm->fd[i] >= 0 )
+            fm->sysfs_ok = 1;
+    }
+
+    fm->tsc_hz = timer_calibrate_hz(20000);
+}
+
+/**
+ * Marks the start of a monitored region
+ */
+void freqmon_start(freqmon_t *fm)
+{
+    int i;
+
+    for ( i = 0; i < fm->num_cpus; i++ ) {
+        fm->min_khz[i] = 1e12;
+        fm->max_khz[i] = 0.0;
+        fm->sum_khz[i] = 0.0;
+    }
+    fm->nsamples = 0;
+
+    fm->est_start_hz = freqmon_estimate_hz(fm->tsc_hz);
+
+    if ( fm->sysfs_ok ) {
+        fm->running = 1;
+        if ( pthread_create(&fm->sampler, NULL, _sampler_fun, fm) ) {
+            perror("pthread_create");
+            fm->running = 0;
+        }
+    }
+}
+
+/**
+ * Marks the end of a monitored region
+ */
+void freqmon_stop(freqmon_t *fm)
+{
+    fm->est_stop_hz = freqmon_estimate_hz(fm->tsc_hz);
+
+    if ( fm->running ) {
+        fm->running = 0;
+        pthread_join(fm->sampler, NULL);
+    }
+}
+
+/**
+ * Checks whether frequency moved during the region
+ * @param fm monitor, after freqmon_stop()
+ * @param rel_threshold tolerated relative change (e.g. 0.05)
+ * @return nonzero if any cpu's sampled frequency, or the in-process
+ *         estimate, varied by more than the threshold
+ */
+int freqmon_excursion(freqmon_t *fm, double rel_threshold)
+{
+    double lo, hi;
+    int i;
+
+    lo = fm->est_start_hz < fm->est_stop_hz ? fm->est_start_hz
+                                            : fm->est_stop_hz;
+    hi = fm->est_start_hz < fm->est_stop_hz ? fm->est_stop_hz
+                                            : fm->est_start_hz;
+    if ( lo > 0 && (hi - lo) / lo > rel_threshold )
+        return 1;
+
+    for ( i = 0; i < fm->num_cpus && fm->nsamples; i++ ) {
+        if ( fm->fd[i] < 0 || fm->max_khz[i] == 0.0 )
+            continue;
+        if ( (fm->max_khz[i] - fm->min_khz[i]) / fm->min_khz[i] >
+             rel_threshold )
+            return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Reports frequencies seen during the region, and the timer result
+ * converted to core cycles at the estimated effective frequency
+ * @param fp output stream
+ * @param fm monitor, after freqmon_stop()
+ * @param t timer measured over the same region (may be NULL)
+ */
+void freqmon_report(FILE *fp, freqmon_t *fm, tsctimer_t *t)
+{
+    double eff = (fm->est_start_hz + fm->est_stop_hz) / 2;
+    int i;
+
+    fprintf(fp, "TSC rate: %.1f MHz\n", fm->tsc_hz / 1e6);
+    fprintf(fp, "Effective frequency (in-process): %.1f MHz at start, "
+                "%.1f MHz at stop\n",
+                fm->est_start_hz / 1e6, fm->est_stop_hz / 1e6);
+
+    if ( fm->sysfs_ok && fm->nsamples ) {
+        fprintf(fp, "scaling_cur_freq over %lu samples (MHz):\n",
+                fm->nsamples);
+        fprintf(fp, "  %6s %10s %10s %10s\n", "cpu", "min", "avg", "max");
+        for ( i = 0; i < fm->num_cpus; i++ ) {
+            if ( fm->fd[i] < 0 )
+                continue;
+            fprintf(fp, "  %6d %10.1f %10.1f %10.1f\n", fm->cpu[i],
+                    fm->min_khz[i] / 1e3,
+                    fm->sum_khz[i] / fm->nsamples / 1e3,
+                    fm->max_khz[i] / 1e3);
+        }
+    } else {
+        fprintf(fp, "scaling_cur_freq not available\n");
+    }
+
+    if ( t && t->invocs ) {
+        fprintf(fp, "Timer: %.0f TSC cycles/invocation = %.0f ns = "
+                    "~%.0f core cycles at effective frequency\n",
+                    timer_average(t), timer_average(t) / fm->tsc_hz * 1e9,
+                    timer_average(t) * eff / fm->tsc_hz);
+    }
+
+    if ( freqmon_excursion(fm, 0.05) )
+        fprintf(fp, "WARNING: frequency varied by more than 5%% "
+                    "during the region\n");
+}
+
+/**
+ * Releases monitor resources
+ */
+void freqmon_destroy(freqmon_t *fm)
+{
+    int i;
+
+    for ( i = 0; i < fm->num_cpus; i++ )
+        if ( fm->fd[i] >= 0 )
+            close(fm->fd[i]);
+    free(fm->cpu);
+    free(fm->fd);
+    free(fm->min_khz);
+    free(fm->max_khz);
+    free(fm->sum_khz);
+}
@@ -0,0 +1,51 @@
+/**
+ * @file
+ * CPU frequency drift monitoring during timed regions
+ */
+
+#ifndef FREQMON_H_
+#define FREQMON_H_
+
+#include <pthread.h>
+#include <stdio.h>
+
+#include "processor_map.h"
+#include "tsc_x86_64.h"
+
+/**
+ * Frequency monitor.
+ * Between freqmon_start() and freqmon_stop(), a sampler thread reads
+ * scaling_cur_freq of every monitored cpu. In addition, the effective
+ * frequency of the calling cpu is estimated in-process at both ends
+ * of the region by timing a dependent instruction chain of known
+ * latency against the TSC.
+ */
+typedef struct {
+    int num_cpus;
+    int *cpu;               //!< monitored cpu ids
+    int *fd;                //!< open scaling_cur_freq files, -1 if absent
+    int sysfs_ok;           //!< nonzero if any cpu reports cpufreq
+    unsigned long period_us;
+
+    unsigned long nsamples;
+    double *min_khz;
+    double *max_khz;
+    double *sum_khz;
+
+    double tsc_hz;
+    double est_start_hz;    //!< in-process estimate at freqmon_start()
+    double est_stop_hz;     //!< in-process estimate at freqmon_stop()
+
+    pthread_t sampler;
+    volatile int running;
+} freqmon_t;
+
+void freqmon_init(freqmon_t *fm, procmap_t *pi, unsigned long period_us);
+void freqmon_start(freqmon_t *fm);
+void freqmon_stop(freqmon_t *fm);
+double freqmon_estimate_hz(double tsc_hz);
+int freqmon_excursion(freqmon_t *fm, double rel_threshold);
+void freqmon_report(FILE *fp, freqmon_t *fm, tsctimer_t *t);
+void freqmon_destroy(freqmon_t *fm);
+
+#endif
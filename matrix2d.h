@@ -7,6 +7,11 @@
 
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
+#include <stdlib.h>
+#include <type_traits>
+
+#include "stream_nt.h"
 
 /**
  * Allocate nrows x ncols matrix
@@ -36,28 +41,164 @@ T** matrix2d_alloc(size_t nrows, size_t ncols)
     return m; 
 }
 
+//! Alignment of every row of a contiguous matrix (a cache line)
+#define MATRIX2D_ALIGN 64
+
+//! Row strides that are multiples of this get padded, so that the
+//! elements of a column do not all map to the same cache set
+#define MATRIX2D_ALIAS_STRIDE 4096
+
+/**
+ * Contiguous 2D matrix.
+ * All rows live in a single aligned allocation, 'ld' elements apart.
+ * 'rows' is a row-pointer view into it, so the matrix can be passed 
+ * to every function that takes a T** (init, copy, print etc.).
+ */
+template <typename T>
+struct matrix2d_t {
+    T **rows;     //!< row pointers (rows[i] == data + i*ld)
+    T *data;      //!< start of the allocation
+    size_t nrows;
+    size_t ncols;
+    size_t ld;    //!< leading dimension, in elements (>= ncols)
+};
+
+/**
+ * Default leading dimension for a contiguous matrix: rows are 
+ * rounded up to whole cache lines, plus one extra line if the 
+ * resulting stride would alias in the cache
+ * @param ncols num of columns
+ * @return leading dimension in elements
+ */
+template <typename T>
+size_t matrix2d_default_ld(size_t ncols)
+{
+    size_t bytes = ncols * sizeof(T);
+
+    bytes = (bytes + MATRIX2D_ALIGN - 1) & ~(size_t)(MATRIX2D_ALIGN - 1);
+    if ( bytes % MATRIX2D_ALIAS_STRIDE == 0 )
+        bytes += MATRIX2D_ALIGN;
+
+    // Fall back to no padding for types that don't divide a line
+    if ( bytes % sizeof(T) )
+        return ncols;
+    return bytes / sizeof(T);
+}
+
+/**
+ * Allocate contiguous nrows x ncols matrix
+ * @param nrows num of rows
+ * @param ncols num of columns
+ * @param ld leading dimension in elements (>= ncols), 0 for 
+ *        matrix2d_default_ld(); rows are MATRIX2D_ALIGN-aligned only 
+ *        if ld*sizeof(T) is a multiple of it
+ * @return matrix (data and rows are NULL on allocation failure)
+ */
+template <typename T>
+matrix2d_t<T> matrix2d_alloc_contig(size_t nrows, size_t ncols, size_t ld = 0)
+{
+    matrix2d_t<T> m;
+    void *p = NULL;
+
+    m.nrows = nrows;
+    m.ncols = ncols;
+    m.ld = ld >= ncols ? ld : matrix2d_default_ld<T>(ncols);
+    m.data = NULL;
+    m.rows = NULL;
+
+    if ( posix_memalign(&p, MATRIX2D_ALIGN, 
+                        nrows * m.ld * sizeof(T)) ) {
+        std::cerr << "matrix2d_alloc_contig: allocation error" << std::endl;
+        return m;
+    }
+    m.data = static_cast<T*>(p);
+
+    try {
+        m.rows = new T* [nrows];
+    } catch (std::exception& e) {
+        std::cerr << "Standard exception: " << e.what() << std::endl;
+        free(m.data);
+        m.data = NULL;
+        return m;
+    }
+
+    for ( size_t i = 0; i < nrows; i++ )
+        m.rows[i] = m.data + i * m.ld;
+
+    return m;
+}
+
+/**
+ * Deallocate contiguous matrix
+ * @param m matrix as returned by matrix2d_alloc_contig()
+ */
+template <typename T>
+void matrix2d_destroy_contig(matrix2d_t<T>& m)
+{
+    delete [] m.rows;
+    free(m.data);
+    m.rows = NULL;
+    m.data = NULL;
+}
+
 /**
  * Initialize matrix with specified value
- * @param m pointer to matrix 
+ * @param m pointer to matrix, or a view (see matrix2d_view.h)
  * @param nrows num of rows
  * @param ncols num of columns
  * @param val value to initialize all emenents with
  */
-template <typename T>
-void matrix2d_init(T** m, size_t nrows, size_t ncols, T val)
+template <typename M, typename T>
+void matrix2d_init(M m, size_t nrows, size_t ncols, T val)
 {
     for ( size_t i = 0; i < nrows; i++ )
         for ( size_t j = 0; j < ncols; j++ )  
             m[i][j] = val;
 }
 
+template <typename T, typename V>
+void _matrix2d_init_rows(T** m, size_t nrows, size_t ncols, V val, bool nt)
+{
+    T v = val;
+
+    if ( nt && 16 % sizeof(T) == 0 && std::is_trivially_copyable<T>::value ) {
+        unsigned char pat[16];
+        for ( size_t k = 0; k < 16; k += sizeof(T) )
+            memcpy(pat + k, static_cast<void*>(&v), sizeof(T));
+        for ( size_t i = 0; i < nrows; i++ )
+            stream_fill_nt(m[i], pat, ncols * sizeof(T));
+        stream_fence();
+        return;
+    }
+
+    for ( size_t i = 0; i < nrows; i++ )
+        for ( size_t j = 0; j < ncols; j++ )  
+            m[i][j] = v;
+}
+
+/**
+ * Initialize matrix with specified value.
+ * Matrices of at least stream_threshold() bytes are written with
+ * streaming stores, so they do not evict the rest of the cache.
+ * @param m pointer to matrix 
+ * @param nrows num of rows
+ * @param ncols num of columns
+ * @param val value to initialize all emenents with
+ */
+template <typename T, typename V>
+void matrix2d_init(T** m, size_t nrows, size_t ncols, V val)
+{
+    _matrix2d_init_rows(m, nrows, ncols, val,
+                        stream_use_nt(nrows * ncols * sizeof(T)));
+}
+
 /**
  * Initialize matrix with random double values
  * @param m pointer to matrix 
  * @param nrows num of rows
  * @param ncols num of columns
  */
-void matrix2d_init_random_double(double **m, size_t nrows, size_t ncols)
+inline void matrix2d_init_random_double(double **m, size_t nrows, size_t ncols)
 {
     for ( size_t i = 0; i < nrows; i++ )
         for ( size_t j = 0; j < ncols; j++ )
@@ -82,13 +223,13 @@ void matrix2d_destroy(T** m, size_t nrows)
 
 /**
  * Copy matrices
- * @param s source matrix
- * @param t destination matrix
+ * @param s source matrix, or a view
+ * @param t destination matrix, or a view
  * @param nrows number of matrix rows
  * @param ncols number of matrix columns
  */
-template <typename T>
-void matrix2d_copy(T** s, T** t, size_t nrows, size_t ncols)
+template <typename S, typename D>
+void matrix2d_copy(S s, D t, size_t nrows, size_t ncols)
 {
     for ( size_t i = 0; i < nrows; i++ )
         for ( size_t j = 0; j < ncols; j++ )
@@ -96,15 +237,45 @@ void matrix2d_copy(T** s, T** t, size_t nrows, size_t ncols)
 }
 
 
+template <typename T>
+void _matrix2d_copy_rows(T** s, T** t, size_t nrows, size_t ncols, bool nt)
+{
+    if ( nt && std::is_trivially_copyable<T>::value ) {
+        for ( size_t i = 0; i < nrows; i++ )
+            stream_copy_nt(static_cast<void*>(t[i]), s[i], ncols * sizeof(T));
+        stream_fence();
+        return;
+    }
+
+    for ( size_t i = 0; i < nrows; i++ )
+        for ( size_t j = 0; j < ncols; j++ )
+            t[i][j] = s[i][j];
+}
+
+/**
+ * Copy matrices.
+ * Matrices of at least stream_threshold() bytes are written with
+ * streaming stores.
+ * @param s source matrix
+ * @param t destination matrix
+ * @param nrows number of matrix rows
+ * @param ncols number of matrix columns
+ */
+template <typename T>
+void matrix2d_copy(T** s, T** t, size_t nrows, size_t ncols)
+{
+    _matrix2d_copy_rows(s, t, nrows, ncols,
+                        stream_use_nt(nrows * ncols * sizeof(T)));
+}
 
 /**
  * Print matrix 
- * @param m pointer to matrix 
+ * @param m pointer to matrix, or a view
  * @param nrows num of rows
  * @param ncols num of columns
  */
-template <typename T>
-void matrix2d_print(T** m, size_t nrows, size_t ncols)
+template <typename M>
+void matrix2d_print(M m, size_t nrows, size_t ncols)
 {
     std::cout << "Matrix = [ " << std::endl;
     for ( size_t i = 0; i < nrows; i++ ) {
@@ -0,0 +1,256 @@
+/**
+ * @file
+ * Expression templates for elementwise matrix arithmetic.
+ *
+ * Wrap matrices in matrix2d_ref and write arithmetic as usual:
+ *
+ *   matrix2d_ref<double> A(a, n, n), B(b, n, n), C(c, n, n), D(d, n, n);
+ *   C = 2.0 * A + B - D;
+ *
+ * Operators build a lightweight expression object instead of a
+ * matrix; assignment evaluates it in a single pass, row by row, with
+ * an innermost loop over plain pointers that the compiler can
+ * vectorize. No temporary matrices are allocated.
+ */
+#ifndef MATRIX2D_EXPR_H_
+#define MATRIX2D_EXPR_H_
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "matrix2d.h"
+
+/**
+ * Base of all expressions (CRTP); E provides value_type, nrows(),
+ * ncols(), a row_t type indexable by column, and row(i)
+ */
+template <typename E>
+struct matrix2d_expr {
+    const E& self() const { return static_cast<const E&>(*this); }
+};
+
+/**
+ * Non-owning reference to a nrows x ncols matrix given as row
+ * pointers (matrix2d_alloc, or the 'rows' of a matrix2d_t).
+ * Assigning an expression (or another matrix2d_ref) to it writes the
+ * elements of the referenced matrix.
+ */
+template <typename T>
+struct matrix2d_ref : matrix2d_expr< matrix2d_ref<T> > {
+    typedef T value_type;
+    typedef const T* row_t;
+
+    T **rows;
+    size_t nr, nc;
+
+    matrix2d_ref(T **m, size_t nrows, size_t ncols)
+        : rows(m), nr(nrows), nc(ncols) {}
+    matrix2d_ref(const matrix2d_t<T>& m)
+        : rows(m.rows), nr(m.nrows), nc(m.ncols) {}
+    matrix2d_ref(const matrix2d_ref& o)
+        : rows(o.rows), nr(o.nr), nc(o.nc) {}
+
+    size_t nrows() const { return nr; }
+    size_t ncols() const { return nc; }
+    row_t row(size_t i) const { return rows[i]; }
+    T& operator()(size_t i, size_t j) const { return rows[i][j]; }
+
+    template <typename E>
+    matrix2d_ref& operator=(const matrix2d_expr<E>& e)
+    {
+        const E& x = e.self();
+        _check(x.nrows(), x.ncols());
+        for ( size_t i = 0; i < nr; i++ ) {
+            T *c = rows[i];
+            typename E::row_t r = x.row(i);
+            for ( size_t j = 0; j < nc; j++ )
+                c[j] = r[j];
+        }
+        return *this;
+    }
+
+    matrix2d_ref& operator=(const matrix2d_ref& o)
+    {
+        return *this = static_cast<const matrix2d_expr<matrix2d_ref>&>(o);
+    }
+
+    template <typename E>
+    matrix2d_ref& operator+=(const matrix2d_expr<E>& e)
+    {
+        const E& x = e.self();
+        _check(x.nrows(), x.ncols());
+        for ( size_t i = 0; i < nr; i++ ) {
+            T *c = rows[i];
+            typename E::row_t r = x.row(i);
+            for ( size_t j = 0; j < nc; j++ )
+                c[j] += r[j];
+        }
+        return *this;
+    }
+
+    template <typename E>
+    matrix2d_ref& operator-=(const matrix2d_expr<E>& e)
+    {
+        const E& x = e.self();
+        _check(x.nrows(), x.ncols());
+        for ( size_t i = 0; i < nr; i++ ) {
+            T *c = rows[i];
+            typename E::row_t r = x.row(i);
+            for ( size_t j = 0; j < nc; j++ )
+                c[j] -= r[j];
+        }
+        return *this;
+    }
+
+private:
+    void _check(size_t r, size_t c) const
+    {
+        if ( r != nr || c != nc ) {
+            fprintf(stderr, "matrix2d_ref: assigning %zux%zu expression "
+                    "to %zux%zu matrix\n", r, c, nr, nc);
+            exit(EXIT_FAILURE);
+        }
+    }
+};
+
+struct _matrix2d_op_add {
+    template <typename T> static T apply(T a, T b) { return a + b; }
+};
+struct _matrix2d_op_sub {
+    template <typename T> static T apply(T a, T b) { return a - b; }
+};
+struct _matrix2d_op_mul {
+    template <typename T> static T apply(T a, T b) { return a * b; }
+};
+
+/**
+ * Elementwise binary operation of two expressions of equal size
+ */
+template <typename L, typename R, typename Op>
+struct matrix2d_binary : matrix2d_expr< matrix2d_binary<L, R, Op> > {
+    typedef typename L::value_type value_type;
+
+    struct row_t {
+        typename L::row_t l;
+        typename R::row_t r;
+        value_type operator[](size_t j) const { return Op::apply(l[j], r[j]); }
+    };
+
+    L l;
+    R r;
+
+    matrix2d_binary(const L& a, const R& b) : l(a), r(b)
+    {
+        if ( a.nrows() != b.nrows() || a.ncols() != b.ncols() ) {
+            fprintf(stderr, "matrix2d_expr: operands of size %zux%zu and "
+                    "%zux%zu\n", a.nrows(), a.ncols(), b.nrows(), b.ncols());
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    size_t nrows() const { return l.nrows(); }
+    size_t ncols() const { return l.ncols(); }
+    row_t row(size_t i) const { row_t x = { l.row(i), r.row(i) }; return x; }
+};
+
+/**
+ * Expression multiplied by a scalar
+ */
+template <typename E>
+struct matrix2d_scaled : matrix2d_expr< matrix2d_scaled<E> > {
+    typedef typename E::value_type value_type;
+
+    struct row_t {
+        value_type a;
+        typename E::row_t e;
+        value_type operator[](size_t j) const { return a * e[j]; }
+    };
+
+    value_type a;
+    E e;
+
+    matrix2d_scaled(value_type s, const E& x) : a(s), e(x) {}
+
+    size_t nrows() const { return e.nrows(); }
+    size_t ncols() const { return e.ncols(); }
+    row_t row(size_t i) const { row_t x = { a, e.row(i) }; return x; }
+};
+
+/**
+ * Expression divided by a scalar. Kept apart from matrix2d_scaled:
+ * multiplying by 1/s would give 0 for integer types and results that
+ * differ from x/s in floating point.
+ */
+template <typename E>
+struct matrix2d_divided : matrix2d_expr< matrix2d_divided<E> > {
+    typedef typename E::value_type value_type;
+
+    struct row_t {
+        value_type s;
+        typename E::row_t e;
+        value_type operator[](size_t j) const { return e[j] / s; }
+    };
+
+    value_type s;
+    E e;
+
+    matrix2d_divided(const E& x, value_type d) : s(d), e(x) {}
+
+    size_t nrows() const { return e.nrows(); }
+    size_t ncols() const { return e.ncols(); }
+    row_t row(size_t i) const { row_t x = { s, e.row(i) }; return x; }
+};
+
+template <typename L, typename R>
+matrix2d_binary<L, R, _matrix2d_op_add>
+operator+(const matrix2d_expr<L>& a, const matrix2d_expr<R>& b)
+{
+    return matrix2d_binary<L, R, _matrix2d_op_add>(a.self(), b.self());
+}
+
+template <typename L, typename R>
+matrix2d_binary<L, R, _matrix2d_op_sub>
+operator-(const matrix2d_expr<L>& a, const matrix2d_expr<R>& b)
+{
+    return matrix2d_binary<L, R, _matrix2d_op_sub>(a.self(), b.self());
+}
+
+template <typename E>
+matrix2d_scaled<E>
+operator*(typename E::value_type s, const matrix2d_expr<E>& e)
+{
+    return matrix2d_scaled<E>(s, e.self());
+}
+
+template <typename E>
+matrix2d_scaled<E>
+operator*(const matrix2d_expr<E>& e, typename E::value_type s)
+{
+    return matrix2d_scaled<E>(s, e.self());
+}
+
+template <typename E>
+matrix2d_divided<E>
+operator/(const matrix2d_expr<E>& e, typename E::value_type s)
+{
+    return matrix2d_divided<E>(e.self(), s);
+}
+
+template <typename E>
+matrix2d_scaled<E> operator-(const matrix2d_expr<E>& e)
+{
+    return matrix2d_scaled<E>(typename E::value_type(-1), e.self());
+}
+
+/**
+ * Elementwise (Hadamard) product; operator* between matrices is left
+ * undefined so it is not mistaken for a matrix multiply
+ */
+template <typename L, typename R>
+matrix2d_binary<L, R, _matrix2d_op_mul>
+matrix2d_emul(const matrix2d_expr<L>& a, const matrix2d_expr<R>& b)
+{
+    return matrix2d_binary<L, R, _matrix2d_op_mul>(a.self(), b.self());
+}
+
+#endif
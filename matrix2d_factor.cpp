@@ -0,0 +1,426 @@
+/**
+ * @file
+ * Blocked LU and Cholesky factorisation.
+ *
+ * Almost all flops of the blocked versions are in the trailing updates,
+ * done by matrix2d_gemm on row pointers into A; the triangular solves
+ * are chunked so that the rows they sweep over stay in L2. Threads are
+ * created once per factorisation, not once per panel, and the panel
+ * factorisation overlaps the trailing updates.
+ */
+
+#include "matrix2d_factor.h"
+
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#include "matrix2d.h"
+#include "matrix2d_gemm.h"
+#include "matrix2d_parallel.h"
+#include "matrix2d_transpose.h"
+
+//! Columns per chunk of the triangular solve of the LU block row
+#define TRSM_COLS 256
+
+/**
+ * Unblocked LU of columns [k, k1) of rows [k, n), pivot rows searched
+ * over [k, n) and swapped whole
+ * @return 0, or j+1 if column j has no nonzero pivot
+ */
+static int _lu_panel(size_t n, double **A, size_t *piv, size_t k, size_t k1)
+{
+    for ( size_t j = k; j < k1; j++ ) {
+        size_t p = j;
+        double max = std::fabs(A[j][j]), r;
+        const double *uj;
+
+        for ( size_t i = j + 1; i < n; i++ )
+            if ( std::fabs(A[i][j]) > max ) {
+                max = std::fabs(A[i][j]);
+                p = i;
+            }
+        piv[j] = p;
+        if ( max == 0.0 )
+            return j + 1;
+        std::swap(A[j], A[p]);
+
+        r = 1.0 / A[j][j];
+        uj = A[j];
+        for ( size_t i = j + 1; i < n; i++ ) {
+            double *ai = A[i], l = ai[j] *= r;
+
+            for ( size_t c = j + 1; c < k1; c++ )
+                ai[c] -= l * uj[c];
+        }
+    }
+    return 0;
+}
+
+/**
+ * LU factorisation with partial pivoting, textbook right-looking
+ * elimination
+ * @param n order of A
+ * @param A n x n matrix, overwritten by L (unit diagonal, not stored)
+ *        and U; rows are permuted as described in matrix2d_factor.h
+ * @param piv n pivot indices: row j was interchanged with row piv[j]
+ * @return 0, or j+1 if the matrix is singular (U[j][j] == 0); the
+ *         factorisation stops there
+ */
+int matrix2d_lu_naive(size_t n, double **A, size_t *piv)
+{
+    return _lu_panel(n, A, piv, 0, n);
+}
+
+/**
+ * Triangular solve A12 = L11^-1 A12 and update A22 -= L21 U12 of
+ * columns [c0, c1) after panel [k, k1)
+ * @param S row pointers of A as they were when the panel was factored
+ * @param pa, pc n row pointers, pb nb row pointers (scratch)
+ */
+static void _lu_update(size_t n, double **S, size_t k, size_t k1,
+                       size_t c0, size_t c1, double **pa, double **pb,
+                       double **pc)
+{
+    size_t m = n - k1;
+
+    if ( c0 >= c1 )
+        return;
+
+    for ( size_t cb = c0; cb < c1; cb += TRSM_COLS ) {
+        size_t ce = cb + TRSM_COLS < c1 ? cb + TRSM_COLS : c1;
+
+        for ( size_t i = k + 1; i < k1; i++ ) {
+            double *ai = S[i];
+
+            for ( size_t p = k; p < i; p++ ) {
+                const double *up = S[p];
+                double l = ai[p];
+
+                for ( size_t c = cb; c < ce; c++ )
+                    ai[c] -= l * up[c];
+            }
+        }
+    }
+
+    for ( size_t i = 0; i < m; i++ ) {
+        pa[i] = S[k1 + i] + k;
+        pc[i] = S[k1 + i] + c0;
+    }
+    for ( size_t p = 0; p < k1 - k; p++ )
+        pb[p] = S[k + p] + c0;
+    matrix2d_gemm(m, c1 - c0, k1 - k, -1.0, pa, pb, 1.0, pc);
+}
+
+/**
+ * Blocked, multi-threaded LU factorisation with partial pivoting.
+ *
+ * All panels are done in one parallel region, with a look-ahead of one
+ * panel: while the other threads update the trailing matrix with panel
+ * s, thread 0 updates the columns of panel s+1 and factors it. Thread
+ * 0 thus swaps rows of A during the update, which works on a copy of
+ * the row pointers taken when panel s was factored (two copies, used
+ * alternately). Threads meet at one barrier per panel.
+ * @see matrix2d_lu_naive
+ * @param pi processor map
+ * @param nthreads number of threads
+ * @param nb panel width
+ */
+int matrix2d_lu(size_t n, double **A, size_t *piv, procmap_t *pi,
+                int nthreads, size_t nb)
+{
+    double **S[2] = { new double* [n], new double* [n] };
+    pthread_barrier_t barrier;
+    volatile size_t failed = 0;
+    int info = _lu_panel(n, A, piv, 0, nb < n ? nb : n);
+
+    memcpy(S[0], A, n * sizeof(double*));
+    if ( info || nb >= n )
+        goto out;
+
+    pthread_barrier_init(&barrier, NULL, nthreads);
+
+    matrix2d_parallel_rows(pi, nthreads, nthreads,
+        [&](int tid, size_t, size_t) {
+            double **pa = new double* [n], **pb = new double* [nb],
+                   **pc = new double* [n];
+
+            // step s updates with panel [k, k1) and factors [k1, k2)
+            for ( size_t k = 0, s = 1; k + nb < n; k += nb, s++ ) {
+                size_t k1 = k + nb, k2 = k1 + nb < n ? k1 + nb : n,
+                       c0 = n, c1 = n;
+                double **Sk = S[(s - 1) & 1];
+
+                if ( tid == 0 ) {
+                    int r;
+
+                    _lu_update(n, Sk, k, k1, k1, k2, pa, pb, pc);
+                    r = _lu_panel(n, A, piv, k1, k2);
+                    memcpy(S[s & 1], A, n * sizeof(double*));
+                    if ( r ) {
+                        info = r;
+                        failed = s;
+                    }
+                }
+
+                // the other threads split columns [k2, n)
+                if ( nthreads == 1 ) {
+                    c0 = k2;
+                } else if ( tid > 0 ) {
+                    matrix2d_par_range(n - k2, tid - 1, nthreads - 1, &c0, &c1);
+                    c0 += k2;
+                    c1 += k2;
+                }
+                _lu_update(n, Sk, k, k1, c0, c1, pa, pb, pc);
+
+                pthread_barrier_wait(&barrier);
+                if ( failed == s )
+                    break;
+            }
+
+            delete [] pa;
+            delete [] pb;
+            delete [] pc;
+        });
+
+    pthread_barrier_destroy(&barrier);
+
+out:
+    delete [] S[0];
+    delete [] S[1];
+    return info;
+}
+
+/**
+ * Solves A x = b given the LU factors of A
+ * @param n order of A
+ * @param LU factors from matrix2d_lu or matrix2d_lu_naive
+ * @param piv pivot indices from the same call
+ * @param x right-hand side b on entry, solution on return
+ */
+void matrix2d_lu_solve(size_t n, double **LU, const size_t *piv, double *x)
+{
+    for ( size_t j = 0; j < n; j++ )
+        std::swap(x[j], x[piv[j]]);
+
+    for ( size_t i = 1; i < n; i++ ) {
+        double s = x[i];
+        for ( size_t p = 0; p < i; p++ )
+            s -= LU[i][p] * x[p];
+        x[i] = s;
+    }
+
+    for ( size_t i = n; i-- > 0; ) {
+        double s = x[i];
+        for ( size_t p = i + 1; p < n; p++ )
+            s -= LU[i][p] * x[p];
+        x[i] = s / LU[i][i];
+    }
+}
+
+/**
+ * Unblocked Cholesky of the diagonal block [k, k1) x [k, k1), whose
+ * columns before k are already eliminated
+ * @return 0, or j+1 if the block is not positive definite at column j
+ */
+static int _cholesky_block(double **A, size_t k, size_t k1)
+{
+    for ( size_t j = k; j < k1; j++ ) {
+        double *aj = A[j], d = aj[j];
+
+        for ( size_t p = k; p < j; p++ )
+            d -= aj[p] * aj[p];
+        if ( !(d > 0.0) )
+            return j + 1;
+        aj[j] = std::sqrt(d);
+
+        for ( size_t i = j + 1; i < k1; i++ ) {
+            double *ai = A[i], s = ai[j];
+
+            for ( size_t p = k; p < j; p++ )
+                s -= ai[p] * aj[p];
+            ai[j] = s / aj[j];
+        }
+    }
+    return 0;
+}
+
+static void _zero_upper(size_t n, double **A)
+{
+    for ( size_t i = 0; i + 1 < n; i++ )
+        memset(A[i] + i + 1, 0, (n - i - 1) * sizeof(double));
+}
+
+/**
+ * Cholesky factorisation A = L L^T of a symmetric positive definite
+ * matrix, textbook (dot product) form
+ * @param n order of A
+ * @param A n x n matrix; its lower triangle is read and overwritten by
+ *        L, its strict upper triangle is set to zero
+ * @return 0, or j+1 if A is not positive definite (the leading minor
+ *         of order j+1 is not positive); the factorisation stops there
+ */
+int matrix2d_cholesky_naive(size_t n, double **A)
+{
+    int info = _cholesky_block(A, 0, n);
+
+    _zero_upper(n, A);
+    return info;
+}
+
+/**
+ * Factors the diagonal block [k, k1) and solves L21 = A21 L11^-T for
+ * rows [k1, n); L11 is transposed into Lt first so that the solve runs
+ * along rows of Lt
+ * @return 0, or j+1 as _cholesky_block
+ */
+static int _cholesky_panel(size_t n, double **A, size_t k, size_t k1,
+                           double **Lt)
+{
+    size_t b = k1 - k;
+    int info = _cholesky_block(A, k, k1);
+
+    if ( info )
+        return info;
+
+    for ( size_t j = 0; j < b; j++ )
+        for ( size_t p = j; p < b; p++ )
+            Lt[j][p] = A[k + p][k + j];
+
+    for ( size_t r = k1; r < n; r++ ) {
+        double *a = A[r] + k;
+
+        for ( size_t j = 0; j < b; j++ ) {
+            const double *lj = Lt[j];
+            double x = a[j] /= lj[j];
+
+            for ( size_t p = j + 1; p < b; p++ )
+                a[p] -= x * lj[p];
+        }
+    }
+    return 0;
+}
+
+/**
+ * Blocked, multi-threaded Cholesky factorisation.
+ *
+ * All panels are done in one parallel region, with a look-ahead of one
+ * panel: the threads transpose L21 of panel s into W together; then
+ * thread 0 updates the columns of panel s+1 and factors it while the
+ * other threads update the rest of the trailing matrix. Threads meet
+ * at two barriers per panel.
+ * @see matrix2d_cholesky_naive
+ * @param pi processor map
+ * @param nthreads number of threads
+ * @param nb panel width
+ */
+int matrix2d_cholesky(size_t n, double **A, procmap_t *pi, int nthreads,
+                      size_t nb)
+{
+    double **Lt = matrix2d_alloc<double>(nb, nb);
+    matrix2d_t<double> W = matrix2d_alloc_contig<double>(nb, n);
+    pthread_barrier_t barrier;
+    volatile size_t failed = 0;
+    int info = _cholesky_panel(n, A, 0, nb < n ? nb : n, Lt);
+
+    if ( info || nb >= n )
+        goto out;
+
+    pthread_barrier_init(&barrier, NULL, nthreads);
+
+    matrix2d_parallel_rows(pi, nthreads, nthreads,
+        [&](int tid, size_t, size_t) {
+            double **pa = new double* [n], **pc = new double* [n],
+                   **pd = new double* [n], **pw = new double* [nb];
+            int nu = nthreads > 1 ? nthreads - 1 : 1,
+                u = nthreads > 1 ? tid - 1 : 0;
+
+            // step s updates with panel [k, k1) and factors [k1, k2)
+            for ( size_t k = 0, s = 1; k + nb < n; k += nb, s++ ) {
+                size_t k1 = k + nb, k2 = k1 + nb < n ? k1 + nb : n,
+                       m = n - k1, d = k2 - k1, r0, r1;
+
+                for ( size_t i = 0; i < m; i++ ) {
+                    pa[i] = A[k1 + i] + k;
+                    pc[i] = A[k1 + i] + k1;
+                    pd[i] = pc[i] + d;
+                }
+
+                // W = L21^T, threads split the rows of L21
+                matrix2d_par_range(m, tid, nthreads, &r0, &r1);
+                for ( size_t p = 0; p < nb; p++ )
+                    pw[p] = W.rows[p] + r0;
+                matrix2d_transpose_simd(pa + r0, pw, r1 - r0, nb);
+                pthread_barrier_wait(&barrier);
+
+                if ( tid == 0 ) {
+                    int r;
+
+                    matrix2d_gemm(m, d, nb, -1.0, pa, W.rows, 1.0, pc);
+                    if ( (r = _cholesky_panel(n, A, k1, k2, Lt)) ) {
+                        info = r;
+                        failed = s;
+                    }
+                }
+
+                // A22 -= L21 L21^T for columns [k2, n), lower triangle
+                // only: row block [i, ie) is updated up to column ie, in
+                // blocks of 2*nb rows (fewer gemm calls for little wasted
+                // work above the diagonal). Thread boundaries balance the
+                // triangular amount of work.
+                if ( tid > 0 || nthreads == 1 ) {
+                    r0 = d + (size_t)((m - d) * std::sqrt((double)u / nu));
+                    r1 = u + 1 == nu ? m :
+                        d + (size_t)((m - d) * std::sqrt((double)(u + 1) / nu));
+                    for ( size_t p = 0; p < nb; p++ )
+                        pw[p] = W.rows[p] + d;
+
+                    for ( size_t i = r0; i < r1; i += 2 * nb ) {
+                        size_t ie = i + 2 * nb < r1 ? i + 2 * nb : r1;
+                        matrix2d_gemm(ie - i, ie - d, nb, -1.0, pa + i, pw,
+                                      1.0, pd + i);
+                    }
+                }
+
+                pthread_barrier_wait(&barrier);
+                if ( failed == s )
+                    break;
+            }
+
+            delete [] pa;
+            delete [] pc;
+            delete [] pd;
+            delete [] pw;
+        });
+
+    pthread_barrier_destroy(&barrier);
+
+out:
+    _zero_upper(n, A);
+
+    matrix2d_destroy_contig(W);
+    matrix2d_destroy(Lt, nb);
+    return info;
+}
+
+/**
+ * Solves A x = b given the Cholesky factor of A
+ * @param n order of A
+ * @param L factor from matrix2d_cholesky or matrix2d_cholesky_naive
+ * @param x right-hand side b on entry, solution on return
+ */
+void matrix2d_cholesky_solve(size_t n, double **L, double *x)
+{
+    for ( size_t i = 0; i < n; i++ ) {
+        double s = x[i];
+        for ( size_t p = 0; p < i; p++ )
+            s -= L[i][p] * x[p];
+        x[i] = s / L[i][i];
+    }
+
+    for ( size_t i = n; i-- > 0; ) {
+        x[i] /= L[i][i];
+        for ( size_t p = 0; p < i; p++ )
+            x[p] -= L[i][p] * x[i];
+    }
+}
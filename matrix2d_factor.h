@@ -0,0 +1,38 @@
+/**
+ * @file
+ * LU (with partial pivoting) and Cholesky factorisation of double
+ * matrices from matrix2d.h, unblocked and blocked.
+ *
+ * The blocked versions are right-looking: factor a panel of
+ * MATRIX2D_FACTOR_NB columns, solve for the matching block row (or
+ * column) with a triangular solve, and update the trailing matrix with
+ * matrix2d_gemm. Each factorisation runs in a single region of pinned
+ * threads (see matrix2d_parallel.h) that meet at barriers, with a
+ * look-ahead of one panel: thread 0 updates and factors the next panel
+ * while the other threads update the rest of the trailing matrix.
+ *
+ * Row interchanges swap row pointers, not row contents: after
+ * matrix2d_lu*() returns, A[i] is row i of the factors of P*A, which
+ * is generally not the memory A[i] pointed to on entry.
+ */
+#ifndef MATRIX2D_FACTOR_H_
+#define MATRIX2D_FACTOR_H_
+
+#include <cstddef>
+
+#include "processor_map.h"
+
+//! Default panel width of the blocked factorisations
+#define MATRIX2D_FACTOR_NB 128
+
+int matrix2d_lu_naive(size_t n, double **A, size_t *piv);
+int matrix2d_lu(size_t n, double **A, size_t *piv, procmap_t *pi,
+                int nthreads, size_t nb = MATRIX2D_FACTOR_NB);
+void matrix2d_lu_solve(size_t n, double **LU, const size_t *piv, double *x);
+
+int matrix2d_cholesky_naive(size_t n, double **A);
+int matrix2d_cholesky(size_t n, double **A, procmap_t *pi, int nthreads,
+                      size_t nb = MATRIX2D_FACTOR_NB);
+void matrix2d_cholesky_solve(size_t n, double **L, double *x);
+
+#endif
@@ -0,0 +1,199 @@
+/**
+ * @file
+ * Binary matrix files: writing, header validation and mapping.
+ */
+
+#include "matrix2d_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstring>
+
+static void _header_init(matrix2d_file_header_t *hdr, uint32_t dtype,
+                         uint32_t elem_size, size_t nrows, size_t ncols,
+                         size_t ld)
+{
+    memset(hdr, 0, sizeof(*hdr));
+    memcpy(hdr->magic, MATRIX2D_FILE_MAGIC, sizeof(hdr->magic));
+    hdr->version = MATRIX2D_FILE_VERSION;
+    hdr->dtype = dtype;
+    hdr->elem_size = elem_size;
+    hdr->align = MATRIX2D_FILE_ALIGN;
+    hdr->nrows = nrows;
+    hdr->ncols = ncols;
+    hdr->ld = ld;
+    hdr->data_offset = (sizeof(*hdr) + MATRIX2D_FILE_ALIGN - 1) &
+                       ~(uint64_t)(MATRIX2D_FILE_ALIGN - 1);
+}
+
+/**
+ * Checks a header read from a file of 'size' bytes
+ * @return 0 if valid, -1 otherwise (with a message on stderr)
+ */
+static int _header_check(const char *path, const matrix2d_file_header_t *hdr,
+                         uint64_t size)
+{
+    const char *err = NULL;
+    uint64_t bytes;
+
+    // All fields are untrusted: the data size is computed with
+    // overflow checks, so a huge nrows or ld cannot wrap past the test,
+    // and ld must be nonzero so that the file size bounds nrows (the
+    // row pointer array has nrows entries)
+    if ( memcmp(hdr->magic, MATRIX2D_FILE_MAGIC, sizeof(hdr->magic)) )
+        err = "not a matrix file";
+    else if ( hdr->version != MATRIX2D_FILE_VERSION )
+        err = "unsupported version";
+    else if ( !hdr->elem_size || hdr->ld < hdr->ncols ||
+              (hdr->ld == 0 && hdr->nrows > 0) )
+        err = "bad dimensions";
+    else if ( hdr->align != MATRIX2D_FILE_ALIGN )
+        err = "bad alignment";
+    else if ( hdr->data_offset < sizeof(*hdr) ||
+              hdr->data_offset % hdr->align )
+        err = "bad data offset";
+    else if ( __builtin_mul_overflow(hdr->nrows, hdr->ld, &bytes) ||
+              __builtin_mul_overflow(bytes, (uint64_t)hdr->elem_size, &bytes) ||
+              __builtin_add_overflow(bytes, hdr->data_offset, &bytes) )
+        err = "bad dimensions";
+    else if ( bytes > size )
+        err = "file is truncated";
+
+    if ( err ) {
+        fprintf(stderr, "%s: %s\n", path, err);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Write matrix file from row pointers (untyped; see matrix2d_file_write())
+ * Padding between ncols and ld is written as zeros.
+ * @return 0 on success, -1 on error
+ */
+int matrix2d_file_write_raw(const char *path, uint32_t dtype,
+                            uint32_t elem_size, const void * const *rows,
+                            size_t nrows, size_t ncols, size_t ld)
+{
+    matrix2d_file_header_t hdr;
+    size_t row_bytes = ncols * elem_size, pad = (ld - ncols) * elem_size;
+    char *zeros;
+    FILE *fp;
+    int ret = 0;
+
+    _header_init(&hdr, dtype, elem_size, nrows, ncols, ld);
+
+    if ( !(fp = fopen(path, "w")) ) {
+        perror(path);
+        return -1;
+    }
+
+    zeros = static_cast<char*>(calloc(1, hdr.data_offset > pad ?
+                                         hdr.data_offset : pad));
+    if ( !zeros ) {
+        fprintf(stderr, "%s: Allocation error\n", __FUNCTION__);
+        fclose(fp);
+        return -1;
+    }
+    if ( fwrite(&hdr, sizeof(hdr), 1, fp) != 1 ||
+         fwrite(zeros, hdr.data_offset - sizeof(hdr), 1, fp) != 1 )
+        ret = -1;
+
+    for ( size_t i = 0; i < nrows && !ret; i++ ) {
+        if ( fwrite(rows[i], row_bytes, 1, fp) != 1 ||
+             (pad && fwrite(zeros, pad, 1, fp) != 1) )
+            ret = -1;
+    }
+
+    if ( fclose(fp) )
+        ret = -1;
+    if ( ret )
+        perror(path);
+
+    free(zeros);
+    return ret;
+}
+
+/**
+ * Read and validate the header of a matrix file
+ * @return 0 on success, -1 on error
+ */
+int matrix2d_file_read_header(const char *path, matrix2d_file_header_t *hdr)
+{
+    struct stat st;
+    int fd, ret = -1;
+
+    if ( (fd = open(path, O_RDONLY)) < 0 ) {
+        perror(path);
+        return -1;
+    }
+
+    if ( fstat(fd, &st) || pread(fd, hdr, sizeof(*hdr), 0) != sizeof(*hdr) )
+        fprintf(stderr, "%s: could not read header\n", path);
+    else
+        ret = _header_check(path, hdr, st.st_size);
+
+    close(fd);
+    return ret;
+}
+
+/**
+ * Map a matrix file (untyped; see matrix2d_file_open())
+ * @param path file
+ * @param flags MATRIX2D_MAP_* flags
+ * @param hdr file header, filled in
+ * @param length length of the mapping, filled in
+ * @return start of the mapping (the header), NULL on error
+ */
+void* matrix2d_file_map(const char *path, int flags,
+                        matrix2d_file_header_t *hdr, size_t *length)
+{
+    struct stat st;
+    void *base;
+    int fd, prot = PROT_READ, mflags = MAP_SHARED;
+
+    if ( (fd = open(path, O_RDONLY)) < 0 ) {
+        perror(path);
+        return NULL;
+    }
+    if ( fstat(fd, &st) || st.st_size < (off_t)sizeof(*hdr) ||
+         pread(fd, hdr, sizeof(*hdr), 0) != sizeof(*hdr) ||
+         _header_check(path, hdr, st.st_size) ) {
+        close(fd);
+        return NULL;
+    }
+
+    if ( flags & MATRIX2D_MAP_COW ) {
+        prot |= PROT_WRITE;
+        mflags = MAP_PRIVATE;
+    }
+    if ( flags & MATRIX2D_MAP_POPULATE )
+        mflags |= MAP_POPULATE;
+
+    *length = st.st_size;
+    base = mmap(NULL, *length, prot, mflags, fd, 0);
+    close(fd);
+    if ( base == MAP_FAILED ) {
+        perror(path);
+        return NULL;
+    }
+
+    if ( flags & MATRIX2D_MAP_SEQUENTIAL )
+        madvise(base, *length, MADV_SEQUENTIAL);
+    if ( flags & MATRIX2D_MAP_RANDOM )
+        madvise(base, *length, MADV_RANDOM);
+    if ( flags & MATRIX2D_MAP_WILLNEED )
+        madvise(base, *length, MADV_WILLNEED);
+
+    return base;
+}
+
+/**
+ * Unmap a mapping returned by matrix2d_file_map()
+ */
+void matrix2d_file_unmap(void *base, size_t length)
+{
+    munmap(base, length);
+}
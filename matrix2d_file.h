@@ -0,0 +1,165 @@
+/**
+ * @file
+ * Binary on-disk matrix format, mapped zero-copy with mmap.
+ *
+ * A file is a matrix2d_file_header_t followed, at 'data_offset', by
+ * nrows rows of 'ld' elements each (row-major, native byte order).
+ * data_offset is a multiple of the page size, and ld is chosen as for
+ * matrix2d_alloc_contig(), so a mapped file gives the same aligned,
+ * padded layout as a contiguous matrix in memory; opening one only
+ * builds the row pointers.
+ */
+#ifndef MATRIX2D_FILE_H_
+#define MATRIX2D_FILE_H_
+
+#include <stdint.h>
+#include <cstdio>
+
+#include "matrix2d.h"
+
+#define MATRIX2D_FILE_MAGIC "MATRIX2D"
+#define MATRIX2D_FILE_VERSION 1
+
+//! Alignment of the data section in the file (and in the mapping)
+#define MATRIX2D_FILE_ALIGN 4096
+
+//! Element types
+enum {
+    MATRIX2D_DTYPE_F32 = 1,
+    MATRIX2D_DTYPE_F64,
+    MATRIX2D_DTYPE_I32,
+    MATRIX2D_DTYPE_I64,
+    MATRIX2D_DTYPE_U8
+};
+
+//! Flags of matrix2d_file_open()
+enum {
+    MATRIX2D_MAP_RDONLY     = 0x00,  //!< shared, read-only mapping
+    MATRIX2D_MAP_COW        = 0x01,  //!< private, writable; writes are not
+                                     //!< carried through to the file
+    MATRIX2D_MAP_POPULATE   = 0x02,  //!< pre-fault all pages (MAP_POPULATE)
+    MATRIX2D_MAP_SEQUENTIAL = 0x04,  //!< madvise(MADV_SEQUENTIAL)
+    MATRIX2D_MAP_RANDOM     = 0x08,  //!< madvise(MADV_RANDOM)
+    MATRIX2D_MAP_WILLNEED   = 0x10   //!< madvise(MADV_WILLNEED)
+};
+
+/**
+ * File header (64 bytes)
+ */
+typedef struct {
+    char magic[8];          //!< MATRIX2D_FILE_MAGIC, not NUL-terminated
+    uint32_t version;
+    uint32_t dtype;         //!< MATRIX2D_DTYPE_*
+    uint32_t elem_size;     //!< bytes per element
+    uint32_t align;         //!< alignment of data_offset, in bytes
+    uint64_t nrows;
+    uint64_t ncols;
+    uint64_t ld;            //!< row stride, in elements (>= ncols)
+    uint64_t data_offset;   //!< start of row 0, from the start of the file
+    uint64_t reserved;
+} matrix2d_file_header_t;
+
+template <typename T> struct matrix2d_dtype;
+template <> struct matrix2d_dtype<float>    { enum { value = MATRIX2D_DTYPE_F32 }; };
+template <> struct matrix2d_dtype<double>   { enum { value = MATRIX2D_DTYPE_F64 }; };
+template <> struct matrix2d_dtype<int32_t>  { enum { value = MATRIX2D_DTYPE_I32 }; };
+template <> struct matrix2d_dtype<int64_t>  { enum { value = MATRIX2D_DTYPE_I64 }; };
+template <> struct matrix2d_dtype<uint8_t>  { enum { value = MATRIX2D_DTYPE_U8 }; };
+
+/**
+ * Matrix backed by a file mapping. With MATRIX2D_MAP_RDONLY the pages
+ * are read-only and writing through 'rows' faults.
+ */
+template <typename T>
+struct matrix2d_mmap_t : matrix2d_t<T> {
+    void *base;      //!< start of the mapping (the header)
+    size_t length;   //!< length of the mapping
+};
+
+int matrix2d_file_write_raw(const char *path, uint32_t dtype,
+                            uint32_t elem_size, const void * const *rows,
+                            size_t nrows, size_t ncols, size_t ld);
+int matrix2d_file_read_header(const char *path, matrix2d_file_header_t *hdr);
+void* matrix2d_file_map(const char *path, int flags,
+                        matrix2d_file_header_t *hdr, size_t *length);
+void matrix2d_file_unmap(void *base, size_t length);
+
+/**
+ * Write matrix to file
+ * @param path file to create (truncated if it exists)
+ * @param m pointer to matrix (any row pointers)
+ * @param nrows num of rows
+ * @param ncols num of columns
+ * @param ld row stride in the file, in elements (0 for
+ *        matrix2d_default_ld())
+ * @return 0 on success, -1 on error
+ */
+template <typename T>
+int matrix2d_file_write(const char *path, T** m, size_t nrows, size_t ncols,
+                        size_t ld = 0)
+{
+    return matrix2d_file_write_raw(path, matrix2d_dtype<T>::value, sizeof(T),
+                                   (const void * const *)m, nrows, ncols,
+                                   ld >= ncols ? ld :
+                                   matrix2d_default_ld<T>(ncols));
+}
+
+/**
+ * Map matrix file
+ * @param path file written by matrix2d_file_write()
+ * @param flags MATRIX2D_MAP_* flags
+ * @return matrix view (data and rows are NULL on error, e.g. if the
+ *         file holds another element type); release with
+ *         matrix2d_file_close()
+ */
+template <typename T>
+matrix2d_mmap_t<T> matrix2d_file_open(const char *path,
+                                      int flags = MATRIX2D_MAP_RDONLY)
+{
+    matrix2d_mmap_t<T> m;
+    matrix2d_file_header_t hdr;
+
+    m.rows = NULL;
+    m.data = NULL;
+    m.nrows = m.ncols = m.ld = 0;
+    m.base = matrix2d_file_map(path, flags, &hdr, &m.length);
+    if ( !m.base )
+        return m;
+
+    if ( hdr.dtype != (uint32_t)matrix2d_dtype<T>::value ||
+         hdr.elem_size != sizeof(T) ) {
+        fprintf(stderr, "%s: element type %u does not match %d\n", path,
+                hdr.dtype, (int)matrix2d_dtype<T>::value);
+        matrix2d_file_unmap(m.base, m.length);
+        m.base = NULL;
+        return m;
+    }
+
+    m.nrows = hdr.nrows;
+    m.ncols = hdr.ncols;
+    m.ld = hdr.ld;
+    m.data = reinterpret_cast<T*>(static_cast<char*>(m.base) +
+                                  hdr.data_offset);
+    m.rows = new T* [m.nrows];
+    for ( size_t i = 0; i < m.nrows; i++ )
+        m.rows[i] = m.data + i * m.ld;
+
+    return m;
+}
+
+/**
+ * Unmap matrix file
+ * @param m view as returned by matrix2d_file_open()
+ */
+template <typename T>
+void matrix2d_file_close(matrix2d_mmap_t<T>& m)
+{
+    delete [] m.rows;
+    if ( m.base )
+        matrix2d_file_unmap(m.base, m.length);
+    m.rows = NULL;
+    m.data = NULL;
+    m.base = NULL;
+}
+
+#endif
@@ -0,0 +1,204 @@
+/**
+ * @file
+ * Small matrices with dimensions fixed at compile time.
+ *
+ * Storage is a plain R x C array inside the object (no allocation,
+ * no row pointers), so matrices can live on the stack or be packed
+ * back-to-back in arrays. All loop bounds are constants and the
+ * kernels ask the compiler to unroll them fully. Everything is
+ * constexpr, so matrices can also be computed at compile time.
+ */
+#ifndef MATRIX2D_FIXED_H_
+#define MATRIX2D_FIXED_H_
+
+#include <cstddef>
+#include <iostream>
+
+/**
+ * R x C matrix of T, row-major
+ */
+template <typename T, size_t R, size_t C>
+struct matrix2d_fixed {
+    T a[R][C];
+
+    constexpr T& operator()(size_t i, size_t j) { return a[i][j]; }
+    constexpr const T& operator()(size_t i, size_t j) const { return a[i][j]; }
+
+    static constexpr size_t nrows() { return R; }
+    static constexpr size_t ncols() { return C; }
+
+    /**
+     * @return matrix with all elements equal to val
+     */
+    static constexpr matrix2d_fixed filled(T val)
+    {
+        matrix2d_fixed m{};
+        for ( size_t i = 0; i < R; i++ )
+            for ( size_t j = 0; j < C; j++ )
+                m.a[i][j] = val;
+        return m;
+    }
+
+    /**
+     * @return identity matrix (ones on the main diagonal)
+     */
+    static constexpr matrix2d_fixed identity()
+    {
+        matrix2d_fixed m{};
+        for ( size_t i = 0; i < R && i < C; i++ )
+            m.a[i][i] = T(1);
+        return m;
+    }
+};
+
+/**
+ * Matrix product, i-k-j order so that the innermost loop runs along
+ * rows of b and the result
+ * @return a * b
+ */
+template <typename T, size_t R, size_t K, size_t C>
+constexpr matrix2d_fixed<T, R, C>
+matrix2d_fixed_mul(const matrix2d_fixed<T, R, K>& a,
+                   const matrix2d_fixed<T, K, C>& b)
+{
+    matrix2d_fixed<T, R, C> c{};
+
+#pragma GCC unroll 16
+    for ( size_t i = 0; i < R; i++ )
+#pragma GCC unroll 16
+        for ( size_t k = 0; k < K; k++ )
+#pragma GCC unroll 16
+            for ( size_t j = 0; j < C; j++ )
+                c.a[i][j] += a.a[i][k] * b.a[k][j];
+
+    return c;
+}
+
+/**
+ * @return transpose of m
+ */
+template <typename T, size_t R, size_t C>
+constexpr matrix2d_fixed<T, C, R>
+matrix2d_fixed_transpose(const matrix2d_fixed<T, R, C>& m)
+{
+    matrix2d_fixed<T, C, R> t{};
+
+#pragma GCC unroll 16
+    for ( size_t i = 0; i < R; i++ )
+#pragma GCC unroll 16
+        for ( size_t j = 0; j < C; j++ )
+            t.a[j][i] = m.a[i][j];
+
+    return t;
+}
+
+template <typename T>
+constexpr T _matrix2d_fixed_abs(T x)
+{
+    return x < T(0) ? -x : x;
+}
+
+/**
+ * Inverse of a square matrix. 2x2 and 3x3 use the adjugate; larger
+ * sizes use Gauss-Jordan elimination with partial pivoting.
+ * @param m matrix to invert
+ * @param inv inverse of m, on success
+ * @return false if m is singular
+ */
+template <typename T, size_t N>
+constexpr bool matrix2d_fixed_inverse(const matrix2d_fixed<T, N, N>& m,
+                                      matrix2d_fixed<T, N, N>& inv)
+{
+    if constexpr ( N == 1 ) {
+        if ( m.a[0][0] == T(0) )
+            return false;
+        inv.a[0][0] = T(1) / m.a[0][0];
+        return true;
+    } else if constexpr ( N == 2 ) {
+        T det = m.a[0][0] * m.a[1][1] - m.a[0][1] * m.a[1][0];
+        if ( det == T(0) )
+            return false;
+        T r = T(1) / det;
+        inv.a[0][0] =  m.a[1][1] * r;
+        inv.a[0][1] = -m.a[0][1] * r;
+        inv.a[1][0] = -m.a[1][0] * r;
+        inv.a[1][1] =  m.a[0][0] * r;
+        return true;
+    } else if constexpr ( N == 3 ) {
+        const auto& a = m.a;
+        T c00 = a[1][1] * a[2][2] - a[1][2] * a[2][1],
+          c01 = a[1][2] * a[2][0] - a[1][0] * a[2][2],
+          c02 = a[1][0] * a[2][1] - a[1][1] * a[2][0];
+        T det = a[0][0] * c00 + a[0][1] * c01 + a[0][2] * c02;
+        if ( det == T(0) )
+            return false;
+        T r = T(1) / det;
+        inv.a[0][0] = c00 * r;
+        inv.a[1][0] = c01 * r;
+        inv.a[2][0] = c02 * r;
+        inv.a[0][1] = (a[0][2] * a[2][1] - a[0][1] * a[2][2]) * r;
+        inv.a[1][1] = (a[0][0] * a[2][2] - a[0][2] * a[2][0]) * r;
+        inv.a[2][1] = (a[0][1] * a[2][0] - a[0][0] * a[2][1]) * r;
+        inv.a[0][2] = (a[0][1] * a[1][2] - a[0][2] * a[1][1]) * r;
+        inv.a[1][2] = (a[0][2] * a[1][0] - a[0][0] * a[1][2]) * r;
+        inv.a[2][2] = (a[0][0] * a[1][1] - a[0][1] * a[1][0]) * r;
+        return true;
+    } else {
+        matrix2d_fixed<T, N, N> w = m;
+        inv = matrix2d_fixed<T, N, N>::identity();
+
+        for ( size_t k = 0; k < N; k++ ) {
+            size_t p = k;
+            for ( size_t i = k + 1; i < N; i++ )
+                if ( _matrix2d_fixed_abs(w.a[i][k]) >
+                     _matrix2d_fixed_abs(w.a[p][k]) )
+                    p = i;
+            if ( w.a[p][k] == T(0) )
+                return false;
+            if ( p != k ) {
+#pragma GCC unroll 16
+                for ( size_t j = 0; j < N; j++ ) {
+                    T t = w.a[k][j]; w.a[k][j] = w.a[p][j]; w.a[p][j] = t;
+                    t = inv.a[k][j]; inv.a[k][j] = inv.a[p][j]; inv.a[p][j] = t;
+                }
+            }
+
+            T r = T(1) / w.a[k][k];
+#pragma GCC unroll 16
+            for ( size_t j = 0; j < N; j++ ) {
+                w.a[k][j] *= r;
+                inv.a[k][j] *= r;
+            }
+
+            for ( size_t i = 0; i < N; i++ ) {
+                if ( i == k )
+                    continue;
+                T f = w.a[i][k];
+#pragma GCC unroll 16
+                for ( size_t j = 0; j < N; j++ ) {
+                    w.a[i][j] -= f * w.a[k][j];
+                    inv.a[i][j] -= f * inv.a[k][j];
+                }
+            }
+        }
+        return true;
+    }
+}
+
+/**
+ * Print matrix
+ */
+template <typename T, size_t R, size_t C>
+void matrix2d_fixed_print(const matrix2d_fixed<T, R, C>& m)
+{
+    std::cout << "Matrix = [ " << std::endl;
+    for ( size_t i = 0; i < R; i++ ) {
+        std::cout << "\t";
+        for ( size_t j = 0; j < C; j++ )
+            std::cout << m.a[i][j] << " ";
+        std::cout << ";" << std::endl;
+    }
+    std::cout << "]" << std::endl;
+}
+
+#endif
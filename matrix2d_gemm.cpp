@@ -0,0 +1,310 @@
+/**
+ * @file
+ * Cache-blocked matrix multiply.
+ *
+ * Loop structure follows the Goto/BLIS scheme: B is packed in
+ * kc x nc blocks (L3-resident), A in mc x kc blocks (L2-resident), and
+ * a micro-kernel multiplies a GEMM_MR-row sliver of A with a
+ * GEMM_NR-column sliver of B, keeping the GEMM_MR x GEMM_NR result in
+ * registers. The AVX2/FMA micro-kernel is chosen at run time; a scalar
+ * kernel is used on cpus without it.
+ */
+
+#include "matrix2d_gemm.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <immintrin.h>
+
+//! Blocking used when the cache hierarchy is unknown
+static gemm_blocking_t _blocking = { 120, 256, 4096 };
+
+typedef void (*gemm_kernel_t)(size_t kc, const double *a, const double *b,
+                              double *ab);
+
+/**
+ * Scalar micro-kernel
+ * @param kc depth of the slivers
+ * @param a packed GEMM_MR x kc sliver of A (column-major)
+ * @param b packed kc x GEMM_NR sliver of B (row-major)
+ * @param ab GEMM_MR x GEMM_NR result (row-major), overwritten
+ */
+static void _kernel_scalar(size_t kc, const double *a, const double *b,
+                           double *ab)
+{
+    double c[GEMM_MR * GEMM_NR] = { 0.0 };
+
+    for ( size_t p = 0; p < kc; p++ ) {
+        for ( int i = 0; i < GEMM_MR; i++ )
+            for ( int j = 0; j < GEMM_NR; j++ )
+                c[i * GEMM_NR + j] += a[i] * b[j];
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+    memcpy(ab, c, sizeof(c));
+}
+
+/**
+ * AVX2/FMA micro-kernel: 6x8 doubles in 12 ymm accumulators
+ */
+__attribute__((target("avx2,fma")))
+static void _kernel_avx2(size_t kc, const double *a, const double *b,
+                         double *ab)
+{
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd(),
+            c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd(),
+            c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd(),
+            c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd(),
+            c40 = _mm256_setzero_pd(), c41 = _mm256_setzero_pd(),
+            c50 = _mm256_setzero_pd(), c51 = _mm256_setzero_pd();
+    __m256d b0, b1, ai;
+
+    for ( size_t p = 0; p < kc; p++ ) {
+        b0 = _mm256_load_pd(b);
+        b1 = _mm256_load_pd(b + 4);
+
+        ai = _mm256_broadcast_sd(a + 0);
+        c00 = _mm256_fmadd_pd(ai, b0, c00);
+        c01 = _mm256_fmadd_pd(ai, b1, c01);
+        ai = _mm256_broadcast_sd(a + 1);
+        c10 = _mm256_fmadd_pd(ai, b0, c10);
+        c11 = _mm256_fmadd_pd(ai, b1, c11);
+        ai = _mm256_broadcast_sd(a + 2);
+        c20 = _mm256_fmadd_pd(ai, b0, c20);
+        c21 = _mm256_fmadd_pd(ai, b1, c21);
+        ai = _mm256_broadcast_sd(a + 3);
+        c30 = _mm256_fmadd_pd(ai, b0, c30);
+        c31 = _mm256_fmadd_pd(ai, b1, c31);
+        ai = _mm256_broadcast_sd(a + 4);
+        c40 = _mm256_fmadd_pd(ai, b0, c40);
+        c41 = _mm256_fmadd_pd(ai, b1, c41);
+        ai = _mm256_broadcast_sd(a + 5);
+        c50 = _mm256_fmadd_pd(ai, b0, c50);
+        c51 = _mm256_fmadd_pd(ai, b1, c51);
+
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+
+    _mm256_store_pd(ab + 0,  c00); _mm256_store_pd(ab + 4,  c01);
+    _mm256_store_pd(ab + 8,  c10); _mm256_store_pd(ab + 12, c11);
+    _mm256_store_pd(ab + 16, c20); _mm256_store_pd(ab + 20, c21);
+    _mm256_store_pd(ab + 24, c30); _mm256_store_pd(ab + 28, c31);
+    _mm256_store_pd(ab + 32, c40); _mm256_store_pd(ab + 36, c41);
+    _mm256_store_pd(ab + 40, c50); _mm256_store_pd(ab + 44, c51);
+}
+
+static gemm_kernel_t _select_kernel(void)
+{
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") )
+        return _kernel_avx2;
+    return _kernel_scalar;
+}
+
+static gemm_kernel_t _kernel = _select_kernel();
+
+/**
+ * Derives blocking sizes from the cache hierarchy of the first cpu.
+ * Without a call to this, blocking suitable for 32KB L1 / 256KB L2
+ * is used.
+ * @param pi processor map
+ */
+void matrix2d_gemm_init(procmap_t *pi)
+{
+    unsigned long l1 = 0, l2 = 0, l3 = 0;
+    size_t kc, mc, nc;
+
+    if ( !pi || pi->num_cpus < 1 )
+        return;
+
+    for ( int i = 0; i < pi->flat_threads[0].num_caches; i++ ) {
+        cacheinfo_t *c = &pi->flat_threads[0].cache[i];
+        if ( c->type[0] == 'I' )
+            continue;
+        if ( c->level == 1 )
+            l1 = c->size;
+        else if ( c->level == 2 )
+            l2 = c->size;
+        else if ( c->level == 3 )
+            l3 = c->size;
+    }
+
+    // B sliver (kc x NR) uses half of L1, leaving room for A slivers
+    if ( l1 ) {
+        kc = l1 / 2 / (GEMM_NR * sizeof(double));
+        kc = kc < 64 ? 64 : (kc > 1024 ? 1024 : kc);
+        _blocking.kc = kc & ~(size_t)7;
+    }
+    // A block (mc x kc) uses half of L2
+    if ( l2 ) {
+        mc = l2 / 2 / (_blocking.kc * sizeof(double));
+        mc -= mc % GEMM_MR;
+        _blocking.mc = mc < GEMM_MR ? GEMM_MR : mc;
+    }
+    // B block (kc x nc) uses half of L3
+    if ( l3 ) {
+        nc = l3 / 2 / (_blocking.kc * sizeof(double));
+        nc -= nc % GEMM_NR;
+        _blocking.nc = nc < GEMM_NR ? GEMM_NR : (nc > 8192 ? 8192 : nc);
+    }
+}
+
+/**
+ * @return blocking sizes in use
+ */
+gemm_blocking_t matrix2d_gemm_blocking(void)
+{
+    return _blocking;
+}
+
+/**
+ * @return name of the micro-kernel in use
+ */
+const char* matrix2d_gemm_kernel_name(void)
+{
+    return _kernel == _kernel_avx2 ? "avx2/fma 6x8" : "scalar 6x8";
+}
+
+/**
+ * Packs an mc x kc block of A (starting at row i0, column p0) into
+ * GEMM_MR-row slivers, zero-padding the last one
+ */
+static void _pack_a(double **A, size_t i0, size_t p0, size_t mc, size_t kc,
+                    double *ap)
+{
+    for ( size_t ir = 0; ir < mc; ir += GEMM_MR ) {
+        size_t mr = mc - ir < GEMM_MR ? mc - ir : GEMM_MR;
+        const double *rows[GEMM_MR];
+
+        for ( size_t i = 0; i < mr; i++ )
+            rows[i] = A[i0 + ir + i] + p0;
+
+        for ( size_t p = 0; p < kc; p++ ) {
+            for ( size_t i = 0; i < mr; i++ )
+                ap[i] = rows[i][p];
+            for ( size_t i = mr; i < GEMM_MR; i++ )
+                ap[i] = 0.0;
+            ap += GEMM_MR;
+        }
+    }
+}
+
+/**
+ * Packs a kc x nc block of B (starting at row p0, column j0) into
+ * GEMM_NR-column slivers, zero-padding the last one
+ */
+static void _pack_b(double **B, size_t p0, size_t j0, size_t kc, size_t nc,
+                    double *bp)
+{
+    for ( size_t jr = 0; jr < nc; jr += GEMM_NR ) {
+        size_t nr = nc - jr < GEMM_NR ? nc - jr : GEMM_NR;
+
+        for ( size_t p = 0; p < kc; p++ ) {
+            const double *row = B[p0 + p] + j0 + jr;
+            for ( size_t j = 0; j < nr; j++ )
+                bp[j] = row[j];
+            for ( size_t j = nr; j < GEMM_NR; j++ )
+                bp[j] = 0.0;
+            bp += GEMM_NR;
+        }
+    }
+}
+
+static double* _alloc_aligned(size_t n)
+{
+    void *p;
+
+    if ( posix_memalign(&p, 64, n * sizeof(double)) ) {
+        fprintf(stderr, "%s: Allocation error\n", __FUNCTION__);
+        exit(EXIT_FAILURE);
+    }
+    return static_cast<double*>(p);
+}
+
+/**
+ * C = alpha * A * B + beta * C
+ * Matrices are given as row pointers (as returned by matrix2d_alloc,
+ * or the 'rows' of a matrix2d_t). Safe to call concurrently on
+ * disjoint parts of C: packing buffers are private to each call.
+ * @param m rows of A and C
+ * @param n columns of B and C
+ * @param k columns of A, rows of B
+ * @param alpha scalar multiplying A*B
+ * @param A m x k matrix
+ * @param B k x n matrix
+ * @param beta scalar multiplying C
+ * @param C m x n matrix, updated in place
+ */
+void matrix2d_gemm(size_t m, size_t n, size_t k, double alpha,
+                   double **A, double **B, double beta, double **C)
+{
+    gemm_blocking_t bl = _blocking;
+    double *ap, *bp;
+    double ab[GEMM_MR * GEMM_NR] __attribute__((aligned(32)));
+
+    if ( beta != 1.0 ) {
+        for ( size_t i = 0; i < m; i++ )
+            for ( size_t j = 0; j < n; j++ )
+                C[i][j] = beta == 0.0 ? 0.0 : beta * C[i][j];
+    }
+    if ( !m || !n || !k || alpha == 0.0 )
+        return;
+
+    ap = _alloc_aligned((bl.mc + GEMM_MR) * bl.kc);
+    bp = _alloc_aligned((bl.nc + GEMM_NR) * bl.kc);
+
+    for ( size_t jc = 0; jc < n; jc += bl.nc ) {
+        size_t nc = n - jc < bl.nc ? n - jc : bl.nc;
+
+        for ( size_t pc = 0; pc < k; pc += bl.kc ) {
+            size_t kc = k - pc < bl.kc ? k - pc : bl.kc;
+
+            _pack_b(B, pc, jc, kc, nc, bp);
+
+            for ( size_t ic = 0; ic < m; ic += bl.mc ) {
+                size_t mc = m - ic < bl.mc ? m - ic : bl.mc;
+
+                _pack_a(A, ic, pc, mc, kc, ap);
+
+                for ( size_t jr = 0; jr < nc; jr += GEMM_NR ) {
+                    size_t nr = nc - jr < GEMM_NR ? nc - jr : GEMM_NR;
+                    const double *bs = bp + jr * kc;
+
+                    for ( size_t ir = 0; ir < mc; ir += GEMM_MR ) {
+                        size_t mr = mc - ir < GEMM_MR ? mc - ir : GEMM_MR;
+
+                        _kernel(kc, ap + ir * kc, bs, ab);
+
+                        for ( size_t i = 0; i < mr; i++ ) {
+                            double *c = C[ic + ir + i] + jc + jr;
+                            for ( size_t j = 0; j < nr; j++ )
+                                c[j] += alpha * ab[i * GEMM_NR + j];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    free(ap);
+    free(bp);
+}
+
+/**
+ * Reference triple loop (i-k-j order), for validation
+ */
+void matrix2d_gemm_naive(size_t m, size_t n, size_t k, double alpha,
+                         double **A, double **B, double beta, double **C)
+{
+    for ( size_t i = 0; i < m; i++ ) {
+        for ( size_t j = 0; j < n; j++ )
+            C[i][j] *= beta;
+        for ( size_t p = 0; p < k; p++ ) {
+            double a = alpha * A[i][p];
+            for ( size_t j = 0; j < n; j++ )
+                C[i][j] += a * B[p][j];
+        }
+    }
+}
@@ -0,0 +1,37 @@
+/**
+ * @file
+ * Cache-blocked matrix multiply for double matrices from matrix2d.h
+ */
+#ifndef MATRIX2D_GEMM_H_
+#define MATRIX2D_GEMM_H_
+
+#include <cstddef>
+
+#include "processor_map.h"
+
+//! Register block (micro-tile) dimensions: GEMM_MR x GEMM_NR of C
+//! is kept in registers by the micro-kernel
+#define GEMM_MR 6
+#define GEMM_NR 8
+
+/**
+ * Cache blocking sizes.
+ * A kc x GEMM_NR panel of B stays in L1, an mc x kc block of A in L2
+ * and a kc x nc block of B in L3.
+ */
+typedef struct {
+    size_t mc;
+    size_t kc;
+    size_t nc;
+} gemm_blocking_t;
+
+void matrix2d_gemm_init(procmap_t *pi);
+gemm_blocking_t matrix2d_gemm_blocking(void);
+const char* matrix2d_gemm_kernel_name(void);
+
+void matrix2d_gemm(size_t m, size_t n, size_t k, double alpha,
+                   double **A, double **B, double beta, double **C);
+void matrix2d_gemm_naive(size_t m, size_t n, size_t k, double alpha,
+                         double **A, double **B, double beta, double **C);
+
+#endif
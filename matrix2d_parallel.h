@@ -0,0 +1,248 @@
+/**
+ * @file
+ * Multi-threaded, NUMA-aware versions of matrix2d.h operations.
+ *
+ * Rows are split into equal contiguous ranges, one per thread, and
+ * threads are pinned to cpus picked from the procmap_t so that
+ * consecutive threads alternate between packages. Allocation
+ * functions let every thread touch its own rows first, so that the
+ * pages of each range are placed on the node of the thread that will
+ * later work on it; using the same nthreads for allocation and for
+ * the operations keeps the accesses node-local.
+ */
+#ifndef MATRIX2D_PARALLEL_H_
+#define MATRIX2D_PARALLEL_H_
+
+#include <pthread.h>
+#include <sched.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "matrix2d.h"
+#include "matrix2d_gemm.h"
+#include "processor_map.h"
+
+/**
+ * Picks cpus for nthreads threads: first hardware thread of every
+ * core before any SMT sibling, alternating packages
+ * @param pi processor map
+ * @param nthreads number of threads
+ * @param cpus array of nthreads cpu ids, filled in (wraps around if
+ *        nthreads exceeds the number of cpus)
+ */
+inline void matrix2d_par_cpus(procmap_t *pi, int nthreads, int *cpus)
+{
+    int n = 0, total = pi->num_packages * pi->num_cores_per_package *
+                       pi->num_threads_per_core;
+
+    // hierarchy slots without a thread (uneven topologies) are skipped
+    if ( pi->package && total > 0 ) {
+        for ( int t = 0; t < pi->num_threads_per_core; t++ )
+            for ( int c = 0; c < pi->num_cores_per_package; c++ )
+                for ( int p = 0; p < pi->num_packages; p++ )
+                    if ( n < nthreads && pi->package[p].core[c].thread[t] )
+                        cpus[n++] = pi->package[p].core[c].thread[t]->cpu_id;
+    }
+
+    if ( n == 0 ) {
+        for ( int i = 0; i < nthreads; i++ )
+            cpus[i] = pi->num_cpus > 0 ?
+                      pi->flat_threads[i % pi->num_cpus].cpu_id : i;
+        return;
+    }
+
+    for ( int i = n; i < nthreads; i++ )
+        cpus[i] = cpus[i - n];
+}
+
+/**
+ * Range of rows owned by a thread
+ * @param nrows total rows
+ * @param tid thread index
+ * @param nthreads number of threads
+ * @param begin first row (inclusive)
+ * @param end last row (exclusive)
+ */
+inline void matrix2d_par_range(size_t nrows, int tid, int nthreads,
+                               size_t *begin, size_t *end)
+{
+    *begin = nrows * tid / nthreads;
+    *end = nrows * (tid + 1) / nthreads;
+}
+
+template <typename F>
+struct _matrix2d_par_arg {
+    F *f;
+    int tid;
+    size_t begin, end;
+};
+
+template <typename F>
+void* _matrix2d_par_fun(void *args)
+{
+    _matrix2d_par_arg<F> *a = static_cast<_matrix2d_par_arg<F>*>(args);
+    (*a->f)(a->tid, a->begin, a->end);
+    return NULL;
+}
+
+/**
+ * Runs f(tid, bounds[tid], bounds[tid+1]) on nthreads pinned threads;
+ * returns when all threads are done
+ * @param pi processor map
+ * @param nthreads number of threads
+ * @param bounds nthreads+1 range boundaries, non-decreasing
+ * @param f callable taking (int tid, size_t begin, size_t end)
+ */
+template <typename F>
+void matrix2d_parallel_ranges(procmap_t *pi, int nthreads,
+                              const size_t *bounds, F f)
+{
+    pthread_t *tids = new pthread_t [nthreads];
+    _matrix2d_par_arg<F> *args = new _matrix2d_par_arg<F> [nthreads];
+    int *cpus = new int [nthreads];
+
+    matrix2d_par_cpus(pi, nthreads, cpus);
+
+    for ( int t = 0; t < nthreads; t++ ) {
+        pthread_attr_t attr;
+        cpu_set_t set;
+
+        args[t].f = &f;
+        args[t].tid = t;
+        args[t].begin = bounds[t];
+        args[t].end = bounds[t + 1];
+
+        CPU_ZERO(&set);
+        CPU_SET(cpus[t], &set);
+        pthread_attr_init(&attr);
+        pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+        if ( pthread_create(&tids[t], &attr, _matrix2d_par_fun<F>, &args[t]) ) {
+            fprintf(stderr, "%s: could not create thread\n", __FUNCTION__);
+            exit(EXIT_FAILURE);
+        }
+        pthread_attr_destroy(&attr);
+    }
+    for ( int t = 0; t < nthreads; t++ )
+        pthread_join(tids[t], NULL);
+
+    delete [] cpus;
+    delete [] args;
+    delete [] tids;
+}
+
+/**
+ * Runs f(tid, begin, end) on nthreads pinned threads, each with its
+ * own range of rows (see matrix2d_par_range); returns when all
+ * threads are done
+ * @param pi processor map
+ * @param nthreads number of threads
+ * @param nrows rows to split
+ * @param f callable taking (int tid, size_t begin, size_t end)
+ */
+template <typename F>
+void matrix2d_parallel_rows(procmap_t *pi, int nthreads, size_t nrows, F f)
+{
+    size_t *bounds = new size_t [nthreads + 1];
+
+    for ( int t = 0; t < nthreads; t++ )
+        matrix2d_par_range(nrows, t, nthreads, &bounds[t], &bounds[t + 1]);
+    matrix2d_parallel_ranges(pi, nthreads, bounds, f);
+
+    delete [] bounds;
+}
+
+/**
+ * Allocate nrows x ncols matrix, each thread allocating and
+ * first-touching its own rows
+ * @return pointer to matrix (free with matrix2d_destroy)
+ */
+template <typename T>
+T** matrix2d_alloc_par(size_t nrows, size_t ncols, procmap_t *pi,
+                       int nthreads)
+{
+    T **m = new T* [nrows];
+
+    matrix2d_parallel_rows(pi, nthreads, nrows,
+        [=](int tid, size_t begin, size_t end) {
+            for ( size_t i = begin; i < end; i++ ) {
+                m[i] = new T [ncols];
+                memset(static_cast<void*>(m[i]), 0, ncols * sizeof(T));
+            }
+        });
+
+    return m;
+}
+
+/**
+ * Allocate contiguous nrows x ncols matrix (see matrix2d_alloc_contig),
+ * placing the pages of each thread's rows by first touch
+ * @return matrix (free with matrix2d_destroy_contig)
+ */
+template <typename T>
+matrix2d_t<T> matrix2d_alloc_contig_par(size_t nrows, size_t ncols,
+                                        procmap_t *pi, int nthreads,
+                                        size_t ld = 0)
+{
+    matrix2d_t<T> m = matrix2d_alloc_contig<T>(nrows, ncols, ld);
+
+    if ( !m.data )
+        return m;
+
+    matrix2d_parallel_rows(pi, nthreads, nrows,
+        [=](int tid, size_t begin, size_t end) {
+            if ( end > begin )
+                memset(static_cast<void*>(m.rows[begin]), 0,
+                       (end - begin) * m.ld * sizeof(T));
+        });
+
+    return m;
+}
+
+/**
+ * Parallel matrix2d_init; streams if the whole matrix reaches stream_threshold()
+ */
+template <typename T>
+void matrix2d_init_par(T** m, size_t nrows, size_t ncols, T val,
+                       procmap_t *pi, int nthreads)
+{
+    bool nt = stream_use_nt(nrows * ncols * sizeof(T));
+
+    matrix2d_parallel_rows(pi, nthreads, nrows,
+        [=](int tid, size_t begin, size_t end) {
+            _matrix2d_init_rows(m + begin, end - begin, ncols, val, nt);
+        });
+}
+
+/**
+ * Parallel matrix2d_copy; streams if the whole matrix reaches stream_threshold()
+ */
+template <typename T>
+void matrix2d_copy_par(T** s, T** t, size_t nrows, size_t ncols,
+                       procmap_t *pi, int nthreads)
+{
+    bool nt = stream_use_nt(nrows * ncols * sizeof(T));
+
+    matrix2d_parallel_rows(pi, nthreads, nrows,
+        [=](int tid, size_t begin, size_t end) {
+            _matrix2d_copy_rows(s + begin, t + begin, end - begin, ncols, nt);
+        });
+}
+
+/**
+ * Parallel matrix2d_gemm: every thread computes its range of rows
+ * of C (reading the matching rows of A and all of B)
+ */
+inline void matrix2d_gemm_par(size_t m, size_t n, size_t k, double alpha,
+                              double **A, double **B, double beta,
+                              double **C, procmap_t *pi, int nthreads)
+{
+    matrix2d_parallel_rows(pi, nthreads, m,
+        [=](int tid, size_t begin, size_t end) {
+            if ( end > begin )
+                matrix2d_gemm(end - begin, n, k, alpha, A + begin, B, beta,
+                              C + begin);
+        });
+}
+
+#endif
@@ -0,0 +1,217 @@
+/**
+ * @file
+ * Batch generators for matrix2d_random.h.
+ *
+ * The uniform generator is a plain loop over counters; it is compiled
+ * twice, once for the baseline ISA and once for AVX2 (four 64-bit
+ * lanes), and the variant is chosen at run time. The Box-Muller step
+ * of the normal generator is dispatched the same way: log, sin and cos
+ * are branch-free polynomial approximations (the fdlibm kernels, with
+ * the arguments reduced by bit manipulation) that the compiler can
+ * vectorize, where calls to std::log/std::sin/std::cos stay scalar.
+ */
+
+#include "matrix2d_random.h"
+
+#include <cmath>
+#include <cstring>
+
+//! Normal values generated per batch
+#define MATRIX2D_RNG_BATCH 256
+
+typedef void (*uniform_fn_t)(uint64_t key, uint64_t e0, size_t n,
+                             double lo, double scale, double *out);
+typedef void (*box_muller_fn_t)(size_t pairs, double mean, double stddev,
+                                double *u);
+
+static inline __attribute__((always_inline))
+void _uniform_body(uint64_t key, uint64_t e0, size_t n, double lo,
+                   double scale, double *out)
+{
+    // Top 52 bits as the mantissa of a double in [1, 2): avoids an
+    // integer to double conversion, which has no SIMD form before AVX-512
+    for ( size_t k = 0; k < n; k++ ) {
+        uint64_t z = matrix2d_rng_mix(key + (e0 + k + 1) * 0x9e3779b97f4a7c15ULL);
+        uint64_t bits = (z >> 12) | 0x3ff0000000000000ULL;
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        out[k] = lo + (d - 1.0) * scale;
+    }
+}
+
+static void _uniform_generic(uint64_t key, uint64_t e0, size_t n, double lo,
+                             double scale, double *out)
+{
+    _uniform_body(key, e0, n, lo, scale, out);
+}
+
+__attribute__((target("avx2")))
+static void _uniform_avx2(uint64_t key, uint64_t e0, size_t n, double lo,
+                          double scale, double *out)
+{
+    _uniform_body(key, e0, n, lo, scale, out);
+}
+
+static inline __attribute__((always_inline))
+double _as_double(uint64_t bits)
+{
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+static inline __attribute__((always_inline))
+uint64_t _as_bits(double d)
+{
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    return bits;
+}
+
+/**
+ * Natural log of a normal, positive x (fdlibm e_log.c kernel)
+ */
+static inline __attribute__((always_inline))
+double _log_poly(double x)
+{
+    const double Lg1 = 6.666666666666735130e-01, Lg2 = 3.999999999940941908e-01,
+                 Lg3 = 2.857142874366239149e-01, Lg4 = 2.222219843214978396e-01,
+                 Lg5 = 1.818357216161805012e-01, Lg6 = 1.531383769920937332e-01,
+                 Lg7 = 1.479819860511658591e-01;
+    // x = 2^e * m with m in [sqrt(2)/2, sqrt(2)), in integer ops only
+    // so that the loop has no branches: k is 1 if the mantissa is above
+    // that of sqrt(2) (carry out of the mantissa field), and the biased
+    // exponent becomes a double through the 2^52 trick (no int -> double
+    // conversion, see _uniform_body)
+    uint64_t bits = _as_bits(x), mant = bits & 0x000fffffffffffffULL;
+    uint64_t k = (mant + (0x0010000000000000ULL - 0x6a09e667f3bcdULL - 1)) >> 52;
+    double m = _as_double((mant | 0x3ff0000000000000ULL) - (k << 52));
+    double e = _as_double(((bits >> 52) + k) | 0x4330000000000000ULL) -
+               (4503599627370496.0 + 1023.0);
+
+    double f = m - 1.0, s = f / (2.0 + f), z = s * s, w = z * z;
+    double r = z * (Lg1 + w * (Lg3 + w * (Lg5 + w * Lg7))) +
+               w * (Lg2 + w * (Lg4 + w * Lg6));
+    double hfsq = 0.5 * f * f;
+    return e * M_LN2 + (f - (hfsq - s * (hfsq + r)));
+}
+
+/**
+ * sin and cos of 2*pi*v for v in [0, 1): v is split into a quarter
+ * turn q and a remainder of at most 1/8 turn, whose sin and cos are
+ * computed by the fdlibm k_sin.c/k_cos.c polynomials and then rotated
+ * by q
+ */
+static inline __attribute__((always_inline))
+void _sincos_turns(double v, double *sn, double *cs)
+{
+    const double S1 = -1.66666666666666324348e-01, S2 = 8.33333333332248946124e-03,
+                 S3 = -1.98412698298579493134e-04, S4 = 2.75573137070700676789e-06,
+                 S5 = -2.50507602534068634195e-08, S6 = 1.58969099521155010221e-10;
+    const double C1 = 4.16666666666666019037e-02, C2 = -1.38888888888741095749e-03,
+                 C3 = 2.48015872894767294178e-05, C4 = -2.75573143513906633035e-07,
+                 C5 = 2.08757232129817482790e-09, C6 = -1.13596475577881948265e-11;
+    // round(4v) by adding 1.5 * 2^52: q is in the low bits
+    double qd = 4.0 * v + 6755399441055744.0;
+    uint64_t q = _as_bits(qd);
+    double x = 2.0 * M_PI * (v - 0.25 * (qd - 6755399441055744.0));
+    double z = x * x;
+
+    double s = x + x * z * (S1 + z * (S2 + z * (S3 + z * (S4 + z * (S5 + z * S6)))));
+    double c = 1.0 - 0.5 * z +
+               z * z * (C1 + z * (C2 + z * (C3 + z * (C4 + z * (C5 + z * C6)))));
+    // odd quarter turns swap sin and cos, the sign bits are flipped
+    // for quarter turns 2, 3 (sin) and 1, 2 (cos)
+    uint64_t swap = -(q & 1), sb = _as_bits(s), cb = _as_bits(c);
+
+    *sn = _as_double(((sb & ~swap) | (cb & swap)) ^ ((q & 2) << 62));
+    *cs = _as_double(((cb & ~swap) | (sb & swap)) ^ (((q + 1) & 2) << 62));
+}
+
+static inline __attribute__((always_inline))
+void _box_muller_body(size_t pairs, double mean, double stddev, double *u)
+{
+    for ( size_t p = 0; p < pairs; p++ ) {
+        // 1 - u is in [2^-52, 1], so the log argument is never 0
+        double r = stddev * std::sqrt(-2.0 * _log_poly(1.0 - u[2 * p]));
+        double sn, cs;
+
+        _sincos_turns(u[2 * p + 1], &sn, &cs);
+        u[2 * p] = mean + r * cs;
+        u[2 * p + 1] = mean + r * sn;
+    }
+}
+
+static void _box_muller_generic(size_t pairs, double mean, double stddev,
+                                double *u)
+{
+    _box_muller_body(pairs, mean, stddev, u);
+}
+
+__attribute__((target("avx2")))
+static void _box_muller_avx2(size_t pairs, double mean, double stddev,
+                             double *u)
+{
+    _box_muller_body(pairs, mean, stddev, u);
+}
+
+static uniform_fn_t _select_uniform(void)
+{
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports("avx2") )
+        return _uniform_avx2;
+    return _uniform_generic;
+}
+
+static uniform_fn_t _uniform = _select_uniform();
+static box_muller_fn_t _box_muller =
+    _uniform == _uniform_avx2 ? _box_muller_avx2 : _box_muller_generic;
+
+/**
+ * @return name of the uniform generator in use
+ */
+const char* matrix2d_rng_kernel_name(void)
+{
+    return _uniform == _uniform_avx2 ? "avx2" : "generic";
+}
+
+/**
+ * Uniform doubles in [lo, hi) for counters e0 .. e0+n-1
+ * @param seed stream seed
+ * @param e0 first counter
+ * @param n number of values
+ * @param lo lower bound
+ * @param hi upper bound (exclusive)
+ * @param out n values, filled in
+ */
+void matrix2d_rng_uniform(uint64_t seed, uint64_t e0, size_t n,
+                          double lo, double hi, double *out)
+{
+    _uniform(matrix2d_rng_mix(seed), e0, n, lo, hi - lo, out);
+}
+
+/**
+ * Normal doubles (Box-Muller) for counters e0 .. e0+n-1; counters 2p
+ * and 2p+1 are computed from the uniforms of counters 2p and 2p+1
+ * @see matrix2d_rng_uniform
+ */
+void matrix2d_rng_normal(uint64_t seed, uint64_t e0, size_t n,
+                         double mean, double stddev, double *out)
+{
+    double u[MATRIX2D_RNG_BATCH + 2];
+    uint64_t key = matrix2d_rng_mix(seed), p0 = e0 & ~(uint64_t)1;
+
+    while ( n > 0 ) {
+        size_t skip = e0 - p0;
+        size_t m = n + skip < MATRIX2D_RNG_BATCH ? n + skip : MATRIX2D_RNG_BATCH;
+        size_t pairs = (m + 1) / 2;
+
+        _uniform(key, p0, 2 * pairs, 0.0, 1.0, u);
+        _box_muller(pairs, mean, stddev, u);
+        for ( size_t k = skip; k < m; k++ )
+            *out++ = u[k];
+
+        n -= m - skip;
+        e0 = p0 += m;
+    }
+}
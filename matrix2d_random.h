@@ -0,0 +1,111 @@
+/**
+ * @file
+ * Parallel, reproducible random initialization of double matrices.
+ *
+ * Element (i, j) of an nrows x ncols matrix gets the value derived
+ * from counter i*ncols + j alone, hashed with a seed (the splitmix64
+ * finalizer). There is no generator state: every thread can jump
+ * straight to its first row, and the result for a seed is the same
+ * whatever the number of threads. Values are produced in batches by
+ * branch-free loops, vectorized with AVX2 where available.
+ */
+#ifndef MATRIX2D_RANDOM_H_
+#define MATRIX2D_RANDOM_H_
+
+#include <stdint.h>
+#include <cstddef>
+
+#include "matrix2d_parallel.h"
+#include "processor_map.h"
+
+/**
+ * splitmix64 output function
+ */
+inline uint64_t matrix2d_rng_mix(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @return 64 random bits for counter 'ctr' of stream 'seed'
+ */
+inline uint64_t matrix2d_rng_u64(uint64_t seed, uint64_t ctr)
+{
+    return matrix2d_rng_mix(matrix2d_rng_mix(seed) +
+                            (ctr + 1) * 0x9e3779b97f4a7c15ULL);
+}
+
+void matrix2d_rng_uniform(uint64_t seed, uint64_t e0, size_t n,
+                          double lo, double hi, double *out);
+void matrix2d_rng_normal(uint64_t seed, uint64_t e0, size_t n,
+                         double mean, double stddev, double *out);
+const char* matrix2d_rng_kernel_name(void);
+
+/**
+ * Initialize matrix with uniform random values in [lo, hi)
+ * @param m pointer to matrix
+ * @param nrows num of rows
+ * @param ncols num of columns
+ * @param lo lower bound
+ * @param hi upper bound (exclusive)
+ * @param seed stream seed
+ */
+inline void matrix2d_init_random_uniform(double **m, size_t nrows,
+                                         size_t ncols, double lo, double hi,
+                                         uint64_t seed)
+{
+    for ( size_t i = 0; i < nrows; i++ )
+        matrix2d_rng_uniform(seed, (uint64_t)i * ncols, ncols, lo, hi, m[i]);
+}
+
+/**
+ * Initialize matrix with normal random values
+ * @see matrix2d_init_random_uniform
+ */
+inline void matrix2d_init_random_normal(double **m, size_t nrows,
+                                        size_t ncols, double mean,
+                                        double stddev, uint64_t seed)
+{
+    for ( size_t i = 0; i < nrows; i++ )
+        matrix2d_rng_normal(seed, (uint64_t)i * ncols, ncols, mean, stddev,
+                            m[i]);
+}
+
+/**
+ * Parallel matrix2d_init_random_uniform: every thread fills its own
+ * rows (the same ranges as matrix2d_alloc_par() and friends).
+ * The result does not depend on nthreads.
+ */
+inline void matrix2d_init_random_uniform_par(double **m, size_t nrows,
+                                             size_t ncols, double lo,
+                                             double hi, uint64_t seed,
+                                             procmap_t *pi, int nthreads)
+{
+    matrix2d_parallel_rows(pi, nthreads, nrows,
+        [=](int tid, size_t begin, size_t end) {
+            for ( size_t i = begin; i < end; i++ )
+                matrix2d_rng_uniform(seed, (uint64_t)i * ncols, ncols,
+                                     lo, hi, m[i]);
+        });
+}
+
+/**
+ * Parallel matrix2d_init_random_normal
+ * @see matrix2d_init_random_uniform_par
+ */
+inline void matrix2d_init_random_normal_par(double **m, size_t nrows,
+                                            size_t ncols, double mean,
+                                            double stddev, uint64_t seed,
+                                            procmap_t *pi, int nthreads)
+{
+    matrix2d_parallel_rows(pi, nthreads, nrows,
+        [=](int tid, size_t begin, size_t end) {
+            for ( size_t i = begin; i < end; i++ )
+                matrix2d_rng_normal(seed, (uint64_t)i * ncols, ncols,
+                                    mean, stddev, m[i]);
+        });
+}
+
+#endif
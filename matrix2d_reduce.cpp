@@ -0,0 +1,596 @@
+/**
+ * @file
+ * Reduction kernels for matrix2d_reduce.h.
+ *
+ * Every row kernel is written once as an always-inline body over
+ * MATRIX2D_REDUCE_LANES partial results and compiled twice, for the
+ * baseline ISA and for AVX2. Both variants do the same operations in
+ * the same order, so they give bitwise identical results.
+ */
+
+#include "matrix2d_reduce.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "matrix2d_parallel.h"
+
+#define LANES MATRIX2D_REDUCE_LANES
+
+//! Columns per block of the column reductions (partial sums stay in L1)
+#define COL_BLOCK 2048
+
+//! Elements per block of the min/max kernels
+#define ARG_BLOCK 256
+
+//! Four doubles, in one AVX or two SSE2 registers (GCC vector extension)
+typedef double vec4_t __attribute__((vector_size(32)));
+
+#define INLINE static inline __attribute__((always_inline))
+
+/**
+ * Pairwise sum of the lanes
+ */
+INLINE double _combine(double *acc)
+{
+    for ( int w = LANES / 2; w > 0; w /= 2 )
+        for ( int l = 0; l < w; l++ )
+            acc[l] += acc[l + w];
+    return acc[0];
+}
+
+INLINE double _sum_body(const double *a, size_t n)
+{
+    double acc[LANES] = { 0.0 }, s = 0.0;
+    size_t i = 0;
+
+    for ( ; i + LANES <= n; i += LANES )
+        for ( int l = 0; l < LANES; l++ )
+            acc[l] += a[i + l];
+    for ( ; i < n; i++ )
+        s += a[i];
+    return _combine(acc) + s;
+}
+
+INLINE double _sumsq_body(const double *a, size_t n)
+{
+    double acc[LANES] = { 0.0 }, s = 0.0;
+    size_t i = 0;
+
+    for ( ; i + LANES <= n; i += LANES )
+        for ( int l = 0; l < LANES; l++ )
+            acc[l] += a[i + l] * a[i + l];
+    for ( ; i < n; i++ )
+        s += a[i] * a[i];
+    return _combine(acc) + s;
+}
+
+INLINE double _asum_body(const double *a, size_t n)
+{
+    double acc[LANES] = { 0.0 }, s = 0.0;
+    size_t i = 0;
+
+    for ( ; i + LANES <= n; i += LANES )
+        for ( int l = 0; l < LANES; l++ )
+            acc[l] += std::fabs(a[i + l]);
+    for ( ; i < n; i++ )
+        s += std::fabs(a[i]);
+    return _combine(acc) + s;
+}
+
+INLINE double _dot_body(const double *a, const double *b, size_t n)
+{
+    double acc[LANES] = { 0.0 }, s = 0.0;
+    size_t i = 0;
+
+    for ( ; i + LANES <= n; i += LANES )
+        for ( int l = 0; l < LANES; l++ )
+            acc[l] += a[i + l] * b[i + l];
+    for ( ; i < n; i++ )
+        s += a[i] * b[i];
+    return _combine(acc) + s;
+}
+
+/**
+ * Position of the first minimum (or maximum) of a row; NaNs are
+ * skipped. Returns 0 with *val = +-inf if there is no number.
+ * Finds the best value of every ARG_BLOCK elements with SIMD lanes,
+ * remembers the first block that improves on the best so far, and
+ * rescans that block alone for the position.
+ */
+template <bool Max>
+INLINE size_t _arg_body(const double *a, size_t n, double *val)
+{
+    double best = Max ? -INFINITY : INFINITY;
+    size_t b0 = 0, b1 = 0;
+
+    for ( size_t i = 0; i < n; i += ARG_BLOCK ) {
+        size_t e = n - i < ARG_BLOCK ? n : i + ARG_BLOCK, k = i;
+        vec4_t v0 = { best, best, best, best }, v1 = v0, v2 = v0, v3 = v0;
+        double bv = best;
+
+        // Four vectors of four lanes
+        for ( ; k + 16 <= e; k += 16 ) {
+            vec4_t x0, x1, x2, x3;
+            memcpy(&x0, a + k, sizeof(x0));
+            memcpy(&x1, a + k + 4, sizeof(x1));
+            memcpy(&x2, a + k + 8, sizeof(x2));
+            memcpy(&x3, a + k + 12, sizeof(x3));
+            v0 = (Max ? x0 > v0 : x0 < v0) ? x0 : v0;
+            v1 = (Max ? x1 > v1 : x1 < v1) ? x1 : v1;
+            v2 = (Max ? x2 > v2 : x2 < v2) ? x2 : v2;
+            v3 = (Max ? x3 > v3 : x3 < v3) ? x3 : v3;
+        }
+        v0 = (Max ? v1 > v0 : v1 < v0) ? v1 : v0;
+        v2 = (Max ? v3 > v2 : v3 < v2) ? v3 : v2;
+        v0 = (Max ? v2 > v0 : v2 < v0) ? v2 : v0;
+        for ( int l = 0; l < 4; l++ )
+            bv = (Max ? v0[l] > bv : v0[l] < bv) ? v0[l] : bv;
+        for ( ; k < e; k++ )
+            bv = (Max ? a[k] > bv : a[k] < bv) ? a[k] : bv;
+
+        if ( Max ? bv > best : bv < best ) {
+            best = bv;
+            b0 = i;
+            b1 = e;
+        }
+    }
+
+    *val = best;
+    for ( size_t k = b0; k < b1; k++ )
+        if ( a[k] == best )
+            return k;
+    return 0;
+}
+
+INLINE void _acc_body(double * __restrict__ acc, const double *a, size_t n)
+{
+    for ( size_t i = 0; i < n; i++ )
+        acc[i] += a[i];
+}
+
+INLINE void _acc_abs_body(double * __restrict__ acc, const double *a,
+                          size_t n)
+{
+    for ( size_t i = 0; i < n; i++ )
+        acc[i] += std::fabs(a[i]);
+}
+
+typedef struct {
+    const char *name;
+    double (*sum)(const double *a, size_t n);
+    double (*sumsq)(const double *a, size_t n);
+    double (*asum)(const double *a, size_t n);
+    double (*dot)(const double *a, const double *b, size_t n);
+    size_t (*argmin)(const double *a, size_t n, double *val);
+    size_t (*argmax)(const double *a, size_t n, double *val);
+    void (*acc)(double *acc, const double *a, size_t n);
+    void (*acc_abs)(double *acc, const double *a, size_t n);
+} reduce_kernels_t;
+
+//! Instantiates the row kernels with the given function attributes
+#define REDUCE_KERNELS(var, attr, label)                                    \
+    attr static double var##_sum(const double *a, size_t n)                 \
+    { return _sum_body(a, n); }                                             \
+    attr static double var##_sumsq(const double *a, size_t n)               \
+    { return _sumsq_body(a, n); }                                           \
+    attr static double var##_asum(const double *a, size_t n)                \
+    { return _asum_body(a, n); }                                            \
+    attr static double var##_dot(const double *a, const double *b, size_t n)\
+    { return _dot_body(a, b, n); }                                          \
+    attr static size_t var##_argmin(const double *a, size_t n, double *v)   \
+    { return _arg_body<false>(a, n, v); }                                   \
+    attr static size_t var##_argmax(const double *a, size_t n, double *v)   \
+    { return _arg_body<true>(a, n, v); }                                    \
+    attr static void var##_acc(double *acc, const double *a, size_t n)      \
+    { _acc_body(acc, a, n); }                                               \
+    attr static void var##_acc_abs(double *acc, const double *a, size_t n)  \
+    { _acc_abs_body(acc, a, n); }                                           \
+    static const reduce_kernels_t var = {                                   \
+        label, var##_sum, var##_sumsq, var##_asum, var##_dot,               \
+        var##_argmin, var##_argmax, var##_acc, var##_acc_abs                \
+    };
+
+REDUCE_KERNELS(_generic, , "generic")
+REDUCE_KERNELS(_avx2, __attribute__((target("avx2"))), "avx2")
+
+static const reduce_kernels_t* _select_kernels(void)
+{
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports("avx2") )
+        return &_avx2;
+    return &_generic;
+}
+
+static const reduce_kernels_t *_k = _select_kernels();
+
+/**
+ * @return name of the row kernels in use
+ */
+const char* matrix2d_reduce_kernel_name(void)
+{
+    return _k->name;
+}
+
+/**
+ * Sum of f over rows
+ */
+static double _sum_rows(double **m, size_t nrows, size_t ncols,
+                        double (*f)(const double*, size_t))
+{
+    double s = 0.0;
+
+    for ( size_t i = 0; i < nrows; i++ )
+        s += f(m[i], ncols);
+    return s;
+}
+
+/**
+ * Maximum of f over rows (0 if there are none)
+ */
+static double _max_rows(double **m, size_t nrows, size_t ncols,
+                        double (*f)(const double*, size_t))
+{
+    double mx = 0.0;
+
+    for ( size_t i = 0; i < nrows; i++ )
+        mx = std::fmax(mx, f(m[i], ncols));
+    return mx;
+}
+
+typedef struct {
+    double val;
+    size_t row, col;
+} extremum_t;
+
+/**
+ * First minimum (or maximum) in row order over rows [0, nrows);
+ * row indices are offset by row0
+ */
+template <bool Max>
+static extremum_t _extremum_rows(double **m, size_t nrows, size_t ncols,
+                                 size_t row0)
+{
+    extremum_t e = { Max ? -INFINITY : INFINITY, 0, 0 };
+
+    for ( size_t i = 0; i < nrows; i++ ) {
+        double v;
+        size_t j = (Max ? _k->argmax : _k->argmin)(m[i], ncols, &v);
+
+        if ( Max ? v > e.val : v < e.val ) {
+            e.val = v;
+            e.row = row0 + i;
+            e.col = j;
+        }
+    }
+    return e;
+}
+
+/**
+ * Adds rows [0, nrows) into acc (zeroed here) with f, a block of
+ * columns at a time
+ */
+static void _col_rows(double **m, size_t nrows, size_t ncols, double *acc,
+                      void (*f)(double*, const double*, size_t))
+{
+    memset(acc, 0, ncols * sizeof(double));
+    for ( size_t c0 = 0; c0 < ncols; c0 += COL_BLOCK ) {
+        size_t w = ncols - c0 < COL_BLOCK ? ncols - c0 : COL_BLOCK;
+
+        for ( size_t i = 0; i < nrows; i++ )
+            f(acc + c0, m[i] + c0, w);
+    }
+}
+
+/**
+ * Sum of all elements
+ * @param m pointer to matrix
+ * @param nrows num of rows
+ * @param ncols num of columns
+ */
+double matrix2d_sum(double **m, size_t nrows, size_t ncols)
+{
+    return _sum_rows(m, nrows, ncols, _k->sum);
+}
+
+/**
+ * Sum of the squares of all elements
+ * @see matrix2d_sum
+ */
+double matrix2d_sumsq(double **m, size_t nrows, size_t ncols)
+{
+    return _sum_rows(m, nrows, ncols, _k->sumsq);
+}
+
+/**
+ * Frobenius norm, sqrt(matrix2d_sumsq()) (not scaled against overflow)
+ * @see matrix2d_sum
+ */
+double matrix2d_norm_fro(double **m, size_t nrows, size_t ncols)
+{
+    return std::sqrt(matrix2d_sumsq(m, nrows, ncols));
+}
+
+/**
+ * 1-norm, the largest column sum of absolute values
+ * @see matrix2d_sum
+ */
+double matrix2d_norm_1(double **m, size_t nrows, size_t ncols)
+{
+    double *acc = new double [ncols], mx = 0.0;
+
+    _col_rows(m, nrows, ncols, acc, _k->acc_abs);
+    for ( size_t j = 0; j < ncols; j++ )
+        mx = std::fmax(mx, acc[j]);
+
+    delete [] acc;
+    return mx;
+}
+
+/**
+ * Infinity norm, the largest row sum of absolute values
+ * @see matrix2d_sum
+ */
+double matrix2d_norm_inf(double **m, size_t nrows, size_t ncols)
+{
+    return _max_rows(m, nrows, ncols, _k->asum);
+}
+
+/**
+ * Smallest element, first in row-major order on ties; NaNs are skipped
+ * @param m pointer to matrix
+ * @param nrows num of rows
+ * @param ncols num of columns
+ * @param row its row, if not NULL
+ * @param col its column, if not NULL
+ */
+double matrix2d_min(double **m, size_t nrows, size_t ncols, size_t *row,
+                    size_t *col)
+{
+    extremum_t e = _extremum_rows<false>(m, nrows, ncols, 0);
+
+    if ( row )
+        *row = e.row;
+    if ( col )
+        *col = e.col;
+    return e.val;
+}
+
+/**
+ * Largest element
+ * @see matrix2d_min
+ */
+double matrix2d_max(double **m, size_t nrows, size_t ncols, size_t *row,
+                    size_t *col)
+{
+    extremum_t e = _extremum_rows<true>(m, nrows, ncols, 0);
+
+    if ( row )
+        *row = e.row;
+    if ( col )
+        *col = e.col;
+    return e.val;
+}
+
+/**
+ * Sum of every row
+ * @param m pointer to matrix
+ * @param nrows num of rows
+ * @param ncols num of columns
+ * @param out nrows sums, filled in
+ */
+void matrix2d_row_sums(double **m, size_t nrows, size_t ncols, double *out)
+{
+    for ( size_t i = 0; i < nrows; i++ )
+        out[i] = _k->sum(m[i], ncols);
+}
+
+/**
+ * Sum of every column, in one pass over the rows
+ * @param m pointer to matrix
+ * @param nrows num of rows
+ * @param ncols num of columns
+ * @param out ncols sums, filled in
+ */
+void matrix2d_col_sums(double **m, size_t nrows, size_t ncols, double *out)
+{
+    _col_rows(m, nrows, ncols, out, _k->acc);
+}
+
+/**
+ * Dot product of every pair of rows: out[i] = a[i] . b[i]
+ * @param a pointer to matrix
+ * @param b pointer to matrix of the same size
+ * @param nrows num of rows
+ * @param ncols num of columns
+ * @param out nrows dot products, filled in
+ */
+void matrix2d_row_dots(double **a, double **b, size_t nrows, size_t ncols,
+                       double *out)
+{
+    for ( size_t i = 0; i < nrows; i++ )
+        out[i] = _k->dot(a[i], b[i], ncols);
+}
+
+/**
+ * Per-thread results of f over row ranges, summed in thread order
+ */
+static double _sum_par(double **m, size_t nrows, size_t ncols, procmap_t *pi,
+                       int nthreads, double (*f)(const double*, size_t))
+{
+    double *part = new double [nthreads], s = 0.0;
+
+    matrix2d_parallel_rows(pi, nthreads, nrows,
+        [=](int tid, size_t begin, size_t end) {
+            part[tid] = _sum_rows(m + begin, end - begin, ncols, f);
+        });
+    for ( int t = 0; t < nthreads; t++ )
+        s += part[t];
+
+    delete [] part;
+    return s;
+}
+
+/**
+ * Parallel matrix2d_sum
+ * @param pi processor map
+ * @param nthreads number of threads
+ */
+double matrix2d_sum_par(double **m, size_t nrows, size_t ncols,
+                        procmap_t *pi, int nthreads)
+{
+    return _sum_par(m, nrows, ncols, pi, nthreads, _k->sum);
+}
+
+/**
+ * Parallel matrix2d_sumsq
+ */
+double matrix2d_sumsq_par(double **m, size_t nrows, size_t ncols,
+                          procmap_t *pi, int nthreads)
+{
+    return _sum_par(m, nrows, ncols, pi, nthreads, _k->sumsq);
+}
+
+/**
+ * Parallel matrix2d_norm_fro
+ */
+double matrix2d_norm_fro_par(double **m, size_t nrows, size_t ncols,
+                             procmap_t *pi, int nthreads)
+{
+    return std::sqrt(matrix2d_sumsq_par(m, nrows, ncols, pi, nthreads));
+}
+
+/**
+ * Parallel matrix2d_norm_1: every thread sums its rows into its own
+ * vector of column sums
+ */
+double matrix2d_norm_1_par(double **m, size_t nrows, size_t ncols,
+                           procmap_t *pi, int nthreads)
+{
+    double *part = new double [(size_t)nthreads * ncols], mx = 0.0;
+
+    matrix2d_parallel_rows(pi, nthreads, nrows,
+        [=](int tid, size_t begin, size_t end) {
+            _col_rows(m + begin, end - begin, ncols,
+                      part + (size_t)tid * ncols, _k->acc_abs);
+        });
+    for ( int t = 1; t < nthreads; t++ )
+        _k->acc(part, part + (size_t)t * ncols, ncols);
+    for ( size_t j = 0; j < ncols; j++ )
+        mx = std::fmax(mx, part[j]);
+
+    delete [] part;
+    return mx;
+}
+
+/**
+ * Parallel matrix2d_norm_inf
+ */
+double matrix2d_norm_inf_par(double **m, size_t nrows, size_t ncols,
+                             procmap_t *pi, int nthreads)
+{
+    double *part = new double [nthreads], mx = 0.0;
+
+    matrix2d_parallel_rows(pi, nthreads, nrows,
+        [=](int tid, size_t begin, size_t end) {
+            part[tid] = _max_rows(m + begin, end - begin, ncols, _k->asum);
+        });
+    for ( int t = 0; t < nthreads; t++ )
+        mx = std::fmax(mx, part[t]);
+
+    delete [] part;
+    return mx;
+}
+
+template <bool Max>
+static double _extremum_par(double **m, size_t nrows, size_t ncols,
+                            size_t *row, size_t *col, procmap_t *pi,
+                            int nthreads)
+{
+    extremum_t *part = new extremum_t [nthreads], e;
+
+    matrix2d_parallel_rows(pi, nthreads, nrows,
+        [=](int tid, size_t begin, size_t end) {
+            part[tid] = _extremum_rows<Max>(m + begin, end - begin, ncols,
+                                            begin);
+        });
+    // Threads own increasing rows: strict comparison keeps the first
+    e = part[0];
+    for ( int t = 1; t < nthreads; t++ )
+        if ( Max ? part[t].val > e.val : part[t].val < e.val )
+            e = part[t];
+    if ( row )
+        *row = e.row;
+    if ( col )
+        *col = e.col;
+
+    delete [] part;
+    return e.val;
+}
+
+/**
+ * Parallel matrix2d_min
+ */
+double matrix2d_min_par(double **m, size_t nrows, size_t ncols,
+                        size_t *row, size_t *col, procmap_t *pi,
+                        int nthreads)
+{
+    return _extremum_par<false>(m, nrows, ncols, row, col, pi, nthreads);
+}
+
+/**
+ * Parallel matrix2d_max
+ */
+double matrix2d_max_par(double **m, size_t nrows, size_t ncols,
+                        size_t *row, size_t *col, procmap_t *pi,
+                        int nthreads)
+{
+    return _extremum_par<true>(m, nrows, ncols, row, col, pi, nthreads);
+}
+
+/**
+ * Parallel matrix2d_row_sums
+ */
+void matrix2d_row_sums_par(double **m, size_t nrows, size_t ncols,
+                           double *out, procmap_t *pi, int nthreads)
+{
+    matrix2d_parallel_rows(pi, nthreads, nrows,
+        [=](int tid, size_t begin, size_t end) {
+            matrix2d_row_sums(m + begin, end - begin, ncols, out + begin);
+        });
+}
+
+/**
+ * Parallel matrix2d_col_sums: every thread sums its rows into its own
+ * vector, the vectors are added in thread order
+ */
+void matrix2d_col_sums_par(double **m, size_t nrows, size_t ncols,
+                           double *out, procmap_t *pi, int nthreads)
+{
+    double *part = new double [(size_t)nthreads * ncols];
+
+    matrix2d_parallel_rows(pi, nthreads, nrows,
+        [=](int tid, size_t begin, size_t end) {
+            _col_rows(m + begin, end - begin, ncols,
+                      part + (size_t)tid * ncols, _k->acc);
+        });
+    memcpy(out, part, ncols * sizeof(double));
+    for ( int t = 1; t < nthreads; t++ )
+        _k->acc(out, part + (size_t)t * ncols, ncols);
+
+    delete [] part;
+}
+
+/**
+ * Parallel matrix2d_row_dots
+ */
+void matrix2d_row_dots_par(double **a, double **b, size_t nrows,
+                           size_t ncols, double *out, procmap_t *pi,
+                           int nthreads)
+{
+    matrix2d_parallel_rows(pi, nthreads, nrows,
+        [=](int tid, size_t begin, size_t end) {
+            matrix2d_row_dots(a + begin, b + begin, end - begin, ncols,
+                              out + begin);
+        });
+}
@@ -0,0 +1,66 @@
+/**
+ * @file
+ * Reductions over double matrices from matrix2d.h: sums, sums of
+ * squares, norms, min/max with position, per-row sums and dot products,
+ * and column sums.
+ *
+ * Row kernels keep MATRIX2D_REDUCE_LANES independent partial results,
+ * which the compiler maps to SIMD registers, so floating point sums
+ * vectorise without -ffast-math; they are built for the baseline ISA
+ * and for AVX2 and chosen at run time. Column reductions add whole rows
+ * into a vector of partial results instead of walking down columns.
+ * The _par versions split rows across pinned threads (see
+ * matrix2d_parallel.h) and combine the per-thread results in thread
+ * order, so they are deterministic for a given nthreads.
+ */
+#ifndef MATRIX2D_REDUCE_H_
+#define MATRIX2D_REDUCE_H_
+
+#include <cstddef>
+
+#include "processor_map.h"
+
+//! Independent partial results per row kernel
+#define MATRIX2D_REDUCE_LANES 16
+
+const char* matrix2d_reduce_kernel_name(void);
+
+double matrix2d_sum(double **m, size_t nrows, size_t ncols);
+double matrix2d_sumsq(double **m, size_t nrows, size_t ncols);
+double matrix2d_norm_fro(double **m, size_t nrows, size_t ncols);
+double matrix2d_norm_1(double **m, size_t nrows, size_t ncols);
+double matrix2d_norm_inf(double **m, size_t nrows, size_t ncols);
+double matrix2d_min(double **m, size_t nrows, size_t ncols, size_t *row,
+                    size_t *col);
+double matrix2d_max(double **m, size_t nrows, size_t ncols, size_t *row,
+                    size_t *col);
+void matrix2d_row_sums(double **m, size_t nrows, size_t ncols, double *out);
+void matrix2d_col_sums(double **m, size_t nrows, size_t ncols, double *out);
+void matrix2d_row_dots(double **a, double **b, size_t nrows, size_t ncols,
+                       double *out);
+
+double matrix2d_sum_par(double **m, size_t nrows, size_t ncols,
+                        procmap_t *pi, int nthreads);
+double matrix2d_sumsq_par(double **m, size_t nrows, size_t ncols,
+                          procmap_t *pi, int nthreads);
+double matrix2d_norm_fro_par(double **m, size_t nrows, size_t ncols,
+                             procmap_t *pi, int nthreads);
+double matrix2d_norm_1_par(double **m, size_t nrows, size_t ncols,
+                           procmap_t *pi, int nthreads);
+double matrix2d_norm_inf_par(double **m, size_t nrows, size_t ncols,
+                             procmap_t *pi, int nthreads);
+double matrix2d_min_par(double **m, size_t nrows, size_t ncols,
+                        size_t *row, size_t *col, procmap_t *pi,
+                        int nthreads);
+double matrix2d_max_par(double **m, size_t nrows, size_t ncols,
+                        size_t *row, size_t *col, procmap_t *pi,
+                        int nthreads);
+void matrix2d_row_sums_par(double **m, size_t nrows, size_t ncols,
+                           double *out, procmap_t *pi, int nthreads);
+void matrix2d_col_sums_par(double **m, size_t nrows, size_t ncols,
+                           double *out, procmap_t *pi, int nthreads);
+void matrix2d_row_dots_par(double **a, double **b, size_t nrows,
+                           size_t ncols, double *out, procmap_t *pi,
+                           int nthreads);
+
+#endif
@@ -0,0 +1,389 @@
+/**
+ * @file
+ * Compressed sparse row (CSR) and column (CSC) matrices.
+ *
+ * Both formats share one layout: for every outer index (row for CSR,
+ * column for CSC) 'ptr' gives the range of its nonzeros in 'idx'
+ * (inner index, sorted) and 'val'. Parallel kernels split rows so that
+ * every thread gets about the same number of nonzeros, not the same
+ * number of rows; with skewed row lengths an equal-row split leaves
+ * most threads idle.
+ */
+#ifndef MATRIX2D_SPARSE_H_
+#define MATRIX2D_SPARSE_H_
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
+#include "matrix2d.h"
+#include "matrix2d_parallel.h"
+#include "processor_map.h"
+
+/**
+ * Compressed sparse matrix
+ */
+template <typename T>
+struct matrix2d_sparse_t {
+    size_t nrows;
+    size_t ncols;
+    size_t nnz;
+    size_t *ptr;  //!< nouter+1 offsets into idx/val
+    size_t *idx;  //!< inner index of every nonzero
+    T *val;       //!< value of every nonzero
+};
+
+//! CSR: outer index is the row
+template <typename T>
+struct matrix2d_csr_t : matrix2d_sparse_t<T> {};
+
+//! CSC: outer index is the column
+template <typename T>
+struct matrix2d_csc_t : matrix2d_sparse_t<T> {};
+
+template <typename T>
+void _matrix2d_sparse_alloc(matrix2d_sparse_t<T>& s, size_t nouter,
+                            size_t nnz)
+{
+    s.nnz = nnz;
+    s.ptr = new size_t [nouter + 1];
+    s.idx = new size_t [nnz];
+    s.val = new T [nnz];
+}
+
+/**
+ * Builds the compressed layout from coordinate triples, sorting every
+ * outer slice by inner index and summing duplicates
+ */
+template <typename T>
+void _matrix2d_compress(matrix2d_sparse_t<T>& s, size_t nouter, size_t nnz,
+                        const size_t *outer, const size_t *inner,
+                        const T *v)
+{
+    size_t *pos = new size_t [nouter + 1]();
+    std::pair<size_t, T> *tmp = new std::pair<size_t, T> [nnz];
+    size_t n = 0;
+
+    // Counting sort by outer index
+    for ( size_t e = 0; e < nnz; e++ )
+        pos[outer[e] + 1]++;
+    for ( size_t o = 0; o < nouter; o++ )
+        pos[o + 1] += pos[o];
+    for ( size_t e = 0; e < nnz; e++ )
+        tmp[pos[outer[e]]++] = std::make_pair(inner[e], v[e]);
+    // pos[o] now holds the end of slice o
+
+    _matrix2d_sparse_alloc(s, nouter, nnz);
+    s.ptr[0] = 0;
+    for ( size_t o = 0, begin = 0; o < nouter; o++ ) {
+        size_t end = pos[o];
+
+        std::sort(tmp + begin, tmp + end,
+                  [](const std::pair<size_t, T>& a,
+                     const std::pair<size_t, T>& b) {
+                      return a.first < b.first;
+                  });
+        for ( size_t e = begin; e < end; e++ ) {
+            if ( n > s.ptr[o] && s.idx[n - 1] == tmp[e].first ) {
+                s.val[n - 1] += tmp[e].second;
+            } else {
+                s.idx[n] = tmp[e].first;
+                s.val[n] = tmp[e].second;
+                n++;
+            }
+        }
+        s.ptr[o + 1] = n;
+        begin = end;
+    }
+    s.nnz = n;
+
+    delete [] tmp;
+    delete [] pos;
+}
+
+/**
+ * Build CSR matrix from coordinate triples (any order; duplicates
+ * are summed)
+ * @param nrows num of rows
+ * @param ncols num of columns
+ * @param nnz num of triples
+ * @param ri row index of every triple
+ * @param ci column index of every triple
+ * @param v value of every triple
+ * @return matrix (free with matrix2d_sparse_destroy)
+ */
+template <typename T>
+matrix2d_csr_t<T> matrix2d_csr_from_coo(size_t nrows, size_t ncols,
+                                        size_t nnz, const size_t *ri,
+                                        const size_t *ci, const T *v)
+{
+    matrix2d_csr_t<T> a;
+
+    a.nrows = nrows;
+    a.ncols = ncols;
+    _matrix2d_compress(a, nrows, nnz, ri, ci, v);
+    return a;
+}
+
+/**
+ * Build CSC matrix from coordinate triples (any order; duplicates
+ * are summed)
+ * @see matrix2d_csr_from_coo
+ */
+template <typename T>
+matrix2d_csc_t<T> matrix2d_csc_from_coo(size_t nrows, size_t ncols,
+                                        size_t nnz, const size_t *ri,
+                                        const size_t *ci, const T *v)
+{
+    matrix2d_csc_t<T> a;
+
+    a.nrows = nrows;
+    a.ncols = ncols;
+    _matrix2d_compress(a, ncols, nnz, ci, ri, v);
+    return a;
+}
+
+/**
+ * Build CSR matrix from the nonzero elements of a dense matrix
+ * @param m pointer to matrix
+ * @param nrows num of rows
+ * @param ncols num of columns
+ * @return matrix (free with matrix2d_sparse_destroy)
+ */
+template <typename T>
+matrix2d_csr_t<T> matrix2d_csr_from_dense(T** m, size_t nrows, size_t ncols)
+{
+    matrix2d_csr_t<T> a;
+    size_t nnz = 0, n = 0;
+
+    for ( size_t i = 0; i < nrows; i++ )
+        for ( size_t j = 0; j < ncols; j++ )
+            nnz += m[i][j] != T(0);
+
+    a.nrows = nrows;
+    a.ncols = ncols;
+    _matrix2d_sparse_alloc(a, nrows, nnz);
+    a.ptr[0] = 0;
+    for ( size_t i = 0; i < nrows; i++ ) {
+        for ( size_t j = 0; j < ncols; j++ ) {
+            if ( m[i][j] != T(0) ) {
+                a.idx[n] = j;
+                a.val[n] = m[i][j];
+                n++;
+            }
+        }
+        a.ptr[i + 1] = n;
+    }
+    return a;
+}
+
+/**
+ * Build CSC matrix from the nonzero elements of a dense matrix
+ * @see matrix2d_csr_from_dense
+ */
+template <typename T>
+matrix2d_csc_t<T> matrix2d_csc_from_dense(T** m, size_t nrows, size_t ncols)
+{
+    matrix2d_csc_t<T> a;
+    size_t nnz = 0, n = 0;
+
+    for ( size_t i = 0; i < nrows; i++ )
+        for ( size_t j = 0; j < ncols; j++ )
+            nnz += m[i][j] != T(0);
+
+    a.nrows = nrows;
+    a.ncols = ncols;
+    _matrix2d_sparse_alloc(a, ncols, nnz);
+    a.ptr[0] = 0;
+    for ( size_t j = 0; j < ncols; j++ ) {
+        for ( size_t i = 0; i < nrows; i++ ) {
+            if ( m[i][j] != T(0) ) {
+                a.idx[n] = i;
+                a.val[n] = m[i][j];
+                n++;
+            }
+        }
+        a.ptr[j + 1] = n;
+    }
+    return a;
+}
+
+/**
+ * Convert CSR to CSC (same matrix, other layout)
+ */
+template <typename T>
+matrix2d_csc_t<T> matrix2d_csr_to_csc(const matrix2d_csr_t<T>& a)
+{
+    matrix2d_csc_t<T> c;
+    size_t *pos = new size_t [a.ncols + 1]();
+
+    c.nrows = a.nrows;
+    c.ncols = a.ncols;
+    _matrix2d_sparse_alloc(c, a.ncols, a.nnz);
+
+    for ( size_t e = 0; e < a.nnz; e++ )
+        pos[a.idx[e] + 1]++;
+    for ( size_t j = 0; j < a.ncols; j++ )
+        pos[j + 1] += pos[j];
+    std::copy(pos, pos + a.ncols + 1, c.ptr);
+
+    // Rows are visited in order, so every column comes out sorted
+    for ( size_t i = 0; i < a.nrows; i++ )
+        for ( size_t e = a.ptr[i]; e < a.ptr[i + 1]; e++ ) {
+            size_t d = pos[a.idx[e]]++;
+            c.idx[d] = i;
+            c.val[d] = a.val[e];
+        }
+
+    delete [] pos;
+    return c;
+}
+
+/**
+ * Deallocate sparse matrix
+ */
+template <typename T>
+void matrix2d_sparse_destroy(matrix2d_sparse_t<T>& s)
+{
+    delete [] s.ptr;
+    delete [] s.idx;
+    delete [] s.val;
+    s.ptr = s.idx = NULL;
+    s.val = NULL;
+}
+
+/**
+ * Splits the rows of a into nthreads ranges of about nnz/nthreads
+ * nonzeros each
+ * @param a matrix
+ * @param nthreads number of ranges
+ * @param bounds nthreads+1 row boundaries, filled in
+ */
+template <typename T>
+void matrix2d_csr_partition(const matrix2d_csr_t<T>& a, int nthreads,
+                            size_t *bounds)
+{
+    bounds[0] = 0;
+    for ( int t = 1; t < nthreads; t++ ) {
+        size_t target = a.nnz * t / nthreads;
+        bounds[t] = std::lower_bound(a.ptr, a.ptr + a.nrows + 1, target) -
+                    a.ptr;
+        if ( bounds[t] < bounds[t - 1] )
+            bounds[t] = bounds[t - 1];
+    }
+    bounds[nthreads] = a.nrows;
+}
+
+template <typename T>
+void _matrix2d_csr_spmv_rows(const matrix2d_csr_t<T>& a, const T *x, T *y,
+                             size_t begin, size_t end)
+{
+    const size_t *ptr = a.ptr, *idx = a.idx;
+    const T *val = a.val;
+
+    for ( size_t i = begin; i < end; i++ ) {
+        T sum = T(0);
+        for ( size_t e = ptr[i]; e < ptr[i + 1]; e++ )
+            sum += val[e] * x[idx[e]];
+        y[i] = sum;
+    }
+}
+
+/**
+ * y = A * x
+ * @param a nrows x ncols matrix
+ * @param x vector of ncols elements
+ * @param y vector of nrows elements, overwritten
+ */
+template <typename T>
+void matrix2d_csr_spmv(const matrix2d_csr_t<T>& a, const T *x, T *y)
+{
+    _matrix2d_csr_spmv_rows(a, x, y, 0, a.nrows);
+}
+
+/**
+ * y = A * x, rows split across threads by nonzeros
+ * @see matrix2d_csr_spmv, matrix2d_csr_partition
+ */
+template <typename T>
+void matrix2d_csr_spmv_par(const matrix2d_csr_t<T>& a, const T *x, T *y,
+                           procmap_t *pi, int nthreads)
+{
+    size_t *bounds = new size_t [nthreads + 1];
+
+    matrix2d_csr_partition(a, nthreads, bounds);
+    matrix2d_parallel_ranges(pi, nthreads, bounds,
+        [&](int tid, size_t begin, size_t end) {
+            _matrix2d_csr_spmv_rows(a, x, y, begin, end);
+        });
+
+    delete [] bounds;
+}
+
+/**
+ * y = A * x for a CSC matrix (scatters into y, single thread)
+ * @see matrix2d_csr_spmv
+ */
+template <typename T>
+void matrix2d_csc_spmv(const matrix2d_csc_t<T>& a, const T *x, T *y)
+{
+    for ( size_t i = 0; i < a.nrows; i++ )
+        y[i] = T(0);
+    for ( size_t j = 0; j < a.ncols; j++ ) {
+        T xj = x[j];
+        for ( size_t e = a.ptr[j]; e < a.ptr[j + 1]; e++ )
+            y[a.idx[e]] += a.val[e] * xj;
+    }
+}
+
+template <typename T>
+void _matrix2d_csr_spmm_rows(const matrix2d_csr_t<T>& a, T** b, T** c,
+                             size_t n, size_t begin, size_t end)
+{
+    for ( size_t i = begin; i < end; i++ ) {
+        T *ci = c[i];
+        for ( size_t j = 0; j < n; j++ )
+            ci[j] = T(0);
+        for ( size_t e = a.ptr[i]; e < a.ptr[i + 1]; e++ ) {
+            const T *bk = b[a.idx[e]];
+            T v = a.val[e];
+            for ( size_t j = 0; j < n; j++ )
+                ci[j] += v * bk[j];
+        }
+    }
+}
+
+/**
+ * C = A * B with dense B and C
+ * @param a m x k matrix
+ * @param b k x n dense matrix
+ * @param c m x n dense matrix, overwritten
+ * @param n columns of b and c
+ */
+template <typename T>
+void matrix2d_csr_spmm(const matrix2d_csr_t<T>& a, T** b, T** c, size_t n)
+{
+    _matrix2d_csr_spmm_rows(a, b, c, n, 0, a.nrows);
+}
+
+/**
+ * C = A * B, rows split across threads by nonzeros
+ * @see matrix2d_csr_spmm, matrix2d_csr_partition
+ */
+template <typename T>
+void matrix2d_csr_spmm_par(const matrix2d_csr_t<T>& a, T** b, T** c,
+                           size_t n, procmap_t *pi, int nthreads)
+{
+    size_t *bounds = new size_t [nthreads + 1];
+
+    matrix2d_csr_partition(a, nthreads, bounds);
+    matrix2d_parallel_ranges(pi, nthreads, bounds,
+        [&](int tid, size_t begin, size_t end) {
+            _matrix2d_csr_spmm_rows(a, b, c, n, begin, end);
+        });
+
+    delete [] bounds;
+}
+
+#endif
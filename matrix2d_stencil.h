@@ -0,0 +1,240 @@
+/**
+ * @file
+ * Iterative 2D stencils (radius 1) with temporal blocking.
+ *
+ * A naive sweep streams the whole grid through memory on every time
+ * step. matrix2d_stencil() instead cuts the grid into tiles and
+ * advances each tile by several time steps while it is in cache,
+ * using overlapped tiling: a tile is loaded together with a halo as
+ * wide as the number of steps, the valid region shrinks by one cell
+ * per step, and only the tile itself is written back. Halo cells are
+ * computed redundantly by neighbouring tiles, so tiles need no
+ * synchronisation; threads only meet between blocks of time steps.
+ *
+ * The kernel is any callable k(n, c, s, j) returning the new value of
+ * column j of row c, given the row above (n) and below (s). Outer
+ * rows and columns are fixed (Dirichlet boundary).
+ */
+#ifndef MATRIX2D_STENCIL_H_
+#define MATRIX2D_STENCIL_H_
+
+#include <pthread.h>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+
+#include "matrix2d.h"
+#include "matrix2d_parallel.h"
+#include "processor_map.h"
+
+//! Default tile height, in rows
+#define MATRIX2D_STENCIL_TILE_ROWS 64
+
+//! Default tile width, in elements
+#define MATRIX2D_STENCIL_TILE_COLS 512
+
+//! Default number of time steps per tile
+#define MATRIX2D_STENCIL_TSTEPS 8
+
+/**
+ * 5-point stencil: c0*center + c1*(north + south + west + east)
+ */
+template <typename T>
+struct matrix2d_stencil5 {
+    T c0, c1;
+
+    T operator()(const T *n, const T *c, const T *s, size_t j) const
+    {
+        return c0 * c[j] + c1 * (n[j] + s[j] + c[j - 1] + c[j + 1]);
+    }
+};
+
+/**
+ * 9-point stencil: c0*center + c1*(edge neighbours) + c2*(corners)
+ */
+template <typename T>
+struct matrix2d_stencil9 {
+    T c0, c1, c2;
+
+    T operator()(const T *n, const T *c, const T *s, size_t j) const
+    {
+        return c0 * c[j] + c1 * (n[j] + s[j] + c[j - 1] + c[j + 1]) +
+               c2 * (n[j - 1] + n[j + 1] + s[j - 1] + s[j + 1]);
+    }
+};
+
+/**
+ * One time step over rows [r0, r1) and columns [c0, c1) of src, into dst
+ */
+template <typename T, typename K>
+inline void _matrix2d_stencil_step(T **src, T **dst, size_t r0, size_t r1,
+                                   size_t c0, size_t c1, const K& k)
+{
+    K kl = k;   // local copy, known not to alias dst
+
+    for ( size_t i = r0; i < r1; i++ ) {
+        const T *n = src[i - 1], *c = src[i], *s = src[i + 1];
+        T * __restrict__ d = dst[i];
+
+        for ( size_t j = c0; j < c1; j++ )
+            d[j] = kl(n, c, s, j);
+    }
+}
+
+/**
+ * Copies the outer rows and columns of a into b
+ */
+template <typename T>
+void _matrix2d_stencil_boundary(T **a, T **b, size_t nrows, size_t ncols)
+{
+    memcpy(b[0], a[0], ncols * sizeof(T));
+    memcpy(b[nrows - 1], a[nrows - 1], ncols * sizeof(T));
+    for ( size_t i = 1; i < nrows - 1; i++ ) {
+        b[i][0] = a[i][0];
+        b[i][ncols - 1] = a[i][ncols - 1];
+    }
+}
+
+/**
+ * Naive sweeps, one pass over the grid per time step
+ * @param a nrows x ncols grid, initial values
+ * @param b nrows x ncols grid, scratch (its boundary is overwritten
+ *        with that of a)
+ * @param nrows num of rows (at least 3)
+ * @param ncols num of columns (at least 3)
+ * @param nsteps time steps
+ * @param k stencil kernel
+ * @return a or b, whichever holds the result
+ */
+template <typename T, typename K>
+T** matrix2d_stencil_naive(T **a, T **b, size_t nrows, size_t ncols,
+                           int nsteps, K k)
+{
+    _matrix2d_stencil_boundary(a, b, nrows, ncols);
+    for ( int t = 0; t < nsteps; t++ ) {
+        _matrix2d_stencil_step(a, b, 1, nrows - 1, 1, ncols - 1, k);
+        std::swap(a, b);
+    }
+    return a;
+}
+
+/**
+ * Advances the tile [i0, i1) x [j0, j1) of src by ts time steps into
+ * dst. The first step reads src and the last one writes dst; steps in
+ * between go through the local buffers buf[0], buf[1], with row
+ * pointers in l[0..3].
+ */
+template <typename T, typename K>
+void _matrix2d_stencil_tile(T **src, T **dst, size_t nrows, size_t ncols,
+                            size_t i0, size_t i1, size_t j0, size_t j1,
+                            int ts, T **l[4], T *buf[2], const K& k)
+{
+    size_t h = ts;
+    size_t gr0 = i0 > h ? i0 - h : 0, gr1 = i1 + h < nrows ? i1 + h : nrows;
+    size_t gc0 = j0 > h ? j0 - h : 0, gc1 = j1 + h < ncols ? j1 + h : ncols;
+    size_t lw = gc1 - gc0;
+    T **in = l[2], **out = l[3];
+
+    for ( size_t i = gr0; i < gr1; i++ ) {
+        l[0][i - gr0] = buf[0] + (i - gr0) * lw;
+        l[1][i - gr0] = buf[1] + (i - gr0) * lw;
+        l[2][i - gr0] = src[i] + gc0;
+        l[3][i - gr0] = dst[i] + gc0;
+    }
+
+    // Fixed boundary cells inside the halo, read by steps after the first
+    if ( ts > 1 ) {
+        for ( int b = 0; b < 2; b++ ) {
+            if ( gr0 == 0 )
+                memcpy(l[b][0], in[0], lw * sizeof(T));
+            if ( gr1 == nrows )
+                memcpy(l[b][gr1 - 1 - gr0], in[gr1 - 1 - gr0], lw * sizeof(T));
+            for ( size_t i = 0; i < gr1 - gr0; i++ ) {
+                if ( gc0 == 0 )
+                    l[b][i][0] = in[i][0];
+                if ( gc1 == ncols )
+                    l[b][i][lw - 1] = in[i][lw - 1];
+            }
+        }
+    }
+
+    // Step s is valid on the tile grown by ts-1-s cells, minus the
+    // fixed boundary
+    for ( int s = 0; s < ts; s++ ) {
+        size_t g = h - 1 - s;
+        size_t r0 = i0 > g + 1 ? i0 - g : 1, r1 = i1 + g < nrows - 1 ? i1 + g : nrows - 1;
+        size_t c0 = j0 > g + 1 ? j0 - g : 1, c1 = j1 + g < ncols - 1 ? j1 + g : ncols - 1;
+        T **o = s == ts - 1 ? out : l[s & 1];
+
+        _matrix2d_stencil_step(in, o, r0 - gr0, r1 - gr0, c0 - gc0, c1 - gc0, k);
+        in = o;
+    }
+}
+
+/**
+ * Temporally blocked, multi-threaded sweeps. Each thread owns an equal
+ * range of rows (see matrix2d_par_range), as allocated by
+ * matrix2d_alloc_par with the same nthreads; results are identical to
+ * matrix2d_stencil_naive.
+ * @param a nrows x ncols grid, initial values
+ * @param b nrows x ncols grid, scratch (its boundary is overwritten
+ *        with that of a)
+ * @param nrows num of rows (at least 3)
+ * @param ncols num of columns (at least 3)
+ * @param nsteps time steps
+ * @param k stencil kernel
+ * @param pi processor map
+ * @param nthreads number of threads
+ * @param tsteps time steps per tile (1 gives a tiled naive sweep)
+ * @param tile_rows tile height
+ * @param tile_cols tile width
+ * @return a or b, whichever holds the result
+ */
+template <typename T, typename K>
+T** matrix2d_stencil(T **a, T **b, size_t nrows, size_t ncols, int nsteps,
+                     K k, procmap_t *pi, int nthreads,
+                     int tsteps = MATRIX2D_STENCIL_TSTEPS,
+                     size_t tile_rows = MATRIX2D_STENCIL_TILE_ROWS,
+                     size_t tile_cols = MATRIX2D_STENCIL_TILE_COLS)
+{
+    pthread_barrier_t barrier;
+
+    if ( tsteps < 1 )
+        tsteps = 1;
+    _matrix2d_stencil_boundary(a, b, nrows, ncols);
+    pthread_barrier_init(&barrier, NULL, nthreads);
+
+    matrix2d_parallel_rows(pi, nthreads, nrows - 2,
+        [&](int tid, size_t begin, size_t end) {
+            size_t lr = tile_rows + 2 * tsteps, lc = tile_cols + 2 * tsteps;
+            T *buf[2] = { new T [lr * lc], new T [lr * lc] };
+            T **l[4] = { new T* [lr], new T* [lr], new T* [lr], new T* [lr] };
+            T **src = a, **dst = b;
+
+            begin++;
+            end++;
+            for ( int t = 0; t < nsteps; t += tsteps ) {
+                int ts = nsteps - t < tsteps ? nsteps - t : tsteps;
+
+                for ( size_t i = begin; i < end; i += tile_rows )
+                    for ( size_t j = 1; j < ncols - 1; j += tile_cols )
+                        _matrix2d_stencil_tile(src, dst, nrows, ncols, i,
+                            end - i < tile_rows ? end : i + tile_rows, j,
+                            ncols - 1 - j < tile_cols ? ncols - 1 : j + tile_cols,
+                            ts, l, buf, k);
+
+                std::swap(src, dst);
+                pthread_barrier_wait(&barrier);
+            }
+
+            for ( int i = 0; i < 4; i++ )
+                delete [] l[i];
+            delete [] buf[0];
+            delete [] buf[1];
+        });
+
+    pthread_barrier_destroy(&barrier);
+    return ((nsteps + tsteps - 1) / tsteps) % 2 ? b : a;
+}
+
+#endif
@@ -0,0 +1,177 @@
+/**
+ * @file
+ * Tiled, register-blocked transpose of double matrices.
+ *
+ * Every MATRIX2D_TRANSPOSE_TILE tile is walked in 4x4 blocks: four
+ * rows are loaded into ymm registers, transposed with unpack/permute
+ * and stored as four rows of the target. The AVX kernel is chosen at
+ * run time; the tiled template is used on cpus without it.
+ */
+
+#include "matrix2d_transpose.h"
+
+#include <immintrin.h>
+
+/**
+ * Loads the 4x4 block at (i, j) of s and stores its transpose at
+ * (j, i) of t
+ */
+__attribute__((target("avx")))
+static inline void _block4x4(double **s, double **t, size_t i, size_t j)
+{
+    __m256d r0 = _mm256_loadu_pd(s[i + 0] + j),
+            r1 = _mm256_loadu_pd(s[i + 1] + j),
+            r2 = _mm256_loadu_pd(s[i + 2] + j),
+            r3 = _mm256_loadu_pd(s[i + 3] + j);
+    __m256d t0 = _mm256_unpacklo_pd(r0, r1),
+            t1 = _mm256_unpackhi_pd(r0, r1),
+            t2 = _mm256_unpacklo_pd(r2, r3),
+            t3 = _mm256_unpackhi_pd(r2, r3);
+
+    _mm256_storeu_pd(t[j + 0] + i, _mm256_permute2f128_pd(t0, t2, 0x20));
+    _mm256_storeu_pd(t[j + 1] + i, _mm256_permute2f128_pd(t1, t3, 0x20));
+    _mm256_storeu_pd(t[j + 2] + i, _mm256_permute2f128_pd(t0, t2, 0x31));
+    _mm256_storeu_pd(t[j + 3] + i, _mm256_permute2f128_pd(t1, t3, 0x31));
+}
+
+/**
+ * Swaps the 4x4 blocks at (i, j) and (j, i) of m, transposing both;
+ * for i == j transposes the diagonal block in place
+ */
+__attribute__((target("avx")))
+static inline void _swap4x4(double **m, size_t i, size_t j)
+{
+    __m256d a0 = _mm256_loadu_pd(m[i + 0] + j),
+            a1 = _mm256_loadu_pd(m[i + 1] + j),
+            a2 = _mm256_loadu_pd(m[i + 2] + j),
+            a3 = _mm256_loadu_pd(m[i + 3] + j);
+    __m256d b0 = _mm256_loadu_pd(m[j + 0] + i),
+            b1 = _mm256_loadu_pd(m[j + 1] + i),
+            b2 = _mm256_loadu_pd(m[j + 2] + i),
+            b3 = _mm256_loadu_pd(m[j + 3] + i);
+    __m256d t0, t1, t2, t3;
+
+    t0 = _mm256_unpacklo_pd(a0, a1);
+    t1 = _mm256_unpackhi_pd(a0, a1);
+    t2 = _mm256_unpacklo_pd(a2, a3);
+    t3 = _mm256_unpackhi_pd(a2, a3);
+    a0 = _mm256_permute2f128_pd(t0, t2, 0x20);
+    a1 = _mm256_permute2f128_pd(t1, t3, 0x20);
+    a2 = _mm256_permute2f128_pd(t0, t2, 0x31);
+    a3 = _mm256_permute2f128_pd(t1, t3, 0x31);
+
+    t0 = _mm256_unpacklo_pd(b0, b1);
+    t1 = _mm256_unpackhi_pd(b0, b1);
+    t2 = _mm256_unpacklo_pd(b2, b3);
+    t3 = _mm256_unpackhi_pd(b2, b3);
+    b0 = _mm256_permute2f128_pd(t0, t2, 0x20);
+    b1 = _mm256_permute2f128_pd(t1, t3, 0x20);
+    b2 = _mm256_permute2f128_pd(t0, t2, 0x31);
+    b3 = _mm256_permute2f128_pd(t1, t3, 0x31);
+
+    _mm256_storeu_pd(m[j + 0] + i, a0);
+    _mm256_storeu_pd(m[j + 1] + i, a1);
+    _mm256_storeu_pd(m[j + 2] + i, a2);
+    _mm256_storeu_pd(m[j + 3] + i, a3);
+    _mm256_storeu_pd(m[i + 0] + j, b0);
+    _mm256_storeu_pd(m[i + 1] + j, b1);
+    _mm256_storeu_pd(m[i + 2] + j, b2);
+    _mm256_storeu_pd(m[i + 3] + j, b3);
+}
+
+__attribute__((target("avx")))
+static void _transpose_avx(double **s, double **t, size_t nrows, size_t ncols)
+{
+    const size_t b = MATRIX2D_TRANSPOSE_TILE;
+    size_t nr4 = nrows & ~(size_t)3, nc4 = ncols & ~(size_t)3;
+
+    for ( size_t ii = 0; ii < nr4; ii += b ) {
+        size_t iend = ii + b < nr4 ? ii + b : nr4;
+        for ( size_t jj = 0; jj < nc4; jj += b ) {
+            size_t jend = jj + b < nc4 ? jj + b : nc4;
+            for ( size_t i = ii; i < iend; i += 4 )
+                for ( size_t j = jj; j < jend; j += 4 )
+                    _block4x4(s, t, i, j);
+        }
+    }
+
+    // Leftover columns of the first nr4 rows, then leftover rows
+    for ( size_t i = 0; i < nr4; i++ )
+        for ( size_t j = nc4; j < ncols; j++ )
+            t[j][i] = s[i][j];
+    for ( size_t i = nr4; i < nrows; i++ )
+        for ( size_t j = 0; j < ncols; j++ )
+            t[j][i] = s[i][j];
+}
+
+__attribute__((target("avx")))
+static void _transpose_inplace_avx(double **m, size_t n)
+{
+    const size_t b = MATRIX2D_TRANSPOSE_TILE;
+    size_t n4 = n & ~(size_t)3;
+
+    for ( size_t ii = 0; ii < n4; ii += b ) {
+        size_t iend = ii + b < n4 ? ii + b : n4;
+        for ( size_t jj = ii; jj < n4; jj += b ) {
+            size_t jend = jj + b < n4 ? jj + b : n4;
+            for ( size_t i = ii; i < iend; i += 4 )
+                for ( size_t j = (ii == jj ? i : jj); j < jend; j += 4 )
+                    _swap4x4(m, i, j);
+        }
+    }
+
+    // Pairs with the column index in the leftover band
+    for ( size_t i = 0; i < n; i++ )
+        for ( size_t j = (i + 1 > n4 ? i + 1 : n4); j < n; j++ ) {
+            double tmp = m[i][j];
+            m[i][j] = m[j][i];
+            m[j][i] = tmp;
+        }
+}
+
+static bool _have_avx(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx");
+}
+
+static const bool _avx = _have_avx();
+
+/**
+ * @return name of the transpose kernel in use
+ */
+const char* matrix2d_transpose_kernel_name(void)
+{
+    return _avx ? "avx 4x4" : "scalar tiled";
+}
+
+/**
+ * Out-of-place transpose of a double matrix, tiled with 4x4 register
+ * blocks
+ * @param s nrows x ncols source matrix
+ * @param t ncols x nrows target matrix
+ * @param nrows rows of s
+ * @param ncols columns of s
+ */
+void matrix2d_transpose_simd(double **s, double **t, size_t nrows,
+                             size_t ncols)
+{
+    if ( _avx )
+        _transpose_avx(s, t, nrows, ncols);
+    else
+        matrix2d_transpose_tiled(s, t, nrows, ncols);
+}
+
+/**
+ * In-place transpose of a square double matrix, tiled with 4x4
+ * register blocks
+ * @param m n x n matrix
+ * @param n rows and columns of m
+ */
+void matrix2d_transpose_inplace_simd(double **m, size_t n)
+{
+    if ( _avx )
+        _transpose_inplace_avx(m, n);
+    else
+        matrix2d_transpose_inplace_tiled(m, n);
+}
@@ -0,0 +1,189 @@
+/**
+ * @file
+ * Matrix transpose, out-of-place and in-place (square matrices).
+ *
+ * The naive double loop writes (or reads) along columns, touching a
+ * new cache line and, for large matrices, a new page on every
+ * element. The recursive variants split the larger dimension until
+ * blocks fit in cache, without knowing its size; the tiled variants
+ * walk fixed-size tiles. matrix2d_transpose_simd() adds a 4x4
+ * register-blocked AVX kernel for doubles.
+ */
+#ifndef MATRIX2D_TRANSPOSE_H_
+#define MATRIX2D_TRANSPOSE_H_
+
+#include <cstddef>
+#include <utility>
+
+//! Tile edge of the tiled variants, in elements
+#define MATRIX2D_TRANSPOSE_TILE 64
+
+//! Recursion stops at blocks with both edges at most this long
+#define MATRIX2D_TRANSPOSE_LEAF 16
+
+/**
+ * Out-of-place transpose, naive double loop
+ * @param s nrows x ncols source matrix
+ * @param t ncols x nrows target matrix
+ * @param nrows rows of s
+ * @param ncols columns of s
+ */
+template <typename T>
+void matrix2d_transpose_naive(T** s, T** t, size_t nrows, size_t ncols)
+{
+    for ( size_t i = 0; i < nrows; i++ )
+        for ( size_t j = 0; j < ncols; j++ )
+            t[j][i] = s[i][j];
+}
+
+template <typename T>
+void _matrix2d_transpose_rec(T** s, T** t, size_t i0, size_t i1,
+                             size_t j0, size_t j1)
+{
+    size_t di = i1 - i0, dj = j1 - j0;
+
+    if ( di <= MATRIX2D_TRANSPOSE_LEAF && dj <= MATRIX2D_TRANSPOSE_LEAF ) {
+        for ( size_t i = i0; i < i1; i++ )
+            for ( size_t j = j0; j < j1; j++ )
+                t[j][i] = s[i][j];
+    } else if ( di >= dj ) {
+        size_t mid = i0 + di / 2;
+        _matrix2d_transpose_rec(s, t, i0, mid, j0, j1);
+        _matrix2d_transpose_rec(s, t, mid, i1, j0, j1);
+    } else {
+        size_t mid = j0 + dj / 2;
+        _matrix2d_transpose_rec(s, t, i0, i1, j0, mid);
+        _matrix2d_transpose_rec(s, t, i0, i1, mid, j1);
+    }
+}
+
+/**
+ * Out-of-place transpose, recursive (cache-oblivious)
+ * @param s nrows x ncols source matrix
+ * @param t ncols x nrows target matrix
+ * @param nrows rows of s
+ * @param ncols columns of s
+ */
+template <typename T>
+void matrix2d_transpose_rec(T** s, T** t, size_t nrows, size_t ncols)
+{
+    _matrix2d_transpose_rec(s, t, 0, nrows, 0, ncols);
+}
+
+/**
+ * Out-of-place transpose, in tiles of MATRIX2D_TRANSPOSE_TILE
+ * @param s nrows x ncols source matrix
+ * @param t ncols x nrows target matrix
+ * @param nrows rows of s
+ * @param ncols columns of s
+ */
+template <typename T>
+void matrix2d_transpose_tiled(T** s, T** t, size_t nrows, size_t ncols)
+{
+    const size_t b = MATRIX2D_TRANSPOSE_TILE;
+
+    for ( size_t ii = 0; ii < nrows; ii += b ) {
+        size_t iend = ii + b < nrows ? ii + b : nrows;
+        for ( size_t jj = 0; jj < ncols; jj += b ) {
+            size_t jend = jj + b < ncols ? jj + b : ncols;
+            for ( size_t i = ii; i < iend; i++ )
+                for ( size_t j = jj; j < jend; j++ )
+                    t[j][i] = s[i][j];
+        }
+    }
+}
+
+/**
+ * In-place transpose of a square matrix, naive double loop
+ * @param m n x n matrix
+ * @param n rows and columns of m
+ */
+template <typename T>
+void matrix2d_transpose_inplace_naive(T** m, size_t n)
+{
+    for ( size_t i = 0; i < n; i++ )
+        for ( size_t j = i + 1; j < n; j++ )
+            std::swap(m[i][j], m[j][i]);
+}
+
+// Swaps block [i0,i1)x[j0,j1) with the transpose of [j0,j1)x[i0,i1);
+// the two blocks must not overlap
+template <typename T>
+void _matrix2d_transpose_swap_rec(T** m, size_t i0, size_t i1,
+                                  size_t j0, size_t j1)
+{
+    size_t di = i1 - i0, dj = j1 - j0;
+
+    if ( di <= MATRIX2D_TRANSPOSE_LEAF && dj <= MATRIX2D_TRANSPOSE_LEAF ) {
+        for ( size_t i = i0; i < i1; i++ )
+            for ( size_t j = j0; j < j1; j++ )
+                std::swap(m[i][j], m[j][i]);
+    } else if ( di >= dj ) {
+        size_t mid = i0 + di / 2;
+        _matrix2d_transpose_swap_rec(m, i0, mid, j0, j1);
+        _matrix2d_transpose_swap_rec(m, mid, i1, j0, j1);
+    } else {
+        size_t mid = j0 + dj / 2;
+        _matrix2d_transpose_swap_rec(m, i0, i1, j0, mid);
+        _matrix2d_transpose_swap_rec(m, i0, i1, mid, j1);
+    }
+}
+
+// Transposes diagonal block [i0,i1)x[i0,i1) in place
+template <typename T>
+void _matrix2d_transpose_inplace_rec(T** m, size_t i0, size_t i1)
+{
+    size_t mid;
+
+    if ( i1 - i0 <= MATRIX2D_TRANSPOSE_LEAF ) {
+        for ( size_t i = i0; i < i1; i++ )
+            for ( size_t j = i + 1; j < i1; j++ )
+                std::swap(m[i][j], m[j][i]);
+        return;
+    }
+
+    mid = i0 + (i1 - i0) / 2;
+    _matrix2d_transpose_inplace_rec(m, i0, mid);
+    _matrix2d_transpose_inplace_rec(m, mid, i1);
+    _matrix2d_transpose_swap_rec(m, i0, mid, mid, i1);
+}
+
+/**
+ * In-place transpose of a square matrix, recursive (cache-oblivious)
+ * @param m n x n matrix
+ * @param n rows and columns of m
+ */
+template <typename T>
+void matrix2d_transpose_inplace_rec(T** m, size_t n)
+{
+    _matrix2d_transpose_inplace_rec(m, 0, n);
+}
+
+/**
+ * In-place transpose of a square matrix, in tiles of
+ * MATRIX2D_TRANSPOSE_TILE
+ * @param m n x n matrix
+ * @param n rows and columns of m
+ */
+template <typename T>
+void matrix2d_transpose_inplace_tiled(T** m, size_t n)
+{
+    const size_t b = MATRIX2D_TRANSPOSE_TILE;
+
+    for ( size_t ii = 0; ii < n; ii += b ) {
+        size_t iend = ii + b < n ? ii + b : n;
+        for ( size_t jj = ii; jj < n; jj += b ) {
+            size_t jend = jj + b < n ? jj + b : n;
+            for ( size_t i = ii; i < iend; i++ )
+                for ( size_t j = (ii == jj ? i + 1 : jj); j < jend; j++ )
+                    std::swap(m[i][j], m[j][i]);
+        }
+    }
+}
+
+const char* matrix2d_transpose_kernel_name(void);
+void matrix2d_transpose_simd(double **s, double **t, size_t nrows,
+                             size_t ncols);
+void matrix2d_transpose_inplace_simd(double **m, size_t n);
+
+#endif
@@ -0,0 +1,162 @@
+/**
+ * @file
+ * Non-owning views into matrices given as row pointers.
+ *
+ * A view maps its element (i, j) to rows[i*rs][c0 + i*skew + j*cs] of
+ * the underlying matrix, which covers submatrices (optionally with
+ * row/column strides), single rows and columns, and diagonals
+ * (skew 1). Views index like a T** (v[i][j]), so they can be passed to
+ * matrix2d_init, matrix2d_copy and matrix2d_print; views of views are
+ * views, so recursive blocked algorithms never copy. Kernels that take
+ * plain row pointers (e.g. matrix2d_gemm) can be given the rows of a
+ * view with unit column stride through matrix2d_view_rowptrs().
+ */
+#ifndef MATRIX2D_VIEW_H_
+#define MATRIX2D_VIEW_H_
+
+#include <cstddef>
+
+#include "matrix2d.h"
+
+/**
+ * Strided view into a matrix
+ */
+template <typename T>
+struct matrix2d_view {
+    T **rows;        //!< row pointers, starting at the view's first row
+    ptrdiff_t c0;    //!< column of element (0, 0)
+    ptrdiff_t rs;    //!< row step (view row i is rows[i*rs])
+    ptrdiff_t cs;    //!< column step
+    ptrdiff_t skew;  //!< column offset added per view row
+    size_t nrows;
+    size_t ncols;
+
+    //! One row of a view, indexable by column
+    struct row_ref {
+        T *p;
+        ptrdiff_t cs;
+        T& operator[](size_t j) const { return p[(ptrdiff_t)j * cs]; }
+    };
+
+    row_ref operator[](size_t i) const
+    {
+        row_ref r = { rows[(ptrdiff_t)i * rs] + c0 + (ptrdiff_t)i * skew, cs };
+        return r;
+    }
+
+    T& operator()(size_t i, size_t j) const { return (*this)[i][j]; }
+};
+
+/**
+ * View of a whole matrix
+ * @param m pointer to matrix
+ * @param nrows num of rows
+ * @param ncols num of columns
+ */
+template <typename T>
+matrix2d_view<T> matrix2d_view_of(T** m, size_t nrows, size_t ncols)
+{
+    matrix2d_view<T> v = { m, 0, 1, 1, 0, nrows, ncols };
+    return v;
+}
+
+template <typename T>
+matrix2d_view<T> matrix2d_view_of(const matrix2d_t<T>& m)
+{
+    return matrix2d_view_of(m.rows, m.nrows, m.ncols);
+}
+
+/**
+ * Submatrix of a view: element (i, j) is v(r0 + i*rstride, c0 + j*cstride)
+ * @param v view
+ * @param r0 first row
+ * @param c0 first column
+ * @param nrows num of rows of the submatrix
+ * @param ncols num of columns of the submatrix
+ * @param rstride step between rows, in rows of v
+ * @param cstride step between columns, in columns of v
+ */
+template <typename T>
+matrix2d_view<T> matrix2d_sub(const matrix2d_view<T>& v, size_t r0,
+                              size_t c0, size_t nrows, size_t ncols,
+                              size_t rstride = 1, size_t cstride = 1)
+{
+    matrix2d_view<T> s;
+
+    s.rows = v.rows + (ptrdiff_t)r0 * v.rs;
+    s.c0 = v.c0 + (ptrdiff_t)r0 * v.skew + (ptrdiff_t)c0 * v.cs;
+    s.rs = v.rs * (ptrdiff_t)rstride;
+    s.cs = v.cs * (ptrdiff_t)cstride;
+    s.skew = v.skew * (ptrdiff_t)rstride;
+    s.nrows = nrows;
+    s.ncols = ncols;
+    return s;
+}
+
+/**
+ * Submatrix of a matrix
+ * @see matrix2d_sub(const matrix2d_view<T>&, ...)
+ */
+template <typename T>
+matrix2d_view<T> matrix2d_sub(T** m, size_t r0, size_t c0, size_t nrows,
+                              size_t ncols, size_t rstride = 1,
+                              size_t cstride = 1)
+{
+    return matrix2d_sub(matrix2d_view_of(m, r0 + nrows * rstride,
+                                         c0 + ncols * cstride),
+                        r0, c0, nrows, ncols, rstride, cstride);
+}
+
+/**
+ * Row i of a view, as a 1 x ncols view
+ */
+template <typename T>
+matrix2d_view<T> matrix2d_row(const matrix2d_view<T>& v, size_t i)
+{
+    return matrix2d_sub(v, i, 0, 1, v.ncols);
+}
+
+/**
+ * Column j of a view, as an nrows x 1 view
+ */
+template <typename T>
+matrix2d_view<T> matrix2d_col(const matrix2d_view<T>& v, size_t j)
+{
+    return matrix2d_sub(v, 0, j, v.nrows, 1);
+}
+
+/**
+ * Diagonal of a view, as an n x 1 view
+ * @param v view
+ * @param k diagonal: 0 for the main one, > 0 above it, < 0 below it
+ */
+template <typename T>
+matrix2d_view<T> matrix2d_diag(const matrix2d_view<T>& v, ptrdiff_t k = 0)
+{
+    size_t r0 = k < 0 ? -k : 0, c0 = k > 0 ? k : 0, n = 0;
+    matrix2d_view<T> d;
+
+    if ( r0 < v.nrows && c0 < v.ncols )
+        n = v.nrows - r0 < v.ncols - c0 ? v.nrows - r0 : v.ncols - c0;
+
+    d = matrix2d_sub(v, r0, c0, n, 1);
+    d.skew += v.cs;
+    return d;
+}
+
+/**
+ * Row pointers of a view with unit column stride, for kernels taking
+ * T** (e.g. matrix2d_gemm)
+ * @param v view with cs == 1
+ * @param out v.nrows row pointers, filled in
+ * @return out
+ */
+template <typename T>
+T** matrix2d_view_rowptrs(const matrix2d_view<T>& v, T **out)
+{
+    for ( size_t i = 0; i < v.nrows; i++ )
+        out[i] = &v[i][0];
+    return out;
+}
+
+#endif
@@ -0,0 +1,237 @@
+/**
+ * @file
+ * Performance counter groups on top of perf_event_open(2).
+ * All events of a group are read with a single read() on the leader,
+ * so a start/stop pair costs two system calls regardless of the
+ * number of events.
+ */
+#define _GNU_SOURCE
+
+#include "perfctr.h"
+
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const struct {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} _events[PERFCTR_NUM_KINDS] = {
+    { "cycles",         PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "instructions",   PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "cache-refs",     PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES },
+    { "cache-misses",   PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { "branch-misses",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { "task-clock(ns)", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+    { "page-faults",    PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+    { "ctx-switches",   PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+    { "cpu-migrations", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS },
+};
+
+static int _perf_event_open(perfctr_kind_t kind, int group_fd)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = _events[kind].type;
+    attr.config = _events[kind].config;
+    attr.read_format = PERF_FORMAT_GROUP |
+                       PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.disabled = group_fd == -1;
+    // User-space only: works with perf_event_paranoid <= 2
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+/**
+ * Opens the events in [first, last] as one group on the calling
+ * thread. Members that cannot be opened are skipped; the group fails
+ * only if its leader does.
+ * @return 0 on success, -1 on error
+ */
+static int _open_group(perfctr_t *pc, perfctr_kind_t first,
+                       perfctr_kind_t last)
+{
+    int k, fd;
+
+    pc->nevents = 0;
+    for ( k = 0; k < PERFCTR_NUM_KINDS; k++ )
+        pc->index[k] = -1;
+
+    for ( k = first; k <= last; k++ ) {
+        fd = _perf_event_open(k, pc->nevents ? pc->fd[0] : -1);
+        if ( fd < 0 ) {
+            if ( !pc->nevents )
+                return -1;
+            continue;
+        }
+        pc->fd[pc->nevents] = fd;
+        pc->kind[pc->nevents] = k;
+        pc->index[k] = pc->nevents;
+        pc->nevents++;
+    }
+
+    return 0;
+}
+
+/**
+ * Opens a counter group for the calling thread: cycles, instructions,
+ * cache references/misses and branch misses if the PMU is accessible,
+ * software events otherwise. Counting starts immediately.
+ * @param pc handle to initialize
+ * @return 0 on success, -1 if no events could be opened
+ */
+int perfctr_open(perfctr_t *pc)
+{
+    memset(pc, 0, sizeof(*pc));
+
+    if ( _open_group(pc, PERFCTR_CYCLES, PERFCTR_BRANCH_MISSES) == 0 ) {
+        pc->hw = 1;
+    } else if ( _open_group(pc, PERFCTR_TASK_CLOCK,
+                            PERFCTR_CPU_MIGRATIONS) == 0 ) {
+        pc->hw = 0;
+    } else {
+        perror("perf_event_open");
+        return -1;
+    }
+
+    ioctl(pc->fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(pc->fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+    return 0;
+}
+
+/**
+ * Closes all events of the group
+ */
+void perfctr_close(perfctr_t *pc)
+{
+    int i;
+
+    for ( i = pc->nevents - 1; i >= 0; i-- )
+        close(pc->fd[i]);
+    pc->nevents = 0;
+}
+
+/**
+ * Zeroes the accumulated counts
+ */
+void perfctr_clear(perfctr_t *pc)
+{
+    memset(pc->total, 0, sizeof(pc->total));
+    pc->invocs = 0;
+}
+
+/**
+ * Reads the whole group at once
+ * @param buf enabled time, running time and one value per event
+ */
+static inline void _read_group(perfctr_t *pc, uint64_t *buf)
+{
+    uint64_t raw[PERFCTR_MAX_EVENTS + 3];
+
+    if ( read(pc->fd[0], raw, (pc->nevents + 3) * sizeof(uint64_t)) <= 0 ) {
+        memset(buf, 0, (pc->nevents + 2) * sizeof(uint64_t));
+        return;
+    }
+    // raw[0] is the number of events
+    memcpy(buf, raw + 1, (pc->nevents + 2) * sizeof(uint64_t));
+}
+
+/**
+ * Snapshots the counters at the start of a measured region
+ */
+void perfctr_start(perfctr_t *pc)
+{
+    _read_group(pc, pc->start);
+}
+
+/**
+ * Accumulates counts since the last perfctr_start().
+ * If the group was multiplexed with other users of the PMU, counts
+ * are scaled up by enabled/running time.
+ */
+void perfctr_stop(perfctr_t *pc)
+{
+    uint64_t now[PERFCTR_MAX_EVENTS + 2];
+    double scale = 1.0;
+    uint64_t enabled, running;
+    int i;
+
+    _read_group(pc, now);
+
+    enabled = now[0] - pc->start[0];
+    running = now[1] - pc->start[1];
+    if ( running && running < enabled )
+        scale = (double)enabled / running;
+
+    for ( i = 0; i < pc->nevents; i++ )
+        pc->total[i] += (now[i+2] - pc->start[i+2]) * scale;
+    pc->invocs++;
+}
+
+/**
+ * @return accumulated count for an event kind, -1 if it is not
+ *         part of the group
+ */
+double perfctr_get(perfctr_t *pc, perfctr_kind_t kind)
+{
+    return pc->index[kind] < 0 ? -1.0 : pc->total[pc->index[kind]];
+}
+
+/**
+ * @return printable event name
+ */
+const char* perfctr_name(perfctr_kind_t kind)
+{
+    return _events[kind].name;
+}
+
+/**
+ * Prints per-operation counts and derived metrics (IPC, miss ratios)
+ * next to the TSC timer results of the same region
+ * @param fp output stream
+ * @param label region name
+ * @param pc counters
+ * @param t timer measured over the same start/stop points (may be NULL)
+ * @param ops number of operations performed in the region
+ */
+void perfctr_report(FILE *fp, const char *label, perfctr_t *pc,
+                    tsctimer_t *t, unsigned long ops)
+{
+    double cycles = perfctr_get(pc, PERFCTR_CYCLES),
+           instrs = perfctr_get(pc, PERFCTR_INSTRUCTIONS),
+           refs = perfctr_get(pc, PERFCTR_CACHE_REFS),
+           misses = perfctr_get(pc, PERFCTR_CACHE_MISSES);
+    int i;
+
+    if ( !ops )
+        ops = 1;
+
+    fprintf(fp, "%s (%lu ops, %s counters)\n", label, ops,
+            pc->hw ? "hardware" : "software");
+    if ( t )
+        fprintf(fp, "  %-16s %14.2f /op\n", "tsc-cycles",
+                timer_total(t) / ops);
+    for ( i = 0; i < pc->nevents; i++ )
+        fprintf(fp, "  %-16s %14.2f /op\n", perfctr_name(pc->kind[i]),
+                pc->total[i] / ops);
+
+    if ( cycles > 0 && instrs >= 0 )
+        fprintf(fp, "  %-16s %14.2f\n", "IPC", instrs / cycles);
+    if ( refs > 0 && misses >= 0 )
+        fprintf(fp, "  %-16s %13.2f%%\n", "cache-miss ratio",
+                100.0 * misses / refs);
+    if ( t && cycles > 0 )
+        fprintf(fp, "  %-16s %14.2f\n", "cycles/tsc",
+                cycles / timer_total(t));
+}
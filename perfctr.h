@@ -0,0 +1,60 @@
+/**
+ * @file
+ * Hardware performance counter groups (perf_event_open), read at
+ * timer_start/timer_stop-style points
+ */
+
+#ifndef PERFCTR_H_
+#define PERFCTR_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "tsc_x86_64.h"
+
+/**
+ * Counted event kinds
+ */
+typedef enum {
+    PERFCTR_CYCLES = 0,
+    PERFCTR_INSTRUCTIONS,
+    PERFCTR_CACHE_REFS,
+    PERFCTR_CACHE_MISSES,
+    PERFCTR_BRANCH_MISSES,
+    // Software fallbacks, when the PMU is not accessible
+    PERFCTR_TASK_CLOCK,
+    PERFCTR_PAGE_FAULTS,
+    PERFCTR_CTX_SWITCHES,
+    PERFCTR_CPU_MIGRATIONS,
+    PERFCTR_NUM_KINDS
+} perfctr_kind_t;
+
+#define PERFCTR_MAX_EVENTS PERFCTR_NUM_KINDS
+
+/**
+ * Event group handle and accumulated counts.
+ * Like tsctimer_t, counts accumulate over start/stop pairs until
+ * perfctr_clear() is called.
+ */
+typedef struct {
+    int nevents;
+    int hw;                                 //!< 1 if PMU events are used
+    int fd[PERFCTR_MAX_EVENTS];             //!< fd[0] is the group leader
+    perfctr_kind_t kind[PERFCTR_MAX_EVENTS];
+    int index[PERFCTR_NUM_KINDS];           //!< kind -> slot, -1 if absent
+    uint64_t start[PERFCTR_MAX_EVENTS + 2]; //!< enabled, running, values
+    double total[PERFCTR_MAX_EVENTS];       //!< multiplexing-scaled sums
+    uint64_t invocs;
+} perfctr_t;
+
+int perfctr_open(perfctr_t *pc);
+void perfctr_close(perfctr_t *pc);
+void perfctr_clear(perfctr_t *pc);
+void perfctr_start(perfctr_t *pc);
+void perfctr_stop(perfctr_t *pc);
+double perfctr_get(perfctr_t *pc, perfctr_kind_t kind);
+const char* perfctr_name(perfctr_kind_t kind);
+void perfctr_report(FILE *fp, const char *label, perfctr_t *pc,
+                    tsctimer_t *t, unsigned long ops);
+
+#endif
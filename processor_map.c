@@ -2,12 +2,19 @@
  * @file
  * Definitions for functions related to processor hierarchy
  * exploration.
+ *
+ * All information comes from sysfs. Directories are listed with
+ * opendir() and files are read relative to an open directory with
+ * openat(), into one buffer; every descriptor is closed before
+ * procmap_init() returns.
  */ 
 
 #include "processor_map.h"
 
 #include <assert.h>
-#include <error.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -15,53 +22,371 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
-#include <wait.h>
 
 #include "util.h"
 
+#define SYSFS_CPU "/sys/devices/system/cpu"
+#define SYSFS_NODE "/sys/devices/system/node"
+
+//! Size of the buffer sysfs files are read into (fits node meminfo)
+#define READ_BUF_SIZE 4096
+
+static int _cmp_int(const void *a, const void *b)
+{
+    return *(const int*)a - *(const int*)b;
+}
+
 /**
- * @return Total number of cpus (hw threads) of the system, 
- *         0 if no info found
- */ 
-static inline int _get_num_cpus() 
+ * Lists the entries of a directory named <prefix><number>
+ * @param path directory
+ * @param prefix name prefix
+ * @param ids set to a malloc'ed array of the numbers, in increasing
+ *        order (NULL if there are none)
+ * @return number of entries, 0 if the directory could not be read
+ */
+static int _list_ids(const char *path, const char *prefix, int **ids)
 {
-    if ( open("/sys/devices/system/cpu/", O_RDONLY ) < 0 )
+    size_t plen = strlen(prefix);
+    int n = 0, cap = 0;
+    struct dirent *e;
+    DIR *d;
+
+    *ids = NULL;
+    if ( !(d = opendir(path)) )
         return 0;
-    else
-        return WEXITSTATUS(
-            system("exit $(ls -l /sys/devices/system/cpu/"
-                   " | grep 'cpu[0-9]*[0-9]' | wc -l)")
-            );
+
+    while ( (e = readdir(d)) ) {
+        char *end;
+        long id;
+
+        if ( strncmp(e->d_name, prefix, plen) || 
+             !isdigit((unsigned char)e->d_name[plen]) )
+            continue;
+        id = strtol(e->d_name + plen, &end, 10);
+        if ( *end )
+            continue;
+
+        if ( n == cap ) {
+            cap = cap ? 2 * cap : 64;
+            if ( !(*ids = (int*)realloc(*ids, cap * sizeof(int))) ) {
+                fprintf(stderr, "%s: Allocation error\n", __FUNCTION__);
+                exit(EXIT_FAILURE);
+            }
+        }
+        (*ids)[n++] = (int)id;
+    }
+    closedir(d);
+
+    qsort(*ids, n, sizeof(int), _cmp_int);
+    return n;
 }
 
 /**
- * @return Total number of cache levels that cpu0 (and every
- *         other cpu) sees, 0 if no info found
- */         
-static inline int _get_num_caches() 
+ * Opens a subdirectory
+ * @return descriptor, -1 if dirfd is -1 or on error
+ */
+static int _open_dir_at(int dirfd, const char *name)
 {
-    if ( open("/sys/devices/system/cpu/cpu0/cache/", O_RDONLY ) < 0 )
-        return 0;
-    else
-        return WEXITSTATUS(
-            system("exit $(ls -l /sys/devices/system/cpu/cpu0/cache/"
-                   " | grep index | wc -l)")
-            );
+    if ( dirfd < 0 )
+        return -1;
+    return openat(dirfd, name, O_RDONLY | O_DIRECTORY);
+}
+
+static void _close_fd(int fd)
+{
+    if ( fd >= 0 )
+        close(fd);
 }
 
 /**
- * @return Total number of memory nodes of the system, 
- *         0 if no info found.
- */ 
-static inline int _get_num_memnodes()
+ * Reads a sysfs file relative to a directory, without the newline
+ * @param dirfd directory descriptor (-1 fails)
+ * @param name file name
+ * @param buf buffer of READ_BUF_SIZE chars, NUL-terminated on return
+ * @return number of chars read, -1 on error
+ */
+static int _read_at(int dirfd, const char *name, char *buf)
 {
-    if ( open("/sys/devices/system/node/", O_RDONLY ) < 0 )
-        return 0;
-    else
-        return WEXITSTATUS(
-            system("exit $(ls -l /sys/devices/system/node/"
-                   " | grep node | wc -l)")
-            );
+    int fd, br;
+
+    if ( dirfd < 0 || (fd = openat(dirfd, name, O_RDONLY)) < 0 )
+        return -1;
+
+    do {
+        br = read(fd, buf, READ_BUF_SIZE - 1);
+    } while ( br < 0 && errno == EINTR );
+    close(fd);
+
+    if ( br < 0 )
+        return -1;
+    buf[br] = '\0';
+    trim(buf, '\n');
+    return br;
+}
+
+/**
+ * Reads a decimal number from a sysfs file, or reports it missing
+ * @param dirfd directory descriptor
+ * @param dir directory path, for the error message
+ * @param name file name
+ * @param buf read buffer
+ * @return the number, -1 if the file could not be read
+ */
+static long _read_long_at(int dirfd, const char *dir, const char *name,
+                          char *buf)
+{
+    if ( _read_at(dirfd, name, buf) < 0 ) {
+        fprintf(stderr, "Could not open %s/%s\n", dir, name);
+        return -1;
+    }
+    return strtol(buf, NULL, 10);
+}
+
+/**
+ * Reads a cpu set from a sysfs hex mask file, or failing that from
+ * the equivalent cpu list file
+ * @param dirfd directory descriptor
+ * @param dir directory path, for the error message
+ * @param mask_name mask file name
+ * @param list_name list file name
+ * @param buf read buffer
+ * @return new set, empty if neither file could be read
+ */
+static cpuset_t* _read_cpuset_at(int dirfd, const char *dir, 
+                                 const char *mask_name, 
+                                 const char *list_name, char *buf)
+{
+    cpuset_t *s = NULL;
+
+    if ( _read_at(dirfd, mask_name, buf) >= 0 )
+        s = cpuset_parse_mask(buf);
+    else if ( _read_at(dirfd, list_name, buf) >= 0 )
+        s = cpuset_parse_list(buf);
+    else 
+        fprintf(stderr, "Could not open %s/%s\n", dir, mask_name);
+
+    return s ? s : cpuset_alloc(0);
+}
+
+/**
+ * Parses a cache size such as "32K" or "105M"
+ * @return size in bytes
+ */
+static unsigned long _parse_size(const char *s)
+{
+    char *end;
+    unsigned long v = strtoul(s, &end, 10);
+
+    switch ( *end ) {
+        case 'K': return v << 10;
+        case 'M': return v << 20;
+        case 'G': return v << 30;
+        default:  return v;
+    }
+}
+
+/**
+ * Reads the caches of a cpu
+ * @param cache_fd descriptor of cpuN/cache (may be -1)
+ * @param dir path of cpuN/cache, for error messages
+ * @param cache num_caches entries, filled in
+ * @param num_caches number of indexN subdirectories
+ * @param buf read buffer
+ */
+static void _read_caches(int cache_fd, const char *dir, cacheinfo_t *cache,
+                         int num_caches, char *buf)
+{
+    char name[16], path[256];
+    int j, fd;
+
+    for ( j = 0; j < num_caches; j++ ) {
+        sprintf(name, "index%d", j);
+        snprintf(path, sizeof(path), "%.200s/%s", dir, name);
+        fd = _open_dir_at(cache_fd, name);
+
+        cache[j].coherency_line_size = 
+            _read_long_at(fd, path, "coherency_line_size", buf);
+        cache[j].level = _read_long_at(fd, path, "level", buf);
+        cache[j].number_of_sets = 
+            _read_long_at(fd, path, "number_of_sets", buf);
+        cache[j].physical_line_partition = 
+            _read_long_at(fd, path, "physical_line_partition", buf);
+        cache[j].shared_cpu_map = 
+            _read_cpuset_at(fd, path, "shared_cpu_map", "shared_cpu_list", 
+                            buf);
+        cache[j].ways_of_associativity = 
+            _read_long_at(fd, path, "ways_of_associativity", buf);
+
+        if ( _read_at(fd, "size", buf) < 0 ) {
+            fprintf(stderr, "Could not open %s/size\n", path);
+            cache[j].size = 0;
+        } else {
+            cache[j].size = _parse_size(buf);
+        }
+
+        if ( _read_at(fd, "type", buf) < 0 ) {
+            fprintf(stderr, "Could not open %s/type\n", path);
+            sprintf(cache[j].type, "-1");
+        } else {
+            snprintf(cache[j].type, sizeof(cache[j].type), "%.31s", buf);
+        }
+
+        _close_fd(fd);
+    }
+}
+
+/**
+ * Numbers keys densely, in order of first appearance, through a table
+ * indexed by key: O(n + largest key)
+ * @param key n keys (>= 0, or -1 for none), replaced by their numbers
+ * @param n number of keys
+ * @return number of distinct keys
+ */
+static int _renumber(int *key, int n)
+{
+    int i, num = 0, limit = 0, *id;
+
+    for ( i = 0; i < n; i++ )
+        if ( key[i] >= limit )
+            limit = key[i] + 1;
+
+    id = (int*)malloc_safe((limit + 1) * sizeof(int));
+    for ( i = 0; i < limit; i++ )
+        id[i] = -1;
+
+    for ( i = 0; i < n; i++ ) {
+        if ( key[i] < 0 )
+            continue;
+        if ( id[key[i]] < 0 )
+            id[key[i]] = num++;
+        key[i] = id[key[i]];
+    }
+
+    free(id);
+    return num;
+}
+
+/**
+ * Fills in a topology level by counting sort of the cpus on their
+ * domain
+ * @param dom level, filled in
+ * @param of_cpu domain of each cpu (-1: none), owned by dom afterwards
+ * @param num number of domains
+ * @param flat_threads cpus
+ * @param n number of cpus
+ */
+static void _build_level(procmap_domains_t *dom, int *of_cpu, int num,
+                         threadinfo_t *flat_threads, int n)
+{
+    int i, d, *pos;
+
+    dom->num = num;
+    dom->of_cpu = of_cpu;
+    dom->start = (int*)calloc(num + 1, sizeof(int));
+    dom->cpus = (int*)malloc_safe((n + 1) * sizeof(int));
+    pos = (int*)malloc_safe((num + 1) * sizeof(int));
+    if ( !dom->start ) {
+        fprintf(stderr, "%s: Allocation error\n", __FUNCTION__);
+        exit(EXIT_FAILURE);
+    }
+
+    for ( i = 0; i < n; i++ )
+        if ( of_cpu[i] >= 0 )
+            dom->start[of_cpu[i] + 1]++;
+    for ( d = 0; d < num; d++ ) {
+        dom->start[d + 1] += dom->start[d];
+        pos[d] = dom->start[d];
+    }
+
+    // flat_threads is in cpu_id order, so is each domain
+    for ( i = 0; i < n; i++ )
+        if ( of_cpu[i] >= 0 )
+            dom->cpus[pos[of_cpu[i]]++] = flat_threads[i].cpu_id;
+
+    free(pos);
+}
+
+/**
+ * Builds the cpu_id index and the domains of every topology level
+ * (linear in the number of cpus, times the number of caches)
+ * @param pi processor map, with cpus, hierarchy and memnodes filled in
+ */
+static void _build_domains(procmap_t *pi)
+{
+    threadinfo_t *t = pi->flat_threads;
+    int n = pi->num_cpus, i, j, m, cpu, lvl;
+
+    pi->cpu_id_limit = n > 0 ? t[n - 1].cpu_id + 1 : 0;
+    pi->cpu_index = (int*)malloc_safe((pi->cpu_id_limit + 1) * sizeof(int));
+    for ( cpu = 0; cpu < pi->cpu_id_limit; cpu++ )
+        pi->cpu_index[cpu] = -1;
+    for ( i = 0; i < n; i++ )
+        pi->cpu_index[t[i].cpu_id] = i;
+
+    for ( lvl = 0; lvl < PROCMAP_NUM_LEVELS; lvl++ ) {
+        int *key = (int*)malloc_safe((n + 1) * sizeof(int)), num = 0;
+
+        switch ( lvl ) {
+            case PROCMAP_LEVEL_THREAD:
+                for ( i = 0; i < n; i++ )
+                    key[i] = i;
+                num = n;
+                break;
+
+            case PROCMAP_LEVEL_CORE:
+                for ( i = 0; i < n; i++ )
+                    key[i] = t[i].pack_id < 0 || t[i].core_id < 0 ? -1 :
+                             t[i].pack_id * pi->num_cores_per_package + 
+                             t[i].core_id;
+                num = _renumber(key, n);
+                break;
+
+            case PROCMAP_LEVEL_L1:
+            case PROCMAP_LEVEL_L2:
+            case PROCMAP_LEVEL_L3:
+                // a cache instance is known by its first sharer
+                for ( i = 0; i < n; i++ ) {
+                    key[i] = -1;
+                    for ( j = 0; j < t[i].num_caches; j++ ) {
+                        cacheinfo_t *c = &t[i].cache[j];
+                        if ( c->level == lvl - PROCMAP_LEVEL_L1 + 1 && 
+                             c->type[0] != 'I' ) {
+                            key[i] = cpuset_first(c->shared_cpu_map);
+                            break;
+                        }
+                    }
+                }
+                num = _renumber(key, n);
+                break;
+
+            case PROCMAP_LEVEL_NODE:
+                for ( i = 0; i < n; i++ )
+                    key[i] = -1;
+                for ( m = 0; m < pi->num_memnodes; m++ ) {
+                    cpuset_t *map = pi->memnode[m].cpumap;
+                    for ( cpu = cpuset_first(map); cpu >= 0; 
+                          cpu = cpuset_next(map, cpu) )
+                        if ( (i = procmap_cpu_index(pi, cpu)) >= 0 )
+                            key[i] = m;
+                }
+                num = pi->num_memnodes;
+                break;
+
+            case PROCMAP_LEVEL_PACKAGE:
+                for ( i = 0; i < n; i++ )
+                    key[i] = t[i].pack_id;
+                num = pi->num_packages;
+                break;
+
+            case PROCMAP_LEVEL_SYSTEM:
+                for ( i = 0; i < n; i++ )
+                    key[i] = 0;
+                num = n > 0;
+                break;
+        }
+
+        _build_level(&pi->domain[lvl], key, num, t, n);
+    }
 }
 
 /**
@@ -73,57 +398,30 @@ procmap_t* procmap_init()
 {
     procmap_t *pi;
 
-    char base_path[] = "/sys/devices/system/";
     char path[128], 
-         curr_cpu[8],
-         curr_index[8],
-         curr_node[8],
-         cpu_path[128],
-         buf[1024];
-    int fd, i, j, k, l, br, 
-        found_so_far, 
-        curr_id,
+         name[32],
+         buf[READ_BUF_SIZE];
+    int i, j, l, 
         num_cpus,
         num_memnodes,
         num_caches, 
         num_packages, 
         num_cores_per_package,
         num_threads_per_core;
-    int *sym_pack_ids,
-        *sym_core_ids;
+    int cpu_fd, node_fd, dir_fd, topo_fd, cache_fd;
+    int *cpu_ids, 
+        *node_ids,
+        *cache_ids,
+        *key;
     cacheinfo_t *cache;
     coreinfo_t *core;
 
-    path[0] = '\0';
-    strcat(path, base_path);
-    strcat(path, "/cpu/");
-    if ( open(path, O_RDONLY) < 0 ) {
-        perror(base_path);
+    if ( (cpu_fd = open(SYSFS_CPU, O_RDONLY | O_DIRECTORY)) < 0 ) {
+        perror(SYSFS_CPU);
         fprintf(stderr, "Required information was not found. Exiting\n");
         exit(EXIT_FAILURE);
     }
 
-    path[0] = '\0';
-    strcat(path, base_path);
-    strcat(path, "/cpu/cpu0/topology/");
-    if ( open(path, O_RDONLY) < 0 ) {
-        fprintf(stderr, "System does not provide processor topology info\n");
-    } 
-
-    path[0] = '\0';
-    strcat(path, base_path);
-    strcat(path, "/cpu/cpu0/cache/");
-    if ( open(path, O_RDONLY) < 0 ) {
-        fprintf(stderr, "System does not provide processor cache info\n");
-    } 
-
-    path[0] = '\0';
-    strcat(path, base_path);
-    strcat(path, "/node/node0/");
-    if ( open(path, O_RDONLY) < 0 ) {
-        fprintf(stderr, "System does not provide memory node info\n");
-    } 
-
     // Allocate handle
     pi = (procmap_t*)malloc(sizeof(procmap_t));
     if ( !pi ) {
@@ -131,14 +429,23 @@ procmap_t* procmap_init()
         exit(EXIT_FAILURE);
     }
 
-    num_cpus = _get_num_cpus();
+    num_cpus = _list_ids(SYSFS_CPU, "cpu", &cpu_ids);
     pi->num_cpus = num_cpus;
    
-    num_memnodes = _get_num_memnodes();
+    num_memnodes = _list_ids(SYSFS_NODE, "node", &node_ids);
     pi->num_memnodes = num_memnodes;
+    if ( !num_memnodes )
+        fprintf(stderr, "System does not provide memory node info\n");
     
-    num_caches = _get_num_caches();
+    num_caches = 0;
+    if ( num_cpus > 0 ) {
+        snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/cache", cpu_ids[0]);
+        num_caches = _list_ids(path, "index", &cache_ids);
+        free(cache_ids);
+    }
     pi->num_caches_per_thread = num_caches;
+    if ( !num_caches )
+        fprintf(stderr, "System does not provide processor cache info\n");
 
     // Array of handles for all hw threads of the system
     threadinfo_t *flat_threads = (threadinfo_t*)malloc(num_cpus * 
@@ -151,71 +458,26 @@ procmap_t* procmap_init()
 
     // populate array
     for ( i = 0; i < num_cpus; i++ ) {
-        flat_threads[i].cpu_id = i;
+        flat_threads[i].cpu_id = cpu_ids[i];
         
-        sprintf(curr_cpu, "cpu%d", i);
-        cpu_path[0] = '\0';
-        strcat(cpu_path, base_path);
-        strcat(cpu_path, "/cpu/");
-        strcat(cpu_path, curr_cpu);
+        sprintf(name, "cpu%d", cpu_ids[i]);
+        dir_fd = _open_dir_at(cpu_fd, name);
+        topo_fd = _open_dir_at(dir_fd, "topology");
+        cache_fd = _open_dir_at(dir_fd, "cache");
+        if ( i == 0 && topo_fd < 0 )
+            fprintf(stderr, "System does not provide processor topology info\n");
        
-        // Get core id
-        path[0] = '\0';
-        strcat(path, cpu_path);
-        strcat(path, "/topology/core_id"); 
-        if ( (fd = open(path, O_RDONLY)) < 0 ) {
-            fprintf(stderr, "Could not open %s\n", path);
-            flat_threads[i].sym_core_id = -1;
-        } else {
-            br = read(fd, buf, 1024);
-            buf[br] = 0;
-            trim(buf, '\n');
-            flat_threads[i].sym_core_id = strtol(buf, NULL, 10);
-        }
-
-        // Get package id
-        path[0] = '\0';
-        strcat(path, cpu_path);
-        strcat(path, "/topology/physical_package_id"); 
-        if ( (fd = open(path, O_RDONLY)) < 0 ) {
-            fprintf(stderr, "Could not open %s\n", path);
-            flat_threads[i].sym_pack_id = -1;
-        } else {
-            br = read(fd, buf, 1024);
-            buf[br] = 0;
-            trim(buf, '\n');
-            flat_threads[i].sym_pack_id = strtol(buf, NULL, 10);
-        }
-
-        // Get core siblings map
-        path[0] = '\0';
-        strcat(path, cpu_path);
-        strcat(path, "/topology/core_siblings"); 
-        if ( (fd = open(path, O_RDONLY)) < 0 ) {
-            fprintf(stderr, "Could not open %s\n", path);
-            flat_threads[i].core_siblings = -1;
-        } else {
-            br = read(fd, buf, 1024);
-            buf[br] = 0;
-            trim(buf, ',');
-            trim(buf, '\n');
-            flat_threads[i].core_siblings = strtol(buf, NULL, 16);
-        }
-
-        // Get thread siblings map
-        path[0] = '\0';
-        strcat(path, cpu_path);
-        strcat(path, "/topology/thread_siblings"); 
-        if ( (fd = open(path, O_RDONLY)) < 0 ) {
-            fprintf(stderr, "Could not open %s\n", path);
-            flat_threads[i].thread_siblings = -1;
-        } else {
-          br = read(fd, buf, 1024);
-            buf[br] = 0;
-            trim(buf, ',');
-            trim(buf, '\n');
-            flat_threads[i].thread_siblings = strtol(buf, NULL, 16);
-        }
+        snprintf(path, sizeof(path), SYSFS_CPU "/%s/topology", name);
+        flat_threads[i].sym_core_id = 
+            _read_long_at(topo_fd, path, "core_id", buf);
+        flat_threads[i].sym_pack_id = 
+            _read_long_at(topo_fd, path, "physical_package_id", buf);
+        flat_threads[i].core_siblings = 
+            _read_cpuset_at(topo_fd, path, "core_siblings", 
+                            "core_siblings_list", buf);
+        flat_threads[i].thread_siblings = 
+            _read_cpuset_at(topo_fd, path, "thread_siblings", 
+                            "thread_siblings_list", buf);
 
         // Get cache info
         flat_threads[i].num_caches = num_caches;
@@ -225,246 +487,43 @@ procmap_t* procmap_init()
             exit(EXIT_FAILURE);
         }
 
-        for ( j = 0; j < num_caches; j++ ) {
-            
-            sprintf(curr_index, "/index%d/", j);
-
-            path[0]='\0';
-            strcat(path, cpu_path);
-            strcat(path, "/cache/");
-            strcat(path, curr_index);
-            strcat(path, "/coherency_line_size");
-            if ( (fd = open(path, O_RDONLY)) < 0 ) {
-                fprintf(stderr, "Could not open %s\n", path);
-                cache[j].coherency_line_size = -1;
-            } else {
-                br = read(fd, buf, 1024);
-                buf[br] = 0;
-                trim(buf, '\n');
-                cache[j].coherency_line_size = strtol(buf, NULL, 10);
-            }
-        
-            path[0]='\0';
-            strcat(path, cpu_path);
-            strcat(path, "/cache/");
-            strcat(path, curr_index);
-            strcat(path, "/level");
-            if ( (fd = open(path, O_RDONLY)) < 0 ) {
-                fprintf(stderr, "Could not open %s\n", path);
-                cache[j].level = -1;
-            } else {
-               br = read(fd, buf, 1024);
-               buf[br] = 0;
-               trim(buf, '\n');
-               cache[j].level = strtol(buf, NULL, 10);
-            }
-
-            path[0]='\0';
-            strcat(path, cpu_path);
-            strcat(path, "/cache/");
-            strcat(path, curr_index);
-            strcat(path, "/number_of_sets");
-            if ( (fd = open(path, O_RDONLY)) < 0 ) {
-                fprintf(stderr, "Could not open %s\n", path);
-                cache[j].number_of_sets = -1;
-            } else {
-                br = read(fd, buf, 1024);
-                buf[br] = 0;
-                trim(buf, '\n');
-                cache[j].number_of_sets = strtol(buf, NULL, 10);
-            }
-
-            path[0]='\0';
-            strcat(path, cpu_path);
-            strcat(path, "/cache/");
-            strcat(path, curr_index);
-            strcat(path, "/physical_line_partition");
-            if ( (fd = open(path, O_RDONLY)) < 0 ) {
-                fprintf(stderr, "Could not open %s\n", path);
-                cache[j].physical_line_partition = -1;
-            } else {
-                br = read(fd, buf, 1024);
-                buf[br] = 0;
-                trim(buf, '\n');
-                cache[j].physical_line_partition = strtol(buf, NULL, 10);
-            }
-
-            path[0]='\0';
-            strcat(path, cpu_path);
-            strcat(path, "/cache/");
-            strcat(path, curr_index);
-            strcat(path, "/shared_cpu_map");
-            if ( (fd = open(path, O_RDONLY)) < 0 ) {
-                fprintf(stderr, "Could not open %s\n", path);
-                cache[j].shared_cpu_map = -1;
-            } else {
-                br = read(fd, buf, 1024);
-                buf[br] = 0;
-                trim(buf, '\n');
-                trim(buf, ',');
-                trim(buf, ',');
-                cache[j].shared_cpu_map = strtol(buf, NULL, 16);
-            }
-
-            path[0] = '\0';
-            strcat(path, cpu_path);
-            strcat(path, "/cache/");
-            strcat(path, curr_index);
-            strcat(path, "/size");
-            if ( (fd = open(path, O_RDONLY)) < 0 ) {
-                fprintf(stderr, "Could not open %s\n", path);
-                cache[j].size = -1;
-            } else {
-                br = read(fd, buf, 1024);
-                buf[br] = 0;
-                trim(buf, '\n');
-                trim(buf, 'K');
-                cache[j].size = strtol(buf, NULL, 10)*1024;
-            }
-
-            path[0] = '\0';
-            strcat(path, cpu_path);
-            strcat(path, "/cache/");
-            strcat(path, curr_index);
-            strcat(path, "/type");
-            if ( (fd = open(path, O_RDONLY)) < 0 ) {
-                fprintf(stderr, "Could not open %s\n", path);
-                sprintf(cache[j].type, "-1");
-            } else {
-                br = read(fd, buf, 1024);
-                buf[br] = 0;
-                trim(buf, '\n');
-                strcpy(cache[j].type, buf); 
-            }
-
-            path[0]='\0';
-            strcat(path, cpu_path);
-            strcat(path, "/cache/");
-            strcat(path, curr_index);
-            strcat(path, "/ways_of_associativity");
-            if ( (fd = open(path, O_RDONLY)) < 0 ) {
-                fprintf(stderr, "Could not open %s\n", path);
-                cache[j].ways_of_associativity = -1;
-            } else {
-                br = read(fd, buf, 1024);
-                buf[br] = 0;
-                trim(buf, '\n');
-                cache[j].ways_of_associativity = strtol(buf, NULL, 10);
-            }
-       
-        } // for each cache
-       
+        snprintf(path, sizeof(path), SYSFS_CPU "/%s/cache", name);
+        _read_caches(cache_fd, path, cache, num_caches, buf);
         flat_threads[i].cache = num_caches > 0 ? cache : NULL;
 
+        _close_fd(cache_fd);
+        _close_fd(topo_fd);
+        _close_fd(dir_fd);
     } // for each cpu
+    close(cpu_fd);
             
-    /* sym_pack_ids: contains all different package symbolic id's 
-     * Its size can be at most num_cpus (i.e. in case each cpu 
-     * constitutes a different package). 
-     * The list of all different package symbolic id's ends either 
-     * when a -1 is found or when we have reached the max number 
-     * of cpus.
+    /*
+     * Symbolic package and core ids are small numbers, possibly with 
+     * gaps: number them in order of first appearance through tables 
+     * indexed by the symbolic id
      */
-    sym_pack_ids = (int*)malloc(num_cpus * sizeof(int));
-    if ( !sym_pack_ids ) {
-        fprintf(stderr, "%s: Allocation error\n", __FUNCTION__);
-        exit(EXIT_FAILURE);
-    }
+    key = (int*)malloc_safe((num_cpus + 1) * sizeof(int));
 
     for ( i = 0; i < num_cpus; i++ )
-        sym_pack_ids[i] = -1;
-
-    // find num_packages and populate sym_pack_ids
-    num_packages = 0;
-
-    for ( i = 0; 
-          i < num_cpus && 
-              (curr_id = flat_threads[i].sym_pack_id) != -1; 
-          i++ ) {
-
-        found_so_far = 0;
-        for ( j = 0; j < i; j++ ) {
-            if ( flat_threads[j].sym_pack_id == curr_id ) {
-                found_so_far = 1;
-                break;
-            }
-        }
-        
-        // new id
-        if ( !found_so_far ) 
-            sym_pack_ids[num_packages++] = curr_id;
-        
-    }
+        key[i] = flat_threads[i].sym_pack_id;
+    num_packages = _renumber(key, num_cpus);
+    for ( i = 0; i < num_cpus; i++ )
+        flat_threads[i].pack_id = key[i];
     pi->num_packages = num_packages;
 
-    // populate pack_ids
-    for ( i = 0; i < num_cpus; i++ ) {
-        flat_threads[i].pack_id = -1;
-
-        for ( j = 0; j < num_cpus; j++ ) {
-            if ( sym_pack_ids[j] == -1 )
-                break;
-            if ( flat_threads[i].sym_pack_id == sym_pack_ids[j] )
-                flat_threads[i].pack_id = j;
-        }
-    }
-
-    /* sym_core_ids: contains all different core symbolic id's
-     * Its size can be at most num_cpus (i.e. in case each cpu 
-     * constitutes a different core). 
-     * The list of all different core symbolic id's ends either
-     * when a -1 is found, or when we have reached the max number 
-     * of cpus
-     */
-    sym_core_ids = (int*)malloc(num_cpus * sizeof(int));
-    if ( !sym_core_ids ) {
-        fprintf(stderr, "%s: Allocation error\n", __FUNCTION__);
-        exit(EXIT_FAILURE);
-    }
-
     for ( i = 0; i < num_cpus; i++ )
-        sym_core_ids[i] = -1;
-
-    // find num_cores_per_package and populate sym_core_ids
-    num_cores_per_package = 0;
-    
-    for ( i = 0; 
-          i < num_cpus && (curr_id = flat_threads[i].sym_core_id) != -1;
-          i++ ) {
-
-        found_so_far = 0;
-        for ( j = 0; j < i; j++ ) {
-            if ( flat_threads[j].sym_core_id == curr_id ) {
-                found_so_far = 1;
-                break;
-            }
-        }
-
-        // new id
-        if ( !found_so_far ) 
-            sym_core_ids[num_cores_per_package++] = curr_id;
-    }
+        key[i] = flat_threads[i].sym_core_id;
+    num_cores_per_package = _renumber(key, num_cpus);
+    for ( i = 0; i < num_cpus; i++ )
+        flat_threads[i].core_id = key[i];
     pi->num_cores_per_package = num_cores_per_package;
 
-    // populate core_ids
-    for ( i = 0; i < num_cpus; i++ ) {
-        flat_threads[i].core_id = -1;
-
-        for ( j = 0; j < num_cpus; j++ ) {
-            if ( sym_core_ids[j] == -1 ) 
-                break;
-            if ( flat_threads[i].sym_core_id == sym_core_ids[j] )
-                flat_threads[i].core_id = j;
-        }
-    }
+    free(key);
 
     // find num_threads_per_core 
     // check the first cpu for additional thread siblings
-    num_threads_per_core = 0;
-    for ( i = 0; i < num_cpus; i++ ) {
-        if ( (1<<i) & flat_threads[0].thread_siblings )
-            num_threads_per_core++;
-    }
+    num_threads_per_core = num_cpus > 0 ? 
+                           cpuset_count(flat_threads[0].thread_siblings) : 0;
     pi->num_threads_per_core = num_threads_per_core;
     
     /* 
@@ -474,22 +533,11 @@ procmap_t* procmap_init()
      * and cpu 3 will be "thread 1"
      */
     for ( i = 0; i < num_cpus; i++ ) {
-        flat_threads[i].thread_id = -1;
-        int bits_set_so_far = 0;
-        int siblings = flat_threads[i].thread_siblings; 
-
-        if ( siblings != -1 ) {
-            for ( j = 0; j < num_cpus; j++ ) {
-               // if bit 'j' is set 
-               if ( siblings & 1 ) {
-                   // if it is my bit... 
-                   if ( j == i )
-                       flat_threads[i].thread_id = bits_set_so_far;
-                   bits_set_so_far++;
-               }
-               siblings >>= 1;
-            }
-        }
+        cpuset_t *siblings = flat_threads[i].thread_siblings; 
+
+        flat_threads[i].thread_id = 
+            cpuset_isset(siblings, flat_threads[i].cpu_id) ?
+            cpuset_rank(siblings, flat_threads[i].cpu_id) : -1;
     }
 
     /*
@@ -512,34 +560,37 @@ procmap_t* procmap_init()
             exit(EXIT_FAILURE);
         }
         
+        package[i].sym_pack_id = -1;
         package[i].core = num_cores_per_package > 0 ? core : NULL;
 
         for ( j = 0; j < num_cores_per_package; j++ ) {
-            threadinfo_t **cthread = (threadinfo_t**)malloc(
-                                                      num_threads_per_core *
+            threadinfo_t **cthread = (threadinfo_t**)calloc(
+                                                      num_threads_per_core,
                                                       sizeof(threadinfo_t*));
             if ( !cthread ) {
                 fprintf(stderr, "%s: Allocation error\n", __FUNCTION__);
                 exit(EXIT_FAILURE);
             }
 
+            core[j].sym_core_id = -1;
             core[j].thread = num_threads_per_core > 0 ? cthread : NULL;
-
-            for ( k = 0; k < num_threads_per_core; k++ ) {
-                for ( l = 0; l < num_cpus; l++ ) {
-                    if ( flat_threads[l].pack_id == i && 
-                         flat_threads[l].core_id == j &&
-                         flat_threads[l].thread_id == k ) {
-
-                        core[j].thread[k] = &flat_threads[l];
-                        core[j].sym_core_id = flat_threads[l].sym_core_id;
-                        package[i].sym_pack_id = flat_threads[l].sym_pack_id;
-                    }
-                }
-            } // for all threads of core
         } // for all cores of package
     } // for all packages
 
+    // place each thread directly
+    for ( l = 0; l < num_cpus; l++ ) {
+        threadinfo_t *t = &flat_threads[l];
+
+        if ( t->pack_id < 0 || t->core_id < 0 || t->thread_id < 0 ||
+             t->thread_id >= num_threads_per_core )
+            continue;
+
+        core = &package[t->pack_id].core[t->core_id];
+        core->thread[t->thread_id] = t;
+        core->sym_core_id = t->sym_core_id;
+        package[t->pack_id].sym_pack_id = t->sym_pack_id;
+    }
+
     /*
      * memnode info
      */ 
@@ -552,48 +603,45 @@ procmap_t* procmap_init()
 
     pi->memnode = num_memnodes > 0 ? memnode : NULL;
 
+    node_fd = open(SYSFS_NODE, O_RDONLY | O_DIRECTORY);
     for ( i = 0; i < num_memnodes; i++ ) {
-        sprintf(curr_node, "node%d", i);
-
-        path[0] = '\0';
-        strcat(path, base_path);
-        strcat(path, "/node/");
-        strcat(path, curr_node);
-        strcat(path, "/cpumap");
-        if ( (fd = open(path, O_RDONLY)) < 0 ) {
-            fprintf(stderr, "Could not open %s\n", path);
-            memnode[i].cpumap = -1;
-        } else {
-            br = read(fd, buf, 1024);
-            buf[br] = 0;
-            trim(buf, ',');
-            trim(buf, '\n');
-            memnode[i].cpumap = strtol(buf, NULL, 16);
-        }
+        sprintf(name, "node%d", node_ids[i]);
+        snprintf(path, sizeof(path), SYSFS_NODE "/%s", name);
+        dir_fd = _open_dir_at(node_fd, name);
 
-        path[0] = '\0';
-        strcat(path, base_path);
-        strcat(path, "/node/");
-        strcat(path, curr_node);
-        strcat(path, "/meminfo");
-        if ( (fd = open(path, O_RDONLY)) < 0 ) {
-            fprintf(stderr, "Could not open %s\n", path);
-            memnode[i].size = -1;
+        memnode[i].cpumap = _read_cpuset_at(dir_fd, path, "cpumap", 
+                                            "cpulist", buf);
+
+        if ( _read_at(dir_fd, "meminfo", buf) < 0 ) {
+            fprintf(stderr, "Could not open %s/meminfo\n", path);
+            memnode[i].size = 0;
         } else {
-            br = read(fd, buf, 1024);
-            buf[br] = 0;
             char *ptr = strstr(buf, "MemTotal:");
-            while ( *ptr++ != ':' );
-            memnode[i].size = strtol(ptr, NULL, 10) * 1024;
+            memnode[i].size = ptr ? 
+                strtoul(ptr + strlen("MemTotal:"), NULL, 10) * 1024 : 0;
         }
+
+        _close_fd(dir_fd);
     } // for all memnodes
+    _close_fd(node_fd);
+
+    _build_domains(pi);
 
-    free(sym_pack_ids);
-    free(sym_core_ids);
+    free(cpu_ids);
+    free(node_ids);
 
     return pi;
 }
 
+/**
+ * @return 1 if cpu is the only member of a cache's sharer set
+ */
+static int _is_private(const cpuset_t *shared_cpu_map, int cpu)
+{
+    return cpuset_count(shared_cpu_map) == 1 && 
+           cpuset_isset(shared_cpu_map, cpu);
+}
+
 /**
  * Reports info
  * @param pi handle to the procmap structure
@@ -602,7 +650,7 @@ void procmap_report(procmap_t *pi)
 {
     assert(pi);
 
-    int i, j, k, l, m, num_cpus = pi->num_cpus;
+    int i, j, k, l, m;
 
     fprintf(stdout, "General Info\n");
     fprintf(stdout, "---------------------\n");
@@ -631,17 +679,15 @@ void procmap_report(procmap_t *pi)
              
              assert(cache);
              int level = cache->level;
-             int shared_cpu_map = cache->shared_cpu_map;
+             cpuset_t *shared_cpu_map = cache->shared_cpu_map;
              type = cache->type[0];
-             if ( (1<<myid) == shared_cpu_map ) {
+             if ( _is_private(shared_cpu_map, myid) ) {
                 fprintf(stdout, " L%d%c_pr", level, type);
              } else {
                  fprintf(stdout, " L%d%c_sh(", level, type);
-                 for ( m = 0; m < num_cpus; m++ ) {
-                     if ( shared_cpu_map & 1 )
-                         fprintf(stdout, "%d ", m); 
-                     shared_cpu_map >>=1;
-                 }
+                 for ( m = cpuset_first(shared_cpu_map); m >= 0; 
+                       m = cpuset_next(shared_cpu_map, m) )
+                     fprintf(stdout, "%d ", m); 
                  fprintf(stdout, ")");
              }
          }
@@ -680,19 +726,17 @@ void procmap_report(procmap_t *pi)
                     assert(cache);
 
                     int level = cache->level;
-                    int shared_cpu_map = cache->shared_cpu_map;
+                    cpuset_t *shared_cpu_map = cache->shared_cpu_map;
                     strcpy(type, cache->type);
-                    if ( (1<<myid) == shared_cpu_map ) {
+                    if ( _is_private(shared_cpu_map, myid) ) {
                         fprintf(stdout, "\n              L%d %s (priv)", 
                                         level, type);
                     } else {
                         fprintf(stdout, "\n              L%d %s (shared between ", 
                                         level, type);
-                        for ( m = 0; m < num_cpus; m++ ) {
-                            if ( shared_cpu_map & 1 )
-                                fprintf(stdout, "%d ", m); 
-                            shared_cpu_map >>=1;
-                        }
+                        for ( m = cpuset_first(shared_cpu_map); m >= 0; 
+                              m = cpuset_next(shared_cpu_map, m) )
+                            fprintf(stdout, "%d ", m); 
                         fprintf(stdout, ")");
                     }
                 }
@@ -711,20 +755,17 @@ void procmap_report(procmap_t *pi)
     fprintf(stdout, "---------------------\n");
 
     for ( i = 0; i < pi->num_memnodes; i++ ) {
-        int cpumap = pi->memnode[i].cpumap; 
+        cpuset_t *cpumap = pi->memnode[i].cpumap; 
         fprintf(stdout, "Numa node %d (size %lu) local to cpus ", 
                 i, pi->memnode[i].size);
-        for ( j = 0; j < num_cpus; j++ ) {
-            if ( cpumap &1 )
-                fprintf(stdout, "%d ", j);
-            cpumap >>= 1;
-        }
+        for ( j = cpuset_first(cpumap); j >= 0; j = cpuset_next(cpumap, j) )
+            fprintf(stdout, "%d ", j);
         fprintf(stdout, "\n");
     }
     fprintf(stdout, "\n\n");
 
     cacheinfo_t *caches = pi->package[0].core[0].thread[0]->cache;
-    for ( i = 0; i < _get_num_caches(); i++ ) {
+    for ( i = 0; i < pi->num_caches_per_thread; i++ ) {
         fprintf(stdout, "Cache %d\n", i);
         fprintf(stdout, "  type: L%d %s\n", 
                 caches[i].level, caches[i].type);
@@ -749,10 +790,25 @@ void procmap_destroy(procmap_t *pi)
 {
     int i, j;
 
+    for ( i = 0; i < PROCMAP_NUM_LEVELS; i++ ) {
+        free(pi->domain[i].of_cpu);
+        free(pi->domain[i].start);
+        free(pi->domain[i].cpus);
+    }
+    free(pi->cpu_index);
+
+    for ( i = 0; i < pi->num_memnodes; i++ )
+        cpuset_free(pi->memnode[i].cpumap);
     free(pi->memnode);
    
     for ( i = 0; i < pi->num_cpus; i++ ) {
-        free(pi->flat_threads[i].cache);
+        threadinfo_t *t = &pi->flat_threads[i];
+
+        for ( j = 0; j < t->num_caches; j++ )
+            cpuset_free(t->cache[j].shared_cpu_map);
+        free(t->cache);
+        cpuset_free(t->core_siblings);
+        cpuset_free(t->thread_siblings);
     }
     free(pi->flat_threads);
 
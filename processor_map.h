@@ -7,6 +7,8 @@
 #ifndef PROCESSOR_MAP_H_
 #define PROCESSOR_MAP_H_
 
+#include "cpuset.h"
+
 /**
  * Cache info 
  */ 
@@ -15,8 +17,8 @@ typedef struct {
     int level;
     int number_of_sets;
     int physical_line_partition;
-    int shared_cpu_map; //!< map of sharers
-    unsigned long size; //!< size in bytes
+    cpuset_t *shared_cpu_map; //!< cpus sharing this cache
+    unsigned long size; //!< size in bytes, 0 if unknown
     char type[32];
     int ways_of_associativity;
 } cacheinfo_t;
@@ -58,16 +60,15 @@ typedef struct {
     //! packages in the system
     int pack_id;
 
-    //! Bitmap in hex format that shows the core siblings of the 
-    //! current cpu. All cpus belonging to the same package (i.e. 
-    //! are core siblings) have their corresponding bits (indexed by 
-    //! their cpu_id) set in the mask
-    int core_siblings;
+    //! Set of the core siblings of the current cpu. All cpus 
+    //! belonging to the same package (i.e. are core siblings) 
+    //! are members of the set (indexed by their cpu_id)
+    cpuset_t *core_siblings;
 
-    //! Bitmap in hex format that shows the thread siblings of the 
-    //! current cpu, i.e. shows which other cpu_ids are threads 
-    //! belonging to the same package 
-    int thread_siblings;
+    //! Set of the thread siblings of the current cpu, i.e. 
+    //! shows which other cpu_ids are threads belonging to the 
+    //! same core
+    cpuset_t *thread_siblings;
 
     //! Number of different caches (shared or not) that this
     //! thread sees.
@@ -100,14 +101,48 @@ typedef struct {
  * Memory node info
  */
 typedef struct {
-    //! Bitmap that shows which cpu_ids are local to 
+    //! Set of the cpu_ids that are local to 
     //! this memory node
-    int cpumap;     
+    cpuset_t *cpumap;     
 
-    //! Size in bytes of this memory node
+    //! Size in bytes of this memory node, 0 if unknown
     unsigned long size;
 } memnodeinfo_t;
 
+/**
+ * Topology levels, from the finest to the coarsest.
+ * Cache levels group the cpus sharing a data (or unified) cache.
+ */
+typedef enum {
+    PROCMAP_LEVEL_THREAD,
+    PROCMAP_LEVEL_CORE,
+    PROCMAP_LEVEL_L1,
+    PROCMAP_LEVEL_L2,
+    PROCMAP_LEVEL_L3,
+    PROCMAP_LEVEL_NODE,
+    PROCMAP_LEVEL_PACKAGE,
+    PROCMAP_LEVEL_SYSTEM,
+    PROCMAP_NUM_LEVELS
+} procmap_level_t;
+
+/**
+ * The domains (cores, caches, nodes...) of one topology level.
+ * Domains are numbered 0..num-1: cores and packages as core and
+ * package ids go, nodes as memnode indices, caches in cpu order.
+ */
+typedef struct {
+    //! Number of domains (0 if the system does not report the level)
+    int num;
+
+    //! Domain of each cpu, indexed like flat_threads (-1: unknown)
+    int *of_cpu;
+
+    //! The cpu_ids of domain d are cpus[start[d]] .. 
+    //! cpus[start[d+1]-1], in increasing order
+    int *start;
+    int *cpus;
+} procmap_domains_t;
+
 /**
  * Processor hierarchy info.
  * The hierarchy starts with one or more 
@@ -135,10 +170,122 @@ typedef struct {
 
     //! Memory nodes of the system
     memnodeinfo_t *memnode;
+
+    //! Largest cpu_id + 1
+    int cpu_id_limit;
+
+    //! flat_threads index of each cpu_id (-1: not present)
+    int *cpu_index;
+
+    //! Domains of each topology level
+    procmap_domains_t domain[PROCMAP_NUM_LEVELS];
 } procmap_t;
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 procmap_t* procmap_init(void); 
 void procmap_report(procmap_t *pi);
 void procmap_destroy(procmap_t *pi);
 
+#ifdef __cplusplus
+}
+#endif
+
+/*
+ * Constant-time topology queries. cpu arguments are cpu_ids (as used
+ * by affinity syscalls); unknown cpus and unreported levels give -1,
+ * or 0 cpus.
+ */
+
+//! @return flat_threads index of cpu, -1 if there is no such cpu
+static inline int procmap_cpu_index(const procmap_t *pi, int cpu)
+{
+    return cpu >= 0 && cpu < pi->cpu_id_limit ? pi->cpu_index[cpu] : -1;
+}
+
+//! @return hw thread info of cpu, NULL if there is no such cpu
+static inline threadinfo_t* procmap_thread(const procmap_t *pi, int cpu)
+{
+    int i = procmap_cpu_index(pi, cpu);
+    return i < 0 ? (threadinfo_t*)0 : &pi->flat_threads[i];
+}
+
+//! @return domain of cpu at a level
+static inline int procmap_domain_of(const procmap_t *pi, int cpu, 
+                                    procmap_level_t level)
+{
+    int i = procmap_cpu_index(pi, cpu);
+    return i < 0 ? -1 : pi->domain[level].of_cpu[i];
+}
+
+//! @return system-wide core number of cpu
+static inline int procmap_core_of(const procmap_t *pi, int cpu)
+{
+    return procmap_domain_of(pi, cpu, PROCMAP_LEVEL_CORE);
+}
+
+//! @return package (pack_id) of cpu
+static inline int procmap_package_of(const procmap_t *pi, int cpu)
+{
+    return procmap_domain_of(pi, cpu, PROCMAP_LEVEL_PACKAGE);
+}
+
+//! @return memory node (memnode index) of cpu
+static inline int procmap_node_of(const procmap_t *pi, int cpu)
+{
+    return procmap_domain_of(pi, cpu, PROCMAP_LEVEL_NODE);
+}
+
+//! @return domain of the level 1-3 data/unified cache of cpu
+static inline int procmap_cache_domain_of(const procmap_t *pi, int cpu, 
+                                          int cache_level)
+{
+    if ( cache_level < 1 || cache_level > 3 )
+        return -1;
+    return procmap_domain_of(pi, cpu, 
+               (procmap_level_t)(PROCMAP_LEVEL_L1 + cache_level - 1));
+}
+
+/**
+ * cpus of a domain
+ * @param cpus set to the cpu_ids of the domain (increasing)
+ * @return number of cpus
+ */
+static inline int procmap_domain_cpus(const procmap_t *pi, 
+                                      procmap_level_t level, int d, 
+                                      const int **cpus)
+{
+    const procmap_domains_t *dom = &pi->domain[level];
+
+    if ( d < 0 || d >= dom->num ) {
+        *cpus = (const int*)0;
+        return 0;
+    }
+    *cpus = dom->cpus + dom->start[d];
+    return dom->start[d + 1] - dom->start[d];
+}
+
+/**
+ * cpus in the same domain as cpu at a level (cpu included)
+ * @see procmap_domain_cpus
+ */
+static inline int procmap_siblings(const procmap_t *pi, int cpu, 
+                                   procmap_level_t level, const int **cpus)
+{
+    return procmap_domain_cpus(pi, level, procmap_domain_of(pi, cpu, level),
+                               cpus);
+}
+
+/**
+ * cpus local to a memory node
+ * @see procmap_domain_cpus
+ */
+static inline int procmap_node_cpus(const procmap_t *pi, int node, 
+                                    const int **cpus)
+{
+    return procmap_domain_cpus(pi, PROCMAP_LEVEL_NODE, node, cpus);
+}
+
 #endif
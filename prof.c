@@ -0,0 +1,225 @@
+/**
+ * @file
+ * Hierarchical profiling zones: zone registry, per-thread trees and
+ * merged reporting
+ */
+#define _GNU_SOURCE
+
+#include "prof.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "util.h"
+
+__thread prof_thread_t *_prof_self = NULL;
+
+static pthread_mutex_t _prof_lock = PTHREAD_MUTEX_INITIALIZER;
+static prof_thread_t *_prof_threads = NULL;
+static char **_prof_names = NULL;
+static uint32_t _prof_num_names = 0;
+
+/**
+ * Node of the merged (all-threads) tree
+ */
+typedef struct merged_node {
+    uint32_t zone;
+    uint64_t total;
+    uint64_t invocs;
+    int num_children;
+    struct merged_node **children;
+} merged_node_t;
+
+/**
+ * Registers a zone name. Registering the same name twice returns
+ * the same id, so zones opened at different sites merge.
+ * @param name zone name (copied)
+ * @return zone id (never 0)
+ */
+uint32_t prof_zone_register(const char *name)
+{
+    uint32_t i;
+
+    pthread_mutex_lock(&_prof_lock);
+    for ( i = 0; i < _prof_num_names; i++ ) {
+        if ( !strcmp(_prof_names[i], name) ) {
+            pthread_mutex_unlock(&_prof_lock);
+            return i + 1;
+        }
+    }
+
+    _prof_names = (char**)realloc(_prof_names,
+                                  (_prof_num_names + 1) * sizeof(char*));
+    if ( !_prof_names ) {
+        fprintf(stderr, "%s: Allocation error\n", __FUNCTION__);
+        exit(EXIT_FAILURE);
+    }
+    _prof_names[_prof_num_names++] = strdup(name);
+    i = _prof_num_names;
+    pthread_mutex_unlock(&_prof_lock);
+
+    return i;
+}
+
+/**
+ * Creates the calling thread's zone tree and registers it
+ * @return the thread's profiling state
+ */
+prof_thread_t* prof_thread_init(void)
+{
+    prof_thread_t *t;
+
+    if ( _prof_self )
+        return _prof_self;
+
+    t = (prof_thread_t*)malloc_safe(sizeof(prof_thread_t));
+    memset(t, 0, sizeof(*t));
+    t->cur = &t->root;
+    t->tid = (int)syscall(SYS_gettid);
+
+    pthread_mutex_lock(&_prof_lock);
+    t->next = _prof_threads;
+    _prof_threads = t;
+    pthread_mutex_unlock(&_prof_lock);
+
+    _prof_self = t;
+    return t;
+}
+
+/**
+ * Adds a zone node under a parent (first entry of a zone at a given
+ * call path)
+ * @param parent parent node
+ * @param zone zone id
+ * @return new node
+ */
+prof_node_t* prof_child_new(prof_node_t *parent, uint32_t zone)
+{
+    prof_node_t *n = (prof_node_t*)malloc_safe(sizeof(prof_node_t));
+
+    memset(n, 0, sizeof(*n));
+    n->zone = zone;
+    n->parent = parent;
+    n->sibling = parent->child;
+
+    // The reporter may walk this tree concurrently: link the node
+    // only after it is fully initialized
+    __asm__ __volatile__ ("" : : : "memory");
+    parent->child = n;
+
+    return n;
+}
+
+static void _merge(merged_node_t *dst, prof_node_t *src)
+{
+    prof_node_t *c;
+    merged_node_t *d;
+    int i;
+
+    dst->total += src->timer.total;
+    dst->invocs += src->timer.invocs;
+
+    for ( c = src->child; c; c = c->sibling ) {
+        d = NULL;
+        for ( i = 0; i < dst->num_children; i++ ) {
+            if ( dst->children[i]->zone == c->zone ) {
+                d = dst->children[i];
+                break;
+            }
+        }
+        if ( !d ) {
+            d = (merged_node_t*)malloc_safe(sizeof(merged_node_t));
+            memset(d, 0, sizeof(*d));
+            d->zone = c->zone;
+            dst->children = (merged_node_t**)realloc(dst->children,
+                                (dst->num_children + 1) *
+                                sizeof(merged_node_t*));
+            if ( !dst->children ) {
+                fprintf(stderr, "%s: Allocation error\n", __FUNCTION__);
+                exit(EXIT_FAILURE);
+            }
+            dst->children[dst->num_children++] = d;
+        }
+        _merge(d, c);
+    }
+}
+
+static int _cmp_total(const void *a, const void *b)
+{
+    const merged_node_t *x = *(merged_node_t* const*)a,
+                        *y = *(merged_node_t* const*)b;
+    return (x->total < y->total) - (x->total > y->total);
+}
+
+static void _print(FILE *fp, merged_node_t *n, int depth, double grand)
+{
+    uint64_t children = 0, excl;
+    int i;
+
+    for ( i = 0; i < n->num_children; i++ )
+        children += n->children[i]->total;
+    excl = n->total > children ? n->total - children : 0;
+
+    fprintf(fp, "%*s%-*s %10lu %16lu %6.2f%% %16lu %6.2f%% %12.1f\n",
+            2 * depth, "", 32 - 2 * depth, _prof_names[n->zone - 1],
+            (unsigned long)n->invocs,
+            (unsigned long)n->total, 100.0 * n->total / grand,
+            (unsigned long)excl, 100.0 * excl / grand,
+            n->invocs ? (double)n->total / n->invocs : 0.0);
+
+    qsort(n->children, n->num_children, sizeof(merged_node_t*), _cmp_total);
+    for ( i = 0; i < n->num_children; i++ )
+        _print(fp, n->children[i], depth + 1, grand);
+}
+
+static void _free(merged_node_t *n)
+{
+    int i;
+
+    for ( i = 0; i < n->num_children; i++ )
+        _free(n->children[i]);
+    free(n->children);
+    free(n);
+}
+
+/**
+ * Merges the zone trees of all threads and prints inclusive and
+ * exclusive cycles per zone path.
+ * May be called while threads are running; zones still open are
+ * not accounted for.
+ * @param fp output stream
+ */
+void prof_report(FILE *fp)
+{
+    merged_node_t *root;
+    prof_thread_t *t;
+    double grand = 0.0;
+    int i, nthreads = 0;
+
+    root = (merged_node_t*)malloc_safe(sizeof(merged_node_t));
+    memset(root, 0, sizeof(*root));
+
+    pthread_mutex_lock(&_prof_lock);
+    for ( t = _prof_threads; t; t = t->next, nthreads++ )
+        _merge(root, &t->root);
+
+    for ( i = 0; i < root->num_children; i++ )
+        grand += root->children[i]->total;
+    if ( grand == 0.0 )
+        grand = 1.0;
+
+    fprintf(fp, "Profile (%d threads, cycles)\n", nthreads);
+    fprintf(fp, "%-32s %10s %16s %7s %16s %7s %12s\n",
+            "Zone", "calls", "inclusive", "", "exclusive", "", "per call");
+    qsort(root->children, root->num_children, sizeof(merged_node_t*),
+          _cmp_total);
+    for ( i = 0; i < root->num_children; i++ )
+        _print(fp, root->children[i], 0, grand);
+    pthread_mutex_unlock(&_prof_lock);
+
+    _free(root);
+}
@@ -0,0 +1,134 @@
+/**
+ * @file
+ * Hierarchical named profiling zones.
+ *
+ * Zones nest: each thread keeps its own call tree of zones, and every
+ * node accumulates cycles and invocations in a tsctimer_t. The hot
+ * path touches only thread-local data. prof_report() merges the trees
+ * of all threads into one tree with inclusive and exclusive times.
+ *
+ * In C, bracket a region with PROF_BEGIN("name") / PROF_END().
+ * In C++, PROF_SCOPE("name") closes the zone at the end of the scope.
+ * Compiling with -DPROF_DISABLE removes all instrumentation.
+ */
+
+#ifndef PROF_H_
+#define PROF_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "tsc_x86_64.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Node of a per-thread zone tree
+ */
+typedef struct prof_node {
+    uint32_t zone;             //!< zone id, 0 for the root
+    struct prof_node *parent;
+    struct prof_node *child;   //!< first child
+    struct prof_node *sibling; //!< next child of the same parent
+    tsctimer_t timer;
+} prof_node_t;
+
+/**
+ * Per-thread profiling state
+ */
+typedef struct prof_thread {
+    prof_node_t root;
+    prof_node_t *cur;          //!< innermost open zone
+    int tid;
+    struct prof_thread *next;  //!< next thread in the global registry
+} prof_thread_t;
+
+extern __thread prof_thread_t *_prof_self;
+
+uint32_t prof_zone_register(const char *name);
+prof_thread_t* prof_thread_init(void);
+prof_node_t* prof_child_new(prof_node_t *parent, uint32_t zone);
+void prof_report(FILE *fp);
+
+/**
+ * Opens a zone nested in the innermost open zone of this thread
+ * @param zone zone id, as returned by prof_zone_register()
+ */
+static inline void prof_begin(uint32_t zone)
+{
+    prof_thread_t *t = _prof_self;
+    prof_node_t *n;
+
+    if ( __builtin_expect(!t, 0) )
+        t = prof_thread_init();
+
+    for ( n = t->cur->child; n && n->zone != zone; n = n->sibling ) ;
+    if ( __builtin_expect(!n, 0) )
+        n = prof_child_new(t->cur, zone);
+
+    t->cur = n;
+    timer_start(&n->timer);
+}
+
+/**
+ * Closes the innermost open zone of this thread
+ */
+static inline void prof_end(void)
+{
+    prof_thread_t *t = _prof_self;
+    prof_node_t *n = t->cur;
+
+    timer_stop(&n->timer);
+    t->cur = n->parent;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#define PROF_CAT_(a, b) a##b
+#define PROF_CAT(a, b) PROF_CAT_(a, b)
+
+#ifndef PROF_DISABLE
+
+#define PROF_BEGIN(name)                                     \
+    do {                                                     \
+        static uint32_t _prof_zid = 0;                       \
+        if ( __builtin_expect(!_prof_zid, 0) )               \
+            _prof_zid = prof_zone_register(name);            \
+        prof_begin(_prof_zid);                               \
+    } while (0)
+
+#define PROF_END() prof_end()
+
+#ifdef __cplusplus
+/**
+ * Scoped zone: opened on construction, closed on destruction
+ */
+class prof_scope {
+public:
+    explicit prof_scope(uint32_t zone) { prof_begin(zone); }
+    ~prof_scope() { prof_end(); }
+private:
+    prof_scope(const prof_scope&);
+    prof_scope& operator=(const prof_scope&);
+};
+
+#define PROF_SCOPE(name)                                            \
+    static const uint32_t PROF_CAT(_prof_zid_, __LINE__) =          \
+        prof_zone_register(name);                                   \
+    prof_scope PROF_CAT(_prof_scope_, __LINE__)(                    \
+        PROF_CAT(_prof_zid_, __LINE__))
+#endif
+
+#else
+
+#define PROF_BEGIN(name) do { } while (0)
+#define PROF_END() do { } while (0)
+#define PROF_SCOPE(name) do { } while (0)
+
+#endif
+
+#endif
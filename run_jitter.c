@@ -0,0 +1,257 @@
+/**
+ * @file
+ * Detects OS jitter (interrupts, kernel housekeeping, preemption) by
+ * spinning on the TSC on every selected cpu and recording each gap
+ * between consecutive reads that exceeds a threshold
+ */
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "processor_map.h"
+#include "tsc_x86_64.h"
+#include "util.h"
+
+//! Number of log2 histogram buckets, starting at the threshold
+#define JITTER_BUCKETS 20
+
+//! Gaps kept per cpu for percentiles and the verbose dump
+#define JITTER_MAX_GAPS 100000
+
+typedef struct {
+    uint64_t tsc;  //!< when the gap started
+    uint64_t len;  //!< gap length in cycles
+} gap_t;
+
+typedef struct {
+    int cpu;
+    uint64_t start, end;
+    uint64_t threshold;
+    unsigned long count;          //!< gaps above threshold
+    uint64_t lost;                //!< sum of gap lengths
+    uint64_t max;
+    unsigned long hist[JITTER_BUCKETS];
+    gap_t *gaps;
+    unsigned long ngaps;          //!< gaps stored (<= JITTER_MAX_GAPS)
+} __attribute__((aligned(64))) jitter_t;
+
+static pthread_barrier_t bar;
+static uint64_t duration_cycles;
+
+static void* jitter_fun(void *args)
+{
+    jitter_t *j = (jitter_t*)args;
+    uint64_t prev, now, gap, end, thr = j->threshold;
+    int b;
+
+    // Touch the gap buffer before measuring
+    memset(j->gaps, 0, JITTER_MAX_GAPS * sizeof(gap_t));
+
+    pthread_barrier_wait(&bar);
+
+    prev = j->start = timer_read();
+    end = j->start + duration_cycles;
+    while ( prev < end ) {
+        now = timer_read();
+        gap = now - prev;
+        if ( __builtin_expect(gap > thr, 0) ) {
+            j->count++;
+            j->lost += gap;
+            if ( gap > j->max )
+                j->max = gap;
+            for ( b = 0; b < JITTER_BUCKETS - 1 && gap >= (thr << (b+1));
+                  b++ ) ;
+            j->hist[b]++;
+            if ( j->ngaps < JITTER_MAX_GAPS ) {
+                j->gaps[j->ngaps].tsc = prev;
+                j->gaps[j->ngaps].len = gap;
+                j->ngaps++;
+            }
+        }
+        prev = now;
+    }
+    j->end = prev;
+
+    return NULL;
+}
+
+static int cmp_gap_len(const void *a, const void *b)
+{
+    uint64_t x = ((const gap_t*)a)->len, y = ((const gap_t*)b)->len;
+    return (x > y) - (x < y);
+}
+
+static int cmp_gap_tsc(const void *a, const void *b)
+{
+    uint64_t x = ((const gap_t*)a)->tsc, y = ((const gap_t*)b)->tsc;
+    return (x > y) - (x < y);
+}
+
+static int cmp_lost(const void *a, const void *b)
+{
+    const jitter_t *x = *(jitter_t* const*)a, *y = *(jitter_t* const*)b;
+    return (x->lost > y->lost) - (x->lost < y->lost);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-c cpu,cpu,...] [-d seconds] "
+                    "[-t threshold_ns] [-v]\n"
+                    "  -c  cpus to test (default: all)\n"
+                    "  -d  test duration (default 5s)\n"
+                    "  -t  report gaps longer than this (default 1000ns)\n"
+                    "  -v  dump every recorded gap\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    procmap_t *pi;
+    jitter_t *jit, **order;
+    pthread_attr_t attr;
+    pthread_t *tids;
+    cpu_set_t set;
+    char *cpus = NULL, *tok;
+    double hz, secs = 5.0, thr_ns = 1000.0, ns_per_cycle;
+    int c, i, b, ncpus = 0, verbose = 0;
+    unsigned long k;
+
+    while ( (c = getopt(argc, argv, "c:d:t:v")) != -1 ) {
+        switch ( c ) {
+        case 'c': cpus = optarg; break;
+        case 'd': secs = atof(optarg); break;
+        case 't': thr_ns = atof(optarg); break;
+        case 'v': verbose = 1; break;
+        default: usage(argv[0]);
+        }
+    }
+
+    pi = procmap_init();
+    hz = timer_calibrate_hz(20000);
+    ns_per_cycle = 1e9 / hz;
+    duration_cycles = (uint64_t)(secs * hz);
+
+    if ( posix_memalign((void**)&jit, 64, 
+                        (pi->num_cpus + 1) * sizeof(jitter_t)) ) {
+        fprintf(stderr, "%s: Allocation error\n", __FUNCTION__);
+        exit(EXIT_FAILURE);
+    }
+    memset(jit, 0, (pi->num_cpus + 1) * sizeof(jitter_t));
+
+    if ( cpus ) {
+        for ( tok = strtok(cpus, ","); tok; tok = strtok(NULL, ",") ) {
+            char *end;
+            long cpu = strtol(tok, &end, 10);
+
+            if ( end == tok || *end || procmap_cpu_index(pi, cpu) < 0 ) {
+                fprintf(stderr, "Skipping cpu '%s': not present\n", tok);
+                continue;
+            }
+            if ( ncpus < pi->num_cpus )
+                jit[ncpus++].cpu = (int)cpu;
+        }
+    } else {
+        for ( i = 0; i < pi->num_cpus; i++ )
+            jit[ncpus++].cpu = pi->flat_threads[i].cpu_id;
+    }
+
+    if ( ncpus == 0 ) {
+        fprintf(stderr, "No cpus to test\n");
+        free(jit);
+        procmap_destroy(pi);
+        usage(argv[0]);
+    }
+
+    tids = (pthread_t*)malloc_safe(ncpus * sizeof(pthread_t));
+    order = (jitter_t**)malloc_safe(ncpus * sizeof(jitter_t*));
+    if ( pthread_barrier_init(&bar, NULL, ncpus) ) {
+        fprintf(stderr, "Could not initialize barrier\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for ( i = 0; i < ncpus; i++ ) {
+        jit[i].threshold = (uint64_t)(thr_ns / ns_per_cycle);
+        if ( !jit[i].threshold )
+            jit[i].threshold = 1;
+        jit[i].gaps = (gap_t*)malloc_safe(JITTER_MAX_GAPS * sizeof(gap_t));
+
+        CPU_ZERO(&set);
+        CPU_SET(jit[i].cpu, &set);
+        pthread_attr_init(&attr);
+        pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+        if ( pthread_create(&tids[i], &attr, jitter_fun, &jit[i]) ) {
+            fprintf(stderr, "Could not start thread on cpu %d\n", jit[i].cpu);
+            exit(EXIT_FAILURE);
+        }
+        pthread_attr_destroy(&attr);
+    }
+    for ( i = 0; i < ncpus; i++ )
+        pthread_join(tids[i], NULL);
+    pthread_barrier_destroy(&bar);
+
+    printf("OS jitter: %d cpus, %.1fs, gaps > %.0f ns\n\n",
+           ncpus, secs, thr_ns);
+
+    for ( i = 0; i < ncpus; i++ ) {
+        jitter_t *j = &jit[i];
+        double elapsed = (j->end - j->start) * ns_per_cycle / 1e9;
+
+        order[i] = j;
+        qsort(j->gaps, j->ngaps, sizeof(gap_t), cmp_gap_len);
+
+        printf("Cpu %d\n", j->cpu);
+        printf("  interruptions: %lu (%.1f/s)\n", j->count,
+               elapsed > 0 ? j->count / elapsed : 0.0);
+        printf("  time lost: %.3f ms (%.4f%%)\n",
+               j->lost * ns_per_cycle / 1e6,
+               100.0 * j->lost / (j->end - j->start + 1));
+        if ( j->ngaps ) {
+            printf("  gap median/p99/max: %.0f / %.0f / %.0f ns\n",
+                   j->gaps[j->ngaps / 2].len * ns_per_cycle,
+                   j->gaps[(unsigned long)(j->ngaps * 0.99)].len *
+                   ns_per_cycle,
+                   j->max * ns_per_cycle);
+            for ( b = 0; b < JITTER_BUCKETS; b++ ) {
+                if ( !j->hist[b] )
+                    continue;
+                if ( b < JITTER_BUCKETS - 1 )
+                    printf("    [%9.0f, %9.0f) ns: %lu\n",
+                           (j->threshold << b) * ns_per_cycle,
+                           (j->threshold << (b+1)) * ns_per_cycle,
+                           j->hist[b]);
+                else
+                    printf("    [%9.0f,       inf) ns: %lu\n",
+                           (j->threshold << b) * ns_per_cycle, j->hist[b]);
+            }
+        }
+        if ( verbose ) {
+            // Dump in time order
+            qsort(j->gaps, j->ngaps, sizeof(gap_t), cmp_gap_tsc);
+            for ( k = 0; k < j->ngaps; k++ )
+                printf("    gap of %.0f ns at +%.6f s\n",
+                       j->gaps[k].len * ns_per_cycle,
+                       (j->gaps[k].tsc - j->start) * ns_per_cycle / 1e9);
+        }
+        printf("\n");
+    }
+
+    qsort(order, ncpus, sizeof(jitter_t*), cmp_lost);
+    printf("Cpus from quietest to noisiest:");
+    for ( i = 0; i < ncpus; i++ )
+        printf(" %d", order[i]->cpu);
+    printf("\n");
+
+    for ( i = 0; i < ncpus; i++ )
+        free(jit[i].gaps);
+    free(jit);
+    free(order);
+    free(tids);
+    procmap_destroy(pi);
+
+    return 0;
+}
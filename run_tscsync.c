@@ -0,0 +1,107 @@
+/**
+ * @file
+ * Measures TSC offsets between the cpus of the system and reports
+ * a per-cpu correction table
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "processor_map.h"
+#include "tsc_sync.h"
+#include "tsc_x86_64.h"
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-r ref_cpu] [-n samples] [-a] "
+                    "[-o table_file]\n"
+                    "  -r  reference cpu id (default 0)\n"
+                    "  -n  ping-pong rounds per pair (default 10000)\n"
+                    "  -a  also measure every pair of cpus\n"
+                    "  -o  save the offset table to a file\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    procmap_t *pi;
+    tsc_sync_t *s;
+    tsc_pair_t p;
+    const char *out = NULL;
+    double hz;
+    int64_t worst = 0, worst_unc = 0;
+    int i, j, c, ref = 0, samples = 10000, all_pairs = 0;
+
+    while ( (c = getopt(argc, argv, "r:n:ao:")) != -1 ) {
+        switch ( c ) {
+        case 'r': ref = atoi(optarg); break;
+        case 'n': samples = atoi(optarg); break;
+        case 'a': all_pairs = 1; break;
+        case 'o': out = optarg; break;
+        default: usage(argv[0]);
+        }
+    }
+    if ( samples < 1 )
+        usage(argv[0]);
+
+    pi = procmap_init();
+    hz = timer_calibrate_hz(20000);
+
+    s = tsc_sync_measure(pi, ref, samples);
+
+    fprintf(stdout, "TSC offsets w.r.t. cpu %d (%d rounds, %.0f MHz TSC)\n",
+            ref, samples, hz / 1e6);
+    fprintf(stdout, "---------------------\n");
+    fprintf(stdout, "%6s %14s %12s %10s\n", "cpu", "offset(cyc)",
+            "+-(cyc)", "+-(ns)");
+    for ( i = 0; i < pi->num_cpus; i++ ) {
+        int cpu = pi->flat_threads[i].cpu_id;
+
+        if ( !s->valid[cpu] ) {
+            fprintf(stdout, "%6d %14s\n", cpu, "inconsistent");
+            continue;
+        }
+        fprintf(stdout, "%6d %14ld %12ld %10.1f\n", cpu,
+                (long)s->offset[cpu], (long)s->uncert[cpu],
+                s->uncert[cpu] * 1e9 / hz);
+        if ( llabs(s->offset[cpu]) > llabs(worst) ) {
+            worst = s->offset[cpu];
+            worst_unc = s->uncert[cpu];
+        }
+    }
+    fprintf(stdout, "\nLargest offset: %ld +- %ld cycles (%.1f ns)\n\n",
+            (long)worst, (long)worst_unc, llabs(worst) * 1e9 / hz);
+
+    if ( all_pairs ) {
+        fprintf(stdout, "Pairwise offsets (row: reference, cycles)\n");
+        fprintf(stdout, "---------------------\n");
+        fprintf(stdout, "%6s", "");
+        for ( j = 0; j < pi->num_cpus; j++ )
+            fprintf(stdout, " %8d", pi->flat_threads[j].cpu_id);
+        fprintf(stdout, "\n");
+
+        for ( i = 0; i < pi->num_cpus; i++ ) {
+            fprintf(stdout, "%6d", pi->flat_threads[i].cpu_id);
+            for ( j = 0; j < pi->num_cpus; j++ ) {
+                tsc_sync_measure_pair(pi->flat_threads[i].cpu_id,
+                                      pi->flat_threads[j].cpu_id,
+                                      samples, &p);
+                if ( p.consistent )
+                    fprintf(stdout, " %8ld", (long)p.offset);
+                else
+                    fprintf(stdout, " %8s", "?");
+            }
+            fprintf(stdout, "\n");
+        }
+        fprintf(stdout, "\n");
+    }
+
+    if ( out && tsc_sync_save(s, out) == 0 )
+        fprintf(stdout, "Offset table saved to %s\n", out);
+
+    tsc_sync_destroy(s);
+    procmap_destroy(pi);
+
+    return 0;
+}
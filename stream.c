@@ -0,0 +1,68 @@
+/**
+ * @file
+ * Streaming fill and copy kernels
+ */
+
+#include "stream.h"
+
+#include <string.h>
+
+/**
+ * Sets the streaming threshold to the L3 size (or the largest
+ * unified/data cache of known size) of the first cpu
+ * @param pi processor map
+ */
+void stream_init(procmap_t *pi)
+{
+    unsigned long llc = 0;
+    int i, level = 0;
+
+    if ( !pi || pi->num_cpus < 1 )
+        return;
+
+    for ( i = 0; i < pi->flat_threads[0].num_caches; i++ ) {
+        cacheinfo_t *c = &pi->flat_threads[0].cache[i];
+        if ( c->type[0] == 'I' || c->size == 0 )
+            continue;
+        if ( c->level > level ) {
+            level = c->level;
+            llc = c->size;
+        }
+    }
+    if ( llc )
+        stream_set_threshold(llc);
+}
+
+/**
+ * Fills a buffer with a repeating 16-byte pattern, streaming if it is
+ * at least stream_threshold() bytes
+ * @see stream_fill_nt
+ */
+void stream_fill(void *dst, const void *pattern, size_t bytes)
+{
+    if ( stream_use_nt(bytes) ) {
+        stream_fill_nt(dst, pattern, bytes);
+        stream_fence();
+    } else {
+        unsigned char *d = (unsigned char*)dst;
+        size_t off;
+
+        for ( off = 0; off + 16 <= bytes; off += 16 )
+            memcpy(d + off, pattern, 16);
+        memcpy(d + off, pattern, bytes - off);
+    }
+}
+
+/**
+ * Copies a buffer, streaming if it is at least stream_threshold() bytes
+ * @see stream_copy_nt
+ */
+void stream_copy(void *dst, const void *src, size_t bytes)
+{
+    if ( stream_use_nt(bytes) ) {
+        stream_copy_nt(dst, src, bytes);
+        stream_fence();
+    } else {
+        memcpy(dst, src, bytes);
+    }
+}
@@ -0,0 +1,34 @@
+/**
+ * @file
+ * Bulk fill and copy with non-temporal (streaming) stores.
+ *
+ * Regular stores of a buffer larger than the last-level cache evict
+ * everything else from it and read every line before overwriting it
+ * (read-for-ownership). Streaming stores (movntdq) go to memory through
+ * write-combining buffers instead. stream_fill() and stream_copy()
+ * switch to them above a threshold, the L3 size (see stream_nt.h, and
+ * stream_init() to take it from the processor map).
+ */
+
+#ifndef STREAM_H_
+#define STREAM_H_
+
+#include <stddef.h>
+
+#include "processor_map.h"
+#include "stream_nt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void stream_init(procmap_t *pi);
+
+void stream_fill(void *dst, const void *pattern, size_t bytes);
+void stream_copy(void *dst, const void *src, size_t bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
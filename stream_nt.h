@@ -0,0 +1,148 @@
+/**
+ * @file
+ * Header-only part of stream.h: the streaming store kernels and the
+ * threshold from which they are used.
+ *
+ * Kept apart so that templates (matrix2d.h) can stream without linking
+ * stream.o. The threshold is computed on first use from the L3 size
+ * reported by the C library, unless stream_init() or
+ * stream_set_threshold() set it before.
+ */
+
+#ifndef STREAM_NT_H_
+#define STREAM_NT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <emmintrin.h>
+
+//! Threshold used if the L3 size is unknown
+#define STREAM_DEFAULT_THRESHOLD (8UL << 20)
+
+/**
+ * Streaming threshold in bytes, 0 until first use. Weak, so that every
+ * object including this header shares one copy without a definition in
+ * stream.c.
+ */
+__attribute__((weak)) size_t _stream_threshold_bytes = 0;
+
+/**
+ * Overrides the streaming threshold ((size_t)-1 disables streaming)
+ */
+static inline void stream_set_threshold(size_t bytes)
+{
+    __atomic_store_n(&_stream_threshold_bytes, bytes, __ATOMIC_RELAXED);
+}
+
+/**
+ * @return buffer size from which stream_fill/stream_copy and the
+ *         matrix2d.h templates stream
+ */
+static inline size_t stream_threshold(void)
+{
+    size_t t = __atomic_load_n(&_stream_threshold_bytes, __ATOMIC_RELAXED);
+
+    if ( !t ) {
+        long l3 = sysconf(_SC_LEVEL3_CACHE_SIZE);
+
+        t = l3 > 0 ? (size_t)l3 : STREAM_DEFAULT_THRESHOLD;
+        stream_set_threshold(t);
+    }
+    return t;
+}
+
+/**
+ * @return nonzero if buffers of this size should use streaming stores
+ */
+static inline int stream_use_nt(size_t bytes)
+{
+    return bytes >= stream_threshold();
+}
+
+/**
+ * Orders streaming stores before later stores; required after
+ * stream_fill_nt()/stream_copy_nt() before other threads read the data
+ */
+static inline void stream_fence(void)
+{
+    _mm_sfence();
+}
+
+/**
+ * Fills a buffer with a repeating 16-byte pattern using streaming
+ * stores (no trailing fence, see stream_fence()).
+ * Bytes before the first 16-byte boundary and after the last one are
+ * written with regular stores; the pattern stays in phase with dst.
+ * @param dst buffer
+ * @param pattern 16 bytes, repeated from dst on
+ * @param bytes size of the buffer
+ */
+static inline void stream_fill_nt(void *dst, const void *pattern, size_t bytes)
+{
+    unsigned char pat[32], *d = (unsigned char*)dst;
+    size_t head = (16 - ((uintptr_t)d & 15)) & 15, n;
+    __m128i v;
+
+    memcpy(pat, pattern, 16);
+    memcpy(pat + 16, pattern, 16);
+
+    if ( head > bytes )
+        head = bytes;
+    memcpy(d, pat, head);
+    d += head;
+    bytes -= head;
+
+    // Pattern rotated by 'head', so that it continues where the head
+    // left off
+    v = _mm_loadu_si128((const __m128i*)(pat + head));
+    for ( n = bytes / 64; n > 0; n--, d += 64 ) {
+        _mm_stream_si128((__m128i*)d, v);
+        _mm_stream_si128((__m128i*)(d + 16), v);
+        _mm_stream_si128((__m128i*)(d + 32), v);
+        _mm_stream_si128((__m128i*)(d + 48), v);
+    }
+    for ( n = (bytes & 63) / 16; n > 0; n--, d += 16 )
+        _mm_stream_si128((__m128i*)d, v);
+
+    memcpy(d, pat + head, bytes & 15);
+}
+
+/**
+ * Copies a buffer using streaming stores (no trailing fence, see
+ * stream_fence()); the buffers must not overlap
+ * @param dst destination
+ * @param src source
+ * @param bytes size of the buffers
+ */
+static inline void stream_copy_nt(void *dst, const void *src, size_t bytes)
+{
+    unsigned char *d = (unsigned char*)dst;
+    const unsigned char *s = (const unsigned char*)src;
+    size_t head = (16 - ((uintptr_t)d & 15)) & 15, n;
+
+    if ( head > bytes )
+        head = bytes;
+    memcpy(d, s, head);
+    d += head;
+    s += head;
+    bytes -= head;
+
+    for ( n = bytes / 64; n > 0; n--, d += 64, s += 64 ) {
+        __m128i a = _mm_loadu_si128((const __m128i*)s),
+                b = _mm_loadu_si128((const __m128i*)(s + 16)),
+                c = _mm_loadu_si128((const __m128i*)(s + 32)),
+                e = _mm_loadu_si128((const __m128i*)(s + 48));
+        _mm_stream_si128((__m128i*)d, a);
+        _mm_stream_si128((__m128i*)(d + 16), b);
+        _mm_stream_si128((__m128i*)(d + 32), c);
+        _mm_stream_si128((__m128i*)(d + 48), e);
+    }
+    for ( n = (bytes & 63) / 16; n > 0; n--, d += 16, s += 16 )
+        _mm_stream_si128((__m128i*)d, _mm_loadu_si128((const __m128i*)s));
+
+    memcpy(d, s, bytes & 15);
+}
+
+#endif
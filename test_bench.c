@@ -0,0 +1,91 @@
+/**
+ * @file
+ * Benchmark harness test: runs a few sample benchmarks warm and cold
+ * and saves the results
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "processor_map.h"
+#include "tsc_x86_64.h"
+
+typedef struct {
+    volatile double *buf;
+    unsigned long n;
+} array_arg_t;
+
+static void bench_rdtsc(void *arg, unsigned long iters)
+{
+    volatile uint64_t res;
+    unsigned long i;
+
+    for ( i = 0; i < iters; i++ )
+        res = timer_read();
+    (void)res;
+}
+
+static void bench_sum(void *arg, unsigned long iters)
+{
+    array_arg_t *a = (array_arg_t*)arg;
+    unsigned long i, j;
+    double s = 0.0;
+
+    for ( i = 0; i < iters; i++ )
+        for ( j = 0; j < a->n; j += 8 )
+            s += a->buf[j];
+    a->buf[0] = s;
+}
+
+int main(int argc, char **argv)
+{
+    static bench_result_t res[BENCH_MAX];
+    procmap_t *pi;
+    bench_opts_t opts;
+    array_arg_t small, large;
+    unsigned long i;
+    int n;
+
+    if ( argc < 3 ) {
+        fprintf(stderr, "Usage: %s <out.csv> <out.json>\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    pi = procmap_init();
+
+    small.n = 4096 / sizeof(double);
+    large.n = (16UL << 20) / sizeof(double);
+    small.buf = (double*)malloc(small.n * sizeof(double));
+    large.buf = (double*)malloc(large.n * sizeof(double));
+    for ( i = 0; i < small.n; i++ )
+        small.buf[i] = 1.0;
+    for ( i = 0; i < large.n; i++ )
+        large.buf[i] = 1.0;
+
+    bench_register("rdtsc", bench_rdtsc, NULL);
+    bench_register("sum_4KB", bench_sum, &small);
+    bench_register("sum_16MB", bench_sum, &large);
+
+    bench_opts_default(&opts);
+    opts.cpu = 0;
+    opts.warmup_cycles = 20000000UL;
+    n = bench_run_all(pi, &opts, NULL, res);
+
+    // Cold-cache run of the small array: every sample misses
+    opts.cold_cache = 1;
+    opts.max_samples = 30;
+    bench_run_all(pi, &opts, "sum_4KB", &res[n]);
+    n++;
+
+    bench_report(res, n);
+    if ( bench_write_csv(argv[1], res, n) ||
+         bench_write_json(argv[2], res, n) )
+        exit(EXIT_FAILURE);
+
+    free((void*)small.buf);
+    free((void*)large.buf);
+    procmap_destroy(pi);
+
+    return 0;
+}
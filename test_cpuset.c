@@ -0,0 +1,163 @@
+/**
+ * @file
+ * cpu set test: parses synthetic sysfs masks and lists of machines
+ * with hundreds to thousands of cpus, and checks iteration and set
+ * algebra against them. Prints each check, returns 1 if any failed.
+ */
+
+#define _GNU_SOURCE
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpuset.h"
+
+static int failed;
+
+static void check(const char *what, int ok)
+{
+    printf("%-50s %s\n", what, ok ? "ok" : "FAILED");
+    failed += !ok;
+}
+
+/**
+ * Formats a mask of ncpus cpus the way sysfs does: comma-separated
+ * groups of 8 hex digits, most significant first; cpu i is set if
+ * member(i)
+ */
+static void make_mask(char *buf, int ncpus, int (*member)(int))
+{
+    int g, d, ngroups = (ncpus + 31) / 32;
+
+    for ( g = ngroups - 1; g >= 0; g-- ) {
+        for ( d = 7; d >= 0; d-- ) {
+            int i, v = 0;
+            for ( i = 0; i < 4; i++ )
+                v |= member(32 * g + 4 * d + i) << i;
+            *buf++ = "0123456789abcdef"[v];
+        }
+        *buf++ = g ? ',' : '\n';
+    }
+    *buf = '\0';
+}
+
+// siblings of cpu 5 on a 2-way SMT 192-cpu box, thread pairs (n, n+96)
+static int smt_pair(int i) { return i == 5 || i == 101; }
+// second socket of a 2 x 96 cpu box
+static int socket1(int i) { return i >= 96 && i < 192; }
+// every 3rd cpu of 4096
+static int every3(int i) { return i < 4096 && i % 3 == 0; }
+
+int main(int argc, char **argv)
+{
+    char mask[2048], list[8192];
+    cpuset_t *a, *b, *c;
+    cpu_set_t affinity;
+    int i, n, ok;
+
+    // 192 cpus, bits past 31 and 63
+    make_mask(mask, 192, smt_pair);
+    a = cpuset_parse_mask(mask);
+    check("mask: SMT pair 5,101 of 192", a && cpuset_count(a) == 2 &&
+          cpuset_isset(a, 5) && cpuset_isset(a, 101) &&
+          !cpuset_isset(a, 69));
+    check("mask: first/next/last",
+          cpuset_first(a) == 5 && cpuset_next(a, 5) == 101 &&
+          cpuset_next(a, 101) == -1 && cpuset_last(a) == 101);
+    check("mask: rank", cpuset_rank(a, 5) == 0 && cpuset_rank(a, 101) == 1 &&
+          cpuset_rank(a, 191) == 2);
+
+    make_mask(mask, 192, socket1);
+    b = cpuset_parse_mask(mask);
+    check("mask: socket 1 of 2 x 96", b && cpuset_count(b) == 96 &&
+          cpuset_first(b) == 96 && cpuset_last(b) == 191);
+    cpuset_format_list(b, list, sizeof(list));
+    check("list: format 96-191", !strcmp(list, "96-191"));
+
+    c = cpuset_parse_list("96-191\n");
+    check("list: parse equals mask", c && cpuset_equal(b, c));
+    cpuset_free(c);
+
+    // algebra on sets of different widths
+    c = cpuset_dup(a);
+    cpuset_and(c, b);
+    check("and: {5,101} & socket 1 = {101}",
+          cpuset_count(c) == 1 && cpuset_isset(c, 101));
+    check("subset/intersects", cpuset_subset(c, a) && cpuset_subset(c, b) &&
+          !cpuset_subset(a, b) && cpuset_intersects(a, b));
+    cpuset_or(c, a);
+    check("or: back to {5,101}", cpuset_equal(c, a));
+    cpuset_andnot(c, b);
+    check("andnot: {5}", cpuset_count(c) == 1 && cpuset_isset(c, 5));
+    cpuset_xor(c, a);
+    check("xor: {101}", cpuset_count(c) == 1 && cpuset_isset(c, 101));
+    cpuset_set(c, 1000);
+    check("set grows the set", cpuset_isset(c, 1000) && c->nwords >= 16 &&
+          cpuset_last(c) == 1000 && !cpuset_equal(c, b));
+    cpuset_clear(c, 1000);
+    cpuset_clear(c, 5000);
+    check("clear", cpuset_count(c) == 1 && cpuset_last(c) == 101);
+    cpuset_free(a);
+    cpuset_free(b);
+    cpuset_free(c);
+
+    // 4096 cpus, mask vs. list
+    make_mask(mask, 4096, every3);
+    a = cpuset_parse_mask(mask);
+    b = cpuset_alloc(0);
+    for ( i = 0; i < 4096; i += 3 )
+        cpuset_set(b, i);
+    check("mask: every 3rd of 4096", a && cpuset_equal(a, b) &&
+          cpuset_count(a) == 1366);
+    for ( n = 0, ok = 1, i = cpuset_first(a); i >= 0; i = cpuset_next(a, i) )
+        ok &= i == 3 * n++;
+    check("iteration visits every member in order", ok && n == 1366);
+    n = cpuset_format_list(a, list, sizeof(list));
+    c = cpuset_parse_list(list);
+    check("list: format/parse round trip", n < (int)sizeof(list) && c &&
+          cpuset_equal(a, c));
+    cpuset_free(a);
+    cpuset_free(b);
+    cpuset_free(c);
+
+    // ranges across word boundaries
+    a = cpuset_parse_list("0-3,60-70,127,128-255, 1023");
+    check("list: ranges", a && cpuset_count(a) == 4 + 11 + 1 + 128 + 1 &&
+          cpuset_isset(a, 64) && !cpuset_isset(a, 59) &&
+          !cpuset_isset(a, 256) && cpuset_last(a) == 1023);
+    cpuset_format_list(a, list, sizeof(list));
+    check("list: format ranges", !strcmp(list, "0-3,60-70,127-255,1023"));
+    n = cpuset_format_list(a, list, 8);
+    check("list: truncated format", n == 22 && !strcmp(list, "0-3,60-"));
+
+    // cpu_set_t conversion
+    cpuset_to_cpu_set(a, &affinity, sizeof(affinity));
+    check("to cpu_set_t", CPU_COUNT(&affinity) == cpuset_count(a) &&
+          CPU_ISSET(1023, &affinity) && CPU_ISSET(200, &affinity));
+    b = cpuset_from_cpu_set(&affinity, sizeof(affinity));
+    check("from cpu_set_t", cpuset_equal(a, b));
+    cpuset_free(a);
+    cpuset_free(b);
+
+    // malformed input and empty sets
+    check("malformed mask", !cpuset_parse_mask("ff,zz"));
+    check("malformed lists", !cpuset_parse_list("3-1") &&
+          !cpuset_parse_list("1,,2") && !cpuset_parse_list("1-"));
+    a = cpuset_parse_list("65535");
+    check("out of range lists", !cpuset_parse_list("0-4000000000") &&
+          !cpuset_parse_list("99999999999999999999") &&
+          !cpuset_parse_list("65536") && a && cpuset_last(a) == 65535);
+    cpuset_free(a);
+    a = cpuset_parse_list("\n");
+    b = cpuset_parse_mask("00000000,00000000");
+    check("empty list and mask", a && b && cpuset_empty(a) &&
+          cpuset_empty(b) && cpuset_equal(a, b) && cpuset_first(a) == -1 &&
+          cpuset_last(b) == -1);
+    cpuset_free(a);
+    cpuset_free(b);
+
+    printf("%s\n", failed ? "FAILED" : "passed");
+    return failed ? 1 : 0;
+}
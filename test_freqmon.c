@@ -0,0 +1,40 @@
+/**
+ * @file
+ * Frequency monitor test: reports frequency around a compute-bound
+ * region
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "freqmon.h"
+#include "processor_map.h"
+#include "tsc_x86_64.h"
+
+int main(int argc, char **argv)
+{
+    procmap_t *pi = procmap_init();
+    freqmon_t fm;
+    tsctimer_t tim;
+    unsigned long i, n = argc > 1 ? atol(argv[1]) : 500000000UL;
+    volatile double x = 1.0;
+    double y = x;
+
+    freqmon_init(&fm, pi, 10000);
+
+    timer_clear(&tim);
+    freqmon_start(&fm);
+    timer_start(&tim);
+    for ( i = 0; i < n; i++ )
+        y = y * 1.0000001 + 1e-9;
+    timer_stop(&tim);
+    freqmon_stop(&fm);
+    x = y;
+
+    freqmon_report(stdout, &fm, &tim);
+
+    freqmon_destroy(&fm);
+    procmap_destroy(pi);
+
+    return x > 0 ? 0 : 1;
+}
@@ -0,0 +1,75 @@
+/**
+ * @file
+ * Performance counter test: sequential vs. random access over a
+ * large array, timed with both the TSC and a counter group
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "perfctr.h"
+#include "tsc_x86_64.h"
+#include "util.h"
+
+int main(int argc, char **argv)
+{
+    perfctr_t pc;
+    tsctimer_t tim;
+    unsigned long i, n, *next, p;
+    double sum = 0.0, *a;
+
+    n = (argc > 1 ? atol(argv[1]) : 64UL << 20) / sizeof(double);
+
+    if ( perfctr_open(&pc) < 0 )
+        exit(EXIT_FAILURE);
+
+    a = (double*)malloc_safe(n * sizeof(double));
+    next = (unsigned long*)malloc_safe(n * sizeof(unsigned long));
+    for ( i = 0; i < n; i++ ) {
+        a[i] = 1.0;
+        next[i] = i;
+    }
+    // Sattolo's shuffle: a single cycle through all elements
+    for ( i = n - 1; i > 0; i-- ) {
+        unsigned long j = marsaglia_prng() % i, t = next[i];
+        next[i] = next[j];
+        next[j] = t;
+    }
+
+    timer_clear(&tim);
+    perfctr_clear(&pc);
+    timer_start(&tim);
+    perfctr_start(&pc);
+    for ( i = 0; i < n; i++ )
+        sum += a[i];
+    perfctr_stop(&pc);
+    timer_stop(&tim);
+    perfctr_report(stdout, "sequential sum", &pc, &tim, n);
+
+    timer_clear(&tim);
+    perfctr_clear(&pc);
+    timer_start(&tim);
+    perfctr_start(&pc);
+    for ( i = 0, p = 0; i < n; i++ )
+        p = next[p];
+    perfctr_stop(&pc);
+    timer_stop(&tim);
+    perfctr_report(stdout, "pointer chase", &pc, &tim, n);
+
+    // Cost of one start/stop pair
+    timer_clear(&tim);
+    timer_start(&tim);
+    for ( i = 0; i < 1000; i++ ) {
+        perfctr_start(&pc);
+        perfctr_stop(&pc);
+    }
+    timer_stop(&tim);
+    printf("\nAverage cycles per perfctr start/stop: %lf\n",
+           timer_total(&tim) / 1000);
+
+    perfctr_close(&pc);
+    free(a);
+    free(next);
+
+    return (sum > 0 && p == 0) ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+/**
+ * @file
+ * Profiling zones test: nested zones on several threads, merged
+ * report and per-zone overhead
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "prof.h"
+#include "tsc_x86_64.h"
+
+static int iters;
+
+static void leaf(unsigned long cycles)
+{
+    PROF_BEGIN("leaf");
+    spin_for_cycles(cycles);
+    PROF_END();
+}
+
+static void* thread_fun(void *args)
+{
+    long me = (long)args;
+    int i;
+
+    for ( i = 0; i < iters; i++ ) {
+        PROF_BEGIN("outer");
+        spin_for_cycles(1000);
+
+        PROF_BEGIN("inner");
+        leaf(2000 * (me + 1));
+        spin_for_cycles(500);
+        PROF_END();
+
+        leaf(1000);
+        PROF_END();
+    }
+
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    tsctimer_t tim;
+    pthread_t *tids;
+    long i, nthreads, max = 1000000;
+
+    if ( argc < 3 ) {
+        fprintf(stderr, "Usage: %s <nthreads> <iterations>\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    nthreads = atol(argv[1]);
+    iters = atoi(argv[2]);
+
+    timer_clear(&tim);
+    timer_start(&tim);
+    for ( i = 0; i < max; i++ ) {
+        PROF_BEGIN("empty");
+        PROF_END();
+    }
+    timer_stop(&tim);
+    printf("Average cycles per empty zone: %lf\n\n", timer_total(&tim)/max);
+
+    tids = (pthread_t*)malloc(nthreads * sizeof(pthread_t));
+    for ( i = 0; i < nthreads; i++ )
+        pthread_create(&tids[i], NULL, thread_fun, (void*)i);
+    for ( i = 0; i < nthreads; i++ )
+        pthread_join(tids[i], NULL);
+
+#ifndef PROF_DISABLE
+    prof_report(stdout);
+#endif
+    free(tids);
+
+    return 0;
+}
@@ -0,0 +1,168 @@
+/**
+ * @file
+ * Event tracing test: records events from several threads, reports
+ * the per-event overhead and writes a Chrome trace file. Then flushes
+ * repeatedly while a thread keeps wrapping its ring, and checks that
+ * no torn or missing record is written.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+#include "tsc_x86_64.h"
+
+static uint32_t ev_work, ev_step, ev_tick, ev_lap[2];
+static int nevents;
+static volatile int stop_wrap;
+
+//! Number of flushes taken while the ring wraps
+#define WRAP_FLUSHES 20
+
+static void* thread_fun(void *args)
+{
+    long me = (long)args;
+    char name[32];
+    volatile double x = 1.0;
+    int i, j;
+
+    sprintf(name, "worker %ld", me);
+    trace_thread_init(name);
+
+    for ( i = 0; i < nevents; i++ ) {
+        trace_begin(ev_work, i);
+        for ( j = 0; j < 4; j++ ) {
+            trace_begin(ev_step, j);
+            spin_for_cycles(2000 * (me + 1));
+            x *= 1.0000001;
+            trace_end(ev_step, j);
+        }
+        trace_instant(ev_tick, me);
+        trace_end(ev_work, i);
+    }
+
+    return NULL;
+}
+
+/**
+ * Records instants with arg = sequence number; the event id flips
+ * with each lap of the ring, so a record whose fields come from two
+ * different laps shows up as a lap/arg mismatch
+ */
+static void* wrap_fun(void *args)
+{
+    uint64_t i;
+
+    trace_thread_init("wrapper");
+    for ( i = 0; !stop_wrap; i++ )
+        trace_instant(ev_lap[(i / TRACE_DEFAULT_NRECS) & 1], i);
+
+    return NULL;
+}
+
+/**
+ * Checks the wrapper thread's records in a flushed trace: lap matches
+ * arg, args are consecutive and timestamps do not go back
+ * @return number of bad records, -1 if the file cannot be read
+ */
+static long check_wrap(const char *path)
+{
+    char line[512], *p;
+    unsigned long arg, prev_arg = 0;
+    double ts, prev_ts = 0.0;
+    long bad = 0, n = 0;
+    int lap;
+    FILE *fp;
+
+    if ( !(fp = fopen(path, "r")) )
+        return -1;
+
+    while ( fgets(line, sizeof(line), fp) ) {
+        if ( !(p = strstr(line, "{\"name\":\"lap")) )
+            continue;
+        if ( sscanf(p, "{\"name\":\"lap%d\",\"ph\":\"i\",\"ts\":%lf,"
+                       "\"pid\":%*d,\"tid\":%*d,\"args\":{\"arg\":%lu}",
+                    &lap, &ts, &arg) != 3 ) {
+            bad++;
+            continue;
+        }
+        if ( (unsigned long)lap != ((arg / TRACE_DEFAULT_NRECS) & 1) ||
+             (n && (arg != prev_arg + 1 || ts < prev_ts)) )
+            bad++;
+        prev_arg = arg;
+        prev_ts = ts;
+        n++;
+    }
+    fclose(fp);
+
+    return bad;
+}
+
+int main(int argc, char **argv)
+{
+    tsctimer_t tim;
+    pthread_t *tids;
+    uint64_t res = 0;
+    long i, nthreads, max, torn;
+    int written;
+
+    if ( argc < 4 ) {
+        fprintf(stderr, "Usage: %s <nthreads> <events per thread> "
+                        "<trace.json>\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    nthreads = atol(argv[1]);
+    nevents = atoi(argv[2]);
+
+    trace_init(0);
+    ev_work = trace_event_register("work");
+    ev_step = trace_event_register("step");
+    ev_tick = trace_event_register("tick");
+
+    // Overhead of a bare TSC read vs. a full trace record
+    max = 1000000;
+    trace_thread_init("main");
+    timer_clear(&tim);
+    timer_start(&tim);
+    for ( i = 0; i < max; i++ )
+        res += timer_read();
+    timer_stop(&tim);
+    printf("Average cycles per rdtsc read: %lf\n", timer_total(&tim)/max);
+
+    timer_clear(&tim);
+    timer_start(&tim);
+    for ( i = 0; i < max; i++ )
+        trace_instant(ev_tick, i);
+    timer_stop(&tim);
+    printf("Average cycles per trace event: %lf\n", timer_total(&tim)/max);
+
+    tids = (pthread_t*)malloc(nthreads * sizeof(pthread_t));
+    for ( i = 0; i < nthreads; i++ )
+        pthread_create(&tids[i], NULL, thread_fun, (void*)i);
+    for ( i = 0; i < nthreads; i++ )
+        pthread_join(tids[i], NULL);
+
+    written = trace_flush(argv[3]);
+    printf("Wrote %d events to %s\n", written, argv[3]);
+
+    // Flush while the ring wraps
+    ev_lap[0] = trace_event_register("lap0");
+    ev_lap[1] = trace_event_register("lap1");
+    pthread_create(&tids[0], NULL, wrap_fun, NULL);
+    spin_for_cycles(10000000);
+    for ( i = 0, torn = 0; i < WRAP_FLUSHES && torn >= 0; i++ ) {
+        long b = trace_flush(argv[3]) < 0 ? -1 : check_wrap(argv[3]);
+        torn = b < 0 ? -1 : torn + b;
+    }
+    stop_wrap = 1;
+    pthread_join(tids[0], NULL);
+    printf("Flushes while wrapping: %d, bad records: %ld\n", WRAP_FLUSHES, 
+           torn);
+
+    trace_destroy();
+    free(tids);
+
+    return (res && written > 0 && torn == 0) ? 0 : 1;
+}
@@ -0,0 +1,240 @@
+/**
+ * @file
+ * Per-thread event tracing: buffer registry and Chrome trace export
+ */
+#define _GNU_SOURCE
+
+#include "trace.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "util.h"
+
+__thread trace_buf_t *_trace_self = NULL;
+
+static pthread_mutex_t _trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static trace_buf_t *_trace_bufs = NULL;
+static unsigned long _trace_nrecs = TRACE_DEFAULT_NRECS;
+static char **_trace_names = NULL;
+static uint32_t _trace_num_names = 0;
+static double _trace_hz = 0.0;
+static uint64_t _trace_base_tsc = 0;
+
+/**
+ * Initializes the tracing facility.
+ * Calibrates the TSC rate used to convert stamps to wall time and
+ * sets the origin of the timeline. Must be called before any thread
+ * records events.
+ * @param nrecs number of records per thread ring (rounded up to a
+ *        power of 2), 0 for the default
+ */
+void trace_init(unsigned long nrecs)
+{
+    unsigned long n = 1;
+
+    if ( !nrecs )
+        nrecs = TRACE_DEFAULT_NRECS;
+    while ( n < nrecs )
+        n <<= 1;
+
+    _trace_nrecs = n;
+    _trace_hz = timer_calibrate_hz(20000);
+    _trace_base_tsc = timer_read();
+}
+
+/**
+ * Creates the calling thread's ring buffer and registers it.
+ * Calling it explicitly (e.g. right after a thread is pinned) keeps
+ * the allocation out of the first traced region.
+ * @param name thread name to show in the viewer, NULL for a default
+ * @return the thread's buffer
+ */
+trace_buf_t* trace_thread_init(const char *name)
+{
+    trace_buf_t *b;
+
+    if ( _trace_self )
+        return _trace_self;
+
+    b = (trace_buf_t*)malloc_safe(sizeof(trace_buf_t));
+    if ( posix_memalign((void**)&b->rec, 64,
+                        _trace_nrecs * sizeof(trace_rec_t)) ) {
+        fprintf(stderr, "%s: Allocation error\n", __FUNCTION__);
+        exit(EXIT_FAILURE);
+    }
+    // Touch the ring now, so page faults don't show up as events cost
+    memset(b->rec, 0, _trace_nrecs * sizeof(trace_rec_t));
+    b->mask = _trace_nrecs - 1;
+    b->head = 0;
+    b->tid = (int)syscall(SYS_gettid);
+    if ( name )
+        snprintf(b->name, sizeof(b->name), "%s", name);
+    else
+        snprintf(b->name, sizeof(b->name), "thread %d", b->tid);
+
+    pthread_mutex_lock(&_trace_lock);
+    b->next = _trace_bufs;
+    _trace_bufs = b;
+    pthread_mutex_unlock(&_trace_lock);
+
+    _trace_self = b;
+    return b;
+}
+
+/**
+ * Registers an event name
+ * @param name event name (copied)
+ * @return event id to pass to trace_begin/end/instant
+ */
+uint32_t trace_event_register(const char *name)
+{
+    uint32_t id;
+
+    pthread_mutex_lock(&_trace_lock);
+    id = _trace_num_names++;
+    _trace_names = (char**)realloc(_trace_names,
+                                   _trace_num_names * sizeof(char*));
+    if ( !_trace_names ) {
+        fprintf(stderr, "%s: Allocation error\n", __FUNCTION__);
+        exit(EXIT_FAILURE);
+    }
+    _trace_names[id] = strdup(name);
+    pthread_mutex_unlock(&_trace_lock);
+
+    return id;
+}
+
+/**
+ * Writes a string as a JSON string literal
+ */
+static void _json_puts(FILE *fp, const char *s)
+{
+    fputc('"', fp);
+    for ( ; *s; s++ ) {
+        if ( *s == '"' || *s == '\\' )
+            fputc('\\', fp);
+        if ( (unsigned char)*s >= 0x20 )
+            fputc(*s, fp);
+    }
+    fputc('"', fp);
+}
+
+/**
+ * Dumps all thread rings in Chrome trace event format.
+ * Threads may keep recording while this runs: records that were
+ * overwritten while being copied out are dropped.
+ * @param path output file
+ * @return number of events written, -1 on error or if trace_init()
+ *         was never called
+ */
+int trace_flush(const char *path)
+{
+    FILE *fp;
+    trace_buf_t *b;
+    trace_rec_t *snap;
+    uint64_t h1, h2, first, valid, i, cap;
+    double ticks_per_us;
+    int pid = getpid(), nevents = 0, sep = 0;
+
+    // Initializing here would move the timeline origin past the
+    // records already taken
+    if ( _trace_hz == 0.0 ) {
+        fprintf(stderr, "%s: trace_init() was not called\n", __FUNCTION__);
+        return -1;
+    }
+
+    if ( !(fp = fopen(path, "w")) ) {
+        perror(path);
+        return -1;
+    }
+    ticks_per_us = _trace_hz / 1e6;
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+    pthread_mutex_lock(&_trace_lock);
+    for ( b = _trace_bufs; b; b = b->next ) {
+        cap = b->mask + 1;
+
+        fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\","
+                    "\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+                    sep ? ",\n" : "", pid, b->tid);
+        _json_puts(fp, b->name);
+        fprintf(fp, "}}");
+        sep = 1;
+
+        // Snapshot the ring, then drop whatever the owner may have
+        // overwritten meanwhile. The owner writes record h into slot
+        // h & mask before publishing head = h+1, so while head is h2
+        // record h2-cap may already be torn: only records from
+        // h2-cap+1 on are intact.
+        h1 = b->head;
+        __asm__ __volatile__ ("" : : : "memory");
+        first = h1 > cap ? h1 - cap : 0;
+        snap = (trace_rec_t*)malloc_safe((h1 - first) * sizeof(trace_rec_t)
+                                         + 1);
+        for ( i = first; i < h1; i++ )
+            snap[i - first] = b->rec[i & b->mask];
+        __asm__ __volatile__ ("" : : : "memory");
+        h2 = b->head;
+        valid = h2 >= cap ? h2 - cap + 1 : 0;
+        if ( valid < first )
+            valid = first;
+
+        for ( i = valid; i < h1; i++ ) {
+            trace_rec_t *r = &snap[i - first];
+            double ts = (double)(int64_t)(r->tsc - _trace_base_tsc) /
+                        ticks_per_us;
+
+            fprintf(fp, ",\n{\"name\":");
+            if ( r->event < _trace_num_names )
+                _json_puts(fp, _trace_names[r->event]);
+            else
+                fprintf(fp, "\"event %u\"", r->event);
+            fprintf(fp, ",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,"
+                        "\"args\":{\"arg\":%lu}%s}",
+                        (char)r->ph, ts, pid, b->tid,
+                        (unsigned long)r->arg,
+                        r->ph == TRACE_PH_INSTANT ? ",\"s\":\"t\"" : "");
+            nevents++;
+        }
+        free(snap);
+    }
+    pthread_mutex_unlock(&_trace_lock);
+
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+
+    return nevents;
+}
+
+/**
+ * Releases all buffers and event names.
+ * All traced threads must have exited (or stopped recording for good)
+ * before this is called.
+ */
+void trace_destroy(void)
+{
+    trace_buf_t *b, *next;
+    uint32_t i;
+
+    pthread_mutex_lock(&_trace_lock);
+    for ( b = _trace_bufs; b; b = next ) {
+        next = b->next;
+        free(b->rec);
+        free(b);
+    }
+    _trace_bufs = NULL;
+    for ( i = 0; i < _trace_num_names; i++ )
+        free(_trace_names[i]);
+    free(_trace_names);
+    _trace_names = NULL;
+    _trace_num_names = 0;
+    pthread_mutex_unlock(&_trace_lock);
+
+    _trace_self = NULL;
+}
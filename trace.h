@@ -0,0 +1,107 @@
+/**
+ * @file
+ * Per-thread, TSC-stamped event tracing.
+ *
+ * Every thread appends (tsc, event id, arg) records to its own ring
+ * buffer, so the hot path needs no locks and no atomic instructions.
+ * trace_flush() converts the TSC stamps to wall time and emits
+ * Chrome/Perfetto trace JSON (load it in chrome://tracing or
+ * ui.perfetto.dev).
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdint.h>
+
+#include "tsc_x86_64.h"
+
+/**
+ * Event phases, using the Chrome trace "ph" letters
+ */
+#define TRACE_PH_BEGIN   'B'
+#define TRACE_PH_END     'E'
+#define TRACE_PH_INSTANT 'i'
+
+//! Default number of records per thread ring (must be power of 2)
+#define TRACE_DEFAULT_NRECS (1 << 16)
+
+/**
+ * Trace record
+ */
+typedef struct {
+    uint64_t tsc;   //!< timestamp, as returned by timer_read()
+    uint64_t arg;   //!< user-supplied argument
+    uint32_t event; //!< event id, as returned by trace_event_register()
+    uint32_t ph;    //!< event phase (TRACE_PH_*)
+} trace_rec_t;
+
+/**
+ * Per-thread ring buffer.
+ * Written only by its owning thread. 'head' counts all records ever
+ * written; the ring holds the last (mask+1) of them.
+ */
+typedef struct trace_buf {
+    trace_rec_t *rec;
+    uint64_t mask;
+    volatile uint64_t head;
+    int tid;                 //!< kernel thread id
+    char name[32];           //!< thread name shown in the viewer
+    struct trace_buf *next;  //!< next buffer in the global registry
+} trace_buf_t;
+
+extern __thread trace_buf_t *_trace_self;
+
+void trace_init(unsigned long nrecs);
+trace_buf_t* trace_thread_init(const char *name);
+uint32_t trace_event_register(const char *name);
+int trace_flush(const char *path);
+void trace_destroy(void);
+
+/**
+ * Appends a record to the calling thread's ring.
+ * The buffer is created with default settings on first use, if
+ * trace_thread_init() has not been called by this thread.
+ * @param event event id
+ * @param ph event phase (TRACE_PH_*)
+ * @param arg user-supplied argument
+ */
+static inline void trace_record(uint32_t event, uint32_t ph, uint64_t arg)
+{
+    trace_buf_t *b = _trace_self;
+    trace_rec_t *r;
+    uint64_t h;
+
+    if ( __builtin_expect(!b, 0) )
+        b = trace_thread_init(NULL);
+
+    h = b->head;
+    r = &b->rec[h & b->mask];
+    r->tsc = timer_read();
+    r->arg = arg;
+    r->event = event;
+    r->ph = ph;
+
+    // x86 does not reorder stores with other stores, so keeping the
+    // compiler from doing so is enough to publish the record before
+    // the new head
+    __asm__ __volatile__ ("" : : : "memory");
+    b->head = h + 1;
+}
+
+static inline void trace_begin(uint32_t event, uint64_t arg)
+{
+    trace_record(event, TRACE_PH_BEGIN, arg);
+}
+
+static inline void trace_end(uint32_t event, uint64_t arg)
+{
+    trace_record(event, TRACE_PH_END, arg);
+}
+
+static inline void trace_instant(uint32_t event, uint64_t arg)
+{
+    trace_record(event, TRACE_PH_INSTANT, arg);
+}
+
+#endif
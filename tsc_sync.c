@@ -0,0 +1,297 @@
+/**
+ * @file
+ * Cross-core TSC offset measurement.
+ *
+ * Two threads, pinned on the cpus being compared, ping-pong over a
+ * single shared cache line. The reference side reads its TSC (t0),
+ * raises a request, waits for the reply carrying the remote TSC (t1),
+ * and reads its TSC again (t2). Since t1 was taken between t0 and t2
+ * in real time, the offset TSC_remote - TSC_ref lies in
+ * [t1 - t2, t1 - t0]. Intersecting these bounds over many rounds
+ * gives the offset and a hard bound on its uncertainty.
+ */
+#define _GNU_SOURCE
+
+#include "tsc_sync.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+
+//! Rounds discarded while the line and the code are warming up
+#define TSC_SYNC_WARMUP 16
+
+typedef struct {
+    volatile uint64_t req;
+    volatile uint64_t ack;
+    volatile uint64_t tsc;
+} __attribute__((aligned(64))) _sync_line_t;
+
+typedef struct {
+    _sync_line_t *line;
+    int samples;
+    pthread_barrier_t *bar;
+    tsc_pair_t *res;
+} _sync_arg_t;
+
+/**
+ * TSC read that is not reordered with surrounding loads/stores
+ */
+static inline uint64_t _rdtsc_ordered(void)
+{
+    unsigned int cpu;
+    uint64_t t = timer_read_cpu(&cpu);
+    __asm__ __volatile__ ("lfence" : : : "memory");
+    return t;
+}
+
+static void* _ref_fun(void *args)
+{
+    _sync_arg_t *a = (_sync_arg_t*)args;
+    _sync_line_t *line = a->line;
+    int64_t lo = INT64_MIN, hi = INT64_MAX, b;
+    uint64_t t0, t1, t2, rtt, min_rtt = UINT64_MAX;
+    uint64_t k;
+
+    pthread_barrier_wait(a->bar);
+
+    for ( k = 1; k <= (uint64_t)a->samples + TSC_SYNC_WARMUP; k++ ) {
+        t0 = _rdtsc_ordered();
+        line->req = k;
+        while ( line->ack != k )
+            __asm__ __volatile__ ("pause" : : : "memory");
+        t2 = _rdtsc_ordered();
+        t1 = line->tsc;
+
+        if ( k <= TSC_SYNC_WARMUP )
+            continue;
+
+        rtt = t2 - t0;
+        if ( rtt < min_rtt )
+            min_rtt = rtt;
+        if ( (b = (int64_t)(t1 - t2)) > lo )
+            lo = b;
+        if ( (b = (int64_t)(t1 - t0)) < hi )
+            hi = b;
+    }
+
+    a->res->min_rtt = min_rtt;
+    a->res->consistent = lo <= hi;
+    a->res->offset = lo / 2 + hi / 2;
+    a->res->uncert = lo <= hi ? (hi - lo) / 2 : (lo - hi) / 2;
+
+    return NULL;
+}
+
+static void* _remote_fun(void *args)
+{
+    _sync_arg_t *a = (_sync_arg_t*)args;
+    _sync_line_t *line = a->line;
+    uint64_t k;
+
+    pthread_barrier_wait(a->bar);
+
+    for ( k = 1; k <= (uint64_t)a->samples + TSC_SYNC_WARMUP; k++ ) {
+        while ( line->req != k )
+            __asm__ __volatile__ ("pause" : : : "memory");
+        line->tsc = _rdtsc_ordered();
+        line->ack = k;
+    }
+
+    return NULL;
+}
+
+/**
+ * Measures the TSC offset between two cpus
+ * @param cpu_a reference cpu id
+ * @param cpu_b remote cpu id
+ * @param samples number of ping-pong rounds
+ * @param res where the result is stored
+ * @return 0 on success, -1 if the threads could not be started
+ */
+int tsc_sync_measure_pair(int cpu_a, int cpu_b, int samples,
+                          tsc_pair_t *res)
+{
+    _sync_line_t *line;
+    _sync_arg_t arg;
+    pthread_barrier_t bar;
+    pthread_attr_t attr[2];
+    pthread_t tids[2];
+    cpu_set_t set[2];
+    int i, ret = 0;
+
+    memset(res, 0, sizeof(*res));
+    res->consistent = 1;
+    if ( cpu_a == cpu_b )
+        return 0;
+
+    if ( posix_memalign((void**)&line, 64, sizeof(*line)) ) {
+        fprintf(stderr, "%s: Allocation error\n", __FUNCTION__);
+        exit(EXIT_FAILURE);
+    }
+    memset(line, 0, sizeof(*line));
+
+    pthread_barrier_init(&bar, NULL, 2);
+    arg.line = line;
+    arg.samples = samples;
+    arg.bar = &bar;
+    arg.res = res;
+
+    for ( i = 0; i < 2; i++ ) {
+        CPU_ZERO(&set[i]);
+        CPU_SET(i == 0 ? cpu_a : cpu_b, &set[i]);
+        pthread_attr_init(&attr[i]);
+        pthread_attr_setaffinity_np(&attr[i], sizeof(set[i]), &set[i]);
+    }
+
+    if ( pthread_create(&tids[0], &attr[0], _ref_fun, &arg) ) {
+        ret = -1;
+    } else if ( pthread_create(&tids[1], &attr[1], _remote_fun, &arg) ) {
+        // The reference thread is stuck at the barrier: nothing sane
+        // can be done but bail out
+        fprintf(stderr, "%s: could not start thread on cpu %d\n",
+                __FUNCTION__, cpu_b);
+        exit(EXIT_FAILURE);
+    } else {
+        pthread_join(tids[0], NULL);
+        pthread_join(tids[1], NULL);
+    }
+
+    for ( i = 0; i < 2; i++ )
+        pthread_attr_destroy(&attr[i]);
+    pthread_barrier_destroy(&bar);
+    free(line);
+
+    return ret;
+}
+
+static tsc_sync_t* _tsc_sync_alloc(int num_cpus)
+{
+    tsc_sync_t *s = (tsc_sync_t*)malloc_safe(sizeof(tsc_sync_t));
+
+    s->num_cpus = num_cpus;
+    s->ref_cpu = 0;
+    s->offset = (int64_t*)calloc(num_cpus, sizeof(int64_t));
+    s->uncert = (int64_t*)calloc(num_cpus, sizeof(int64_t));
+    s->valid = (int*)calloc(num_cpus, sizeof(int));
+    if ( !s->offset || !s->uncert || !s->valid ) {
+        fprintf(stderr, "%s: Allocation error\n", __FUNCTION__);
+        exit(EXIT_FAILURE);
+    }
+
+    return s;
+}
+
+/**
+ * Measures the offset of every cpu in the system w.r.t. a reference
+ * @param pi processor map, used to enumerate cpus
+ * @param ref_cpu reference cpu id
+ * @param samples number of ping-pong rounds per cpu
+ * @return offset table, to be released with tsc_sync_destroy()
+ */
+tsc_sync_t* tsc_sync_measure(procmap_t *pi, int ref_cpu, int samples)
+{
+    tsc_sync_t *s;
+    tsc_pair_t p;
+    int i, max_id = 0;
+
+    for ( i = 0; i < pi->num_cpus; i++ )
+        if ( pi->flat_threads[i].cpu_id > max_id )
+            max_id = pi->flat_threads[i].cpu_id;
+
+    s = _tsc_sync_alloc(max_id + 1);
+    s->ref_cpu = ref_cpu;
+
+    for ( i = 0; i < pi->num_cpus; i++ ) {
+        int cpu = pi->flat_threads[i].cpu_id;
+
+        if ( tsc_sync_measure_pair(ref_cpu, cpu, samples, &p) < 0 )
+            continue;
+        s->offset[cpu] = p.offset;
+        s->uncert[cpu] = p.uncert;
+        s->valid[cpu] = p.consistent;
+    }
+
+    return s;
+}
+
+/**
+ * Saves an offset table as text: one "cpu offset uncertainty" line
+ * per measured cpu
+ * @return 0 on success, -1 on error
+ */
+int tsc_sync_save(tsc_sync_t *s, const char *path)
+{
+    FILE *fp;
+    int i;
+
+    if ( !(fp = fopen(path, "w")) ) {
+        perror(path);
+        return -1;
+    }
+
+    fprintf(fp, "# TSC offsets w.r.t. cpu %d\n", s->ref_cpu);
+    fprintf(fp, "# cpu offset uncertainty\n");
+    for ( i = 0; i < s->num_cpus; i++ )
+        if ( s->valid[i] )
+            fprintf(fp, "%d %ld %ld\n", i, (long)s->offset[i],
+                    (long)s->uncert[i]);
+
+    fclose(fp);
+    return 0;
+}
+
+/**
+ * Loads an offset table saved with tsc_sync_save()
+ * @return offset table, NULL on error
+ */
+tsc_sync_t* tsc_sync_load(const char *path)
+{
+    FILE *fp;
+    tsc_sync_t *s;
+    char line[256];
+    int cpu, max_id = 0, ref = 0;
+    long off, unc;
+
+    if ( !(fp = fopen(path, "r")) ) {
+        perror(path);
+        return NULL;
+    }
+
+    while ( fgets(line, sizeof(line), fp) )
+        if ( sscanf(line, "%d %ld %ld", &cpu, &off, &unc) == 3 &&
+             cpu > max_id )
+            max_id = cpu;
+
+    s = _tsc_sync_alloc(max_id + 1);
+
+    rewind(fp);
+    while ( fgets(line, sizeof(line), fp) ) {
+        if ( sscanf(line, "# TSC offsets w.r.t. cpu %d", &ref) == 1 ) {
+            s->ref_cpu = ref;
+        } else if ( sscanf(line, "%d %ld %ld", &cpu, &off, &unc) == 3 &&
+                    cpu >= 0 ) {
+            s->offset[cpu] = off;
+            s->uncert[cpu] = unc;
+            s->valid[cpu] = 1;
+        }
+    }
+
+    fclose(fp);
+    return s;
+}
+
+/**
+ * Deallocates an offset table
+ */
+void tsc_sync_destroy(tsc_sync_t *s)
+{
+    free(s->offset);
+    free(s->uncert);
+    free(s->valid);
+    free(s);
+}
@@ -0,0 +1,61 @@
+/**
+ * @file
+ * Cross-core TSC offset measurement and correction
+ */
+
+#ifndef TSC_SYNC_H_
+#define TSC_SYNC_H_
+
+#include <stdint.h>
+
+#include "processor_map.h"
+#include "tsc_x86_64.h"
+
+/**
+ * Per-cpu TSC offsets w.r.t. a reference cpu.
+ * For every cpu c, TSC_c - offset[c] is on the reference cpu's
+ * time base, within +/- uncert[c] cycles.
+ * Arrays are indexed by system cpu id.
+ */
+typedef struct {
+    int num_cpus;     //!< size of the arrays (max cpu id + 1)
+    int ref_cpu;      //!< reference cpu id
+    int64_t *offset;
+    int64_t *uncert;
+    int *valid;       //!< nonzero if the cpu was measured
+} tsc_sync_t;
+
+/**
+ * Result of a single pairwise measurement
+ */
+typedef struct {
+    int64_t offset;   //!< TSC_b - TSC_a, midpoint of the bounds
+    int64_t uncert;   //!< half-width of the bounds
+    uint64_t min_rtt; //!< shortest observed round trip, in cycles
+    int consistent;   //!< 0 if the bounds crossed (TSCs not monotonic)
+} tsc_pair_t;
+
+int tsc_sync_measure_pair(int cpu_a, int cpu_b, int samples,
+                          tsc_pair_t *res);
+tsc_sync_t* tsc_sync_measure(procmap_t *pi, int ref_cpu, int samples);
+int tsc_sync_save(tsc_sync_t *s, const char *path);
+tsc_sync_t* tsc_sync_load(const char *path);
+void tsc_sync_destroy(tsc_sync_t *s);
+
+/**
+ * Reads the TSC and maps it onto the reference cpu's time base, so
+ * that stamps taken on different cpus are comparable
+ * @param s offset table
+ * @return corrected TSC value
+ */
+static inline uint64_t tsc_sync_read(tsc_sync_t *s)
+{
+    unsigned int cpu;
+    uint64_t t = timer_read_cpu(&cpu);
+
+    if ( (int)cpu < s->num_cpus )
+        t -= (uint64_t)s->offset[cpu];
+    return t;
+}
+
+#endif
@@ -12,6 +12,7 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 typedef struct {
@@ -26,7 +27,7 @@ static inline double timer_read_hz() {
      int fd;
      double hz;
 
-     buf = malloc(4096);
+     buf = (char*)malloc(4096);
      if (!buf) exit(1);
 
      fd = open("/proc/cpuinfo", O_RDONLY);
@@ -44,6 +45,35 @@ static inline double timer_read_hz() {
      return hz;
 }
 
+/**
+ * Measures the TSC rate against the monotonic clock.
+ * Unlike timer_read_hz(), which reports the current (possibly 
+ * turbo/throttled) core frequency, this returns the invariant 
+ * rate at which the TSC actually ticks.
+ * @param usecs length of the calibration interval in microseconds
+ * @return TSC ticks per second
+ */
+static inline double timer_calibrate_hz(unsigned long usecs)
+{
+    struct timespec t0, t1;
+    uint64_t tsc0, tsc1, hi, lo;
+    double ns;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    __asm__ __volatile__ ( "rdtsc" : "=a"(lo), "=d"(hi) );
+    tsc0 = (hi << 32) | lo;
+
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+    } while ( ns < usecs * 1e3 );
+
+    __asm__ __volatile__ ( "rdtsc" : "=a"(lo), "=d"(hi) );
+    tsc1 = (hi << 32) | lo;
+
+    return (double)(tsc1 - tsc0) * 1e9 / ns;
+}
+
 static inline void timer_clear(tsctimer_t *t)
 {
     t->invocs = 0;
@@ -82,6 +112,23 @@ static inline uint64_t timer_read()
     return ( (hi << 32) | lo );
 }
 
+/**
+ * Reads the TSC together with the cpu it was read on.
+ * rdtscp waits until all previous instructions have executed, and
+ * Linux stores (node << 12) | cpu in the TSC_AUX register it returns.
+ * @param cpu where the cpu number is stored
+ * @return TSC value
+ */
+static inline uint64_t timer_read_cpu(unsigned int *cpu)
+{
+    uint64_t hi, lo, aux;
+    __asm__ __volatile__ ( "rdtscp"
+                           : "=a"(lo), "=d"(hi), "=c"(aux)
+                         );
+    *cpu = (unsigned int)(aux & 0xfff);
+    return ( (hi << 32) | lo );
+}
+
 static inline double timer_total(tsctimer_t *t)
 {
     return (double)t->total;
@@ -93,13 +140,16 @@ static inline double timer_average(tsctimer_t *t)
 }
 
 /**
- * Spin for a specific number of cycles
+ * Spin for a specific number of cycles.
+ * Each poll of the TSC is preceded by a PAUSE, so that the SMT 
+ * sibling is not starved while we wait.
  * @param ncycles number of cycles
  */ 
 static inline void spin_for_cycles(unsigned long ncycles)
 {
-    register uint64_t end = timer_read() + (uint64_t)ncycles;
-    while ( timer_read() < end ) ;
+    uint64_t end = timer_read() + (uint64_t)ncycles;
+    while ( timer_read() < end ) 
+        __asm__ __volatile__ ("pause" : : : "memory");
 }
 
 #endif
@@ -288,7 +288,7 @@ unsigned long get_mask_from_cpuset(cpu_set_t *s)
     unsigned long mask = 0;
 
     for ( i = 0; i < nbits; i++ )
-        mask = CPU_ISSET(i,s) ? mask | (1<<i) : mask;
+        mask = CPU_ISSET(i,s) ? mask | (1UL<<i) : mask;
 
     return mask;
 }
@@ -302,7 +302,7 @@ unsigned long get_current_thread_mask(void)
     pthread_getaffinity_np(pthread_self(), sizeof(s), &s);
 
     for ( i = 0; i < nbits; i++ )
-        mask = CPU_ISSET(i,&s) ? mask | (1<<i) : mask;
+        mask = CPU_ISSET(i,&s) ? mask | (1UL<<i) : mask;
 
     return mask;
 }